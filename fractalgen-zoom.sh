@@ -108,16 +108,10 @@ do
 	shift 1
 done
 
-smoothing_end=`awk "BEGIN {print 1 - $smoothing}"`
-bp1="0 $initial_zoom"
-bp2="1 $final_zoom"
-cp1="$smoothing $initial_zoom"
-cp2="$smoothing_end $final_zoom"
-zoom_bezier="$bp1 $cp1 $bp2 $cp2"
 echo "Width:                    $width"
 echo "Height:                   $height"
 echo "Frames:                   $frames"
-echo "Camera bezier:            $zoom_bezier"
+echo "Zoom:                     $initial_zoom to $final_zoom, smoothing $smoothing"
 echo "Multisample level:        $multisample"
 echo "Directory:                $directory"
 
@@ -132,12 +126,7 @@ then
 	mkdir "$directory"
 fi
 
-i=0
-
-for radius in `bezier $zoom_bezier $frames | awk '{ print 1 / 10 ** $2 }'`
-do
-	mandelbrot -x "$real" -y "$imaginary" -w "$width" -h "$height" -r "$radius" -a "$iterations" -t "$threads" -s "$multisample" -f "$directory/${i}_frame.bmp" $iterate $render > /dev/null
-	wait
-	echo "$((i + 1)) / $frames"
-	i=$((i+1))
-done
+frgen --animate "$frames" --zoom-from "$initial_zoom" --zoom-to "$final_zoom" \
+	--smoothing "$smoothing" -x "$real" -y "$imaginary" -w "$width" -h "$height" \
+	-a "$iterations" -t "$threads" -s "$multisample" -f "$directory/%u_frame.bmp" \
+	$iterate $render
@@ -0,0 +1,367 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include <string>
+#include <vector>
+#include <thread>
+#include <fstream>
+#include <sstream>
+
+#include "animate.h"
+#include "global.h"
+
+struct keyframe_s {
+	unsigned long frame;
+	std::string x;
+	std::string y;
+	double zoom;
+};
+
+/* Reads "<frame> <x> <y> <zoom>" lines. Blank lines and lines starting with #
+ * are skipped. Keyframes must come in order of their frames. */
+static int read_keyframes(const char *path, std::vector<struct keyframe_s> &keys)
+{
+	std::ifstream in(path);
+	std::string line;
+	struct keyframe_s key;
+	unsigned long line_no = 0;
+
+	if (!in) {
+		fprintf(stderr, "Cannot open keyframe file %s\n", path);
+		return 1;
+	}
+
+	while (std::getline(in, line)) {
+		std::istringstream fields(line);
+
+		line_no++;
+		if (line.find_first_not_of(" \t\r") == std::string::npos || line[0] == '#')
+			continue;
+
+		if (!(fields >> key.frame >> key.x >> key.y >> key.zoom)
+				|| (!keys.empty() && key.frame <= keys.back().frame)) {
+			fprintf(stderr, "%s:%lu: Invalid keyframe\n", path, line_no);
+			return 1;
+		}
+
+		keys.push_back(key);
+	}
+
+	if (keys.size() < 2) {
+		fprintf(stderr, "%s: Need at least two keyframes\n", path);
+		return 1;
+	}
+
+	return 0;
+}
+
+/* Position along the path after a fraction u of the time between two
+ * keyframes. This is the cubic bezier through (0, 0), (s, 0), (1 - s, 1) and
+ * (1, 1) as a function of its x coordinate. */
+static double ease(double u, double s)
+{
+	double lo = 0.0;
+	double hi = 1.0;
+	double t;
+	double x;
+	int i;
+
+	for (i = 0; i < 52; i++) {
+		t = 0.5 * (lo + hi);
+		x = 3.0 * s * t * (1.0 - t) * (1.0 - t) + 3.0 * (1.0 - s) * t * t * (1.0 - t)
+			+ t * t * t;
+
+		if (x < u)
+			lo = t;
+		else
+			hi = t;
+	}
+
+	t = 0.5 * (lo + hi);
+
+	return t * t * (3.0 - 2.0 * t);
+}
+
+/* 10^-zoom as a decimal string, so that radii past the range of a double
+ * still reach the plugins that can use them. */
+static std::string zoom_radius(double zoom)
+{
+	char buf[64];
+	long k;
+
+	k = (long)ceil(zoom);
+	snprintf(buf, sizeof(buf), "%.17ge%ld", pow(10.0, (double)k - zoom), -k);
+
+	return buf;
+}
+
+/* Replaces the %u in pattern with frame. */
+static std::string frame_path(const char *pattern, unsigned long frame)
+{
+	std::string ret(pattern);
+	size_t at;
+
+	at = ret.find("%u");
+	ret.replace(at, 2, std::to_string(frame));
+
+	return ret;
+}
+
+static void bf_from_str(struct big_fixed *f, size_t frac, const std::string &str)
+{
+	if (bf_init_from_str(f, 1, frac, str.c_str())) {
+		bf_destroy(f);
+		bf_init_d(f, 1, frac, strtod(str.c_str(), NULL));
+	}
+}
+
+/* f = a + (b - a) w */
+static void bf_lerp(struct big_fixed *f, const struct big_fixed *a,
+	const struct big_fixed *b, double w)
+{
+	struct big_fixed weight;
+
+	bf_init_d(&weight, 1, bf_frac_u32s(f), w);
+	bf_set(f, b);
+	bf_sub_i(f, a);
+	bf_mul_i(f, &weight);
+	bf_add_i(f, a);
+	bf_destroy(&weight);
+}
+
+/* The same in double precision, exact where a and b agree. */
+static double lerp_d(const std::string &a, const std::string &b, double w)
+{
+	double da;
+	double db;
+
+	da = strtod(a.c_str(), NULL);
+	db = strtod(b.c_str(), NULL);
+
+	return da + (db - da) * w;
+}
+
+struct frame_writer_s {
+	struct bmp_img *img;
+	const struct frame_stream_s *stream;
+	unsigned char *bytes;
+	std::string path;
+	uint16_t supersample_level;
+	unsigned long frame;
+	unsigned long frames;
+	int failed;
+
+	/* Share of samples taken over from the frame before, or negative. */
+	double reused;
+};
+
+static void write_frame(struct frame_writer_s *w)
+{
+	struct bmp_img *downsampled = NULL;
+	FILE *f;
+
+	if (w->stream) {
+		w->failed = stream_write(w->stream, w->bytes);
+	} else if (!(f = fopen(w->path.c_str(), "wb"))) {
+		fprintf(stderr, "Can't open %s for writing!\n", w->path.c_str());
+		w->failed = 1;
+		return;
+	} else {
+		if (w->supersample_level)
+			downsampled = bmp_downsample(w->img, w->supersample_level);
+
+		bmp_write_f(downsampled ? downsampled : w->img, f);
+		fclose(f);
+		bmp_delete(downsampled);
+	}
+
+	if (w->reused >= 0.0)
+		printf("%lu / %lu, %.1f%% reused\n", w->frame + 1, w->frames, 100.0 * w->reused);
+	else
+		printf("%lu / %lu\n", w->frame + 1, w->frames);
+}
+
+int animate(struct render_pool_s *pool, const struct animation_s *anim)
+{
+	std::vector<struct keyframe_s> keys;
+	std::vector<struct big_fixed> key_x;
+	std::vector<struct big_fixed> key_y;
+	struct frame_writer_s writers[2];
+	struct expmap_s map;
+	std::thread writer;
+	struct render_frame_s frame;
+	struct render_reuse_s reuse;
+	struct big_fixed x;
+	struct big_fixed y;
+	struct big_fixed r;
+	std::string radius_str;
+	unsigned long frames;
+	unsigned long i;
+	size_t reused = 0;
+	size_t samples = 0;
+	size_t key;
+	size_t frac;
+	double max_zoom;
+	double min_zoom;
+	double w;
+	double zoom;
+	int ret = 0;
+
+	if (!anim->stream && !strstr(anim->path, "%u")) {
+		fprintf(stderr, "Output name %s has no %%u for the frame number\n", anim->path);
+		return 1;
+	}
+
+	if (anim->keyframes) {
+		if (read_keyframes(anim->keyframes, keys))
+			return 1;
+		frames = keys.back().frame + 1;
+	} else {
+		frames = anim->frames;
+		keys.push_back(keyframe_s { 0, anim->x, anim->y, anim->zoom_from });
+		keys.push_back(keyframe_s { (frames > 1) ? frames - 1 : 1, anim->x, anim->y,
+			anim->zoom_to });
+	}
+
+	/* The deepest and the widest radius are at keyframes. */
+	max_zoom = keys[0].zoom;
+	min_zoom = keys[0].zoom;
+	frac = 0;
+
+	for (key = 0; key < keys.size(); key++) {
+		if (anim->exp_map && (keys[key].x != keys[0].x || keys[key].y != keys[0].y)) {
+			fputs("Exponential maps need the centre to stay put\n", stderr);
+			return 1;
+		}
+
+		max_zoom = MB_MAX(max_zoom, keys[key].zoom);
+		min_zoom = MB_MIN(min_zoom, keys[key].zoom);
+		frac = MB_MAX(frac, bf_str_frac_u32s(keys[key].x.c_str()));
+		frac = MB_MAX(frac, bf_str_frac_u32s(keys[key].y.c_str()));
+	}
+
+	frac = MB_MAX(frac, bf_str_frac_u32s(zoom_radius(max_zoom).c_str()) + 1) + 2;
+
+	key_x.resize(keys.size());
+	key_y.resize(keys.size());
+
+	for (key = 0; key < keys.size(); key++) {
+		bf_from_str(&key_x[key], frac, keys[key].x);
+		bf_from_str(&key_y[key], frac, keys[key].y);
+	}
+
+	bf_init(&x, 1, frac);
+	bf_init(&y, 1, frac);
+
+	for (i = 0; i < 2; i++) {
+		writers[i].img = bmp_new(anim->width * (1 << anim->supersample_level),
+			anim->height * (1 << anim->supersample_level));
+		writers[i].supersample_level = anim->supersample_level;
+		writers[i].stream = anim->stream;
+		writers[i].bytes = anim->stream
+			? (unsigned char *)malloc(stream_frame_bytes(anim->stream))
+			: NULL;
+		writers[i].frames = frames;
+		writers[i].failed = 0;
+	}
+
+	frame = anim->frame;
+	frame.org_real_bf = &x;
+	frame.org_img_bf = &y;
+	frame.r_bf = &r;
+	key = 0;
+
+	if (anim->exp_map) {
+		frame.org.real = strtod(keys[0].x.c_str(), NULL);
+		frame.org.img = strtod(keys[0].y.c_str(), NULL);
+		ret = expmap_init(&map, pool, &frame, pow(10.0, -min_zoom), pow(10.0, -max_zoom),
+			writers[0].img->width, writers[0].img->height);
+
+		if (ret)
+			frames = 0;
+	}
+
+	for (i = 0; i < frames && !ret; i++) {
+		while (key + 2 < keys.size() && keys[key + 1].frame <= i)
+			key++;
+
+		w = ((double)i - (double)keys[key].frame)
+			/ (double)(keys[key + 1].frame - keys[key].frame);
+		w = ease(MB_MAX(w, 0.0), anim->smoothing);
+		zoom = keys[key].zoom + (keys[key + 1].zoom - keys[key].zoom) * w;
+
+		bf_lerp(&x, &key_x[key], &key_x[key + 1], w);
+		bf_lerp(&y, &key_y[key], &key_y[key + 1], w);
+		radius_str = zoom_radius(zoom);
+		bf_from_str(&r, frac, radius_str);
+
+		frame.img = writers[i % 2].img;
+		frame.org.real = lerp_d(keys[key].x, keys[key + 1].x, w);
+		frame.org.img = lerp_d(keys[key].y, keys[key + 1].y, w);
+		frame.r = pow(10.0, -zoom);
+
+		frame.reuse = NULL;
+		if (anim->frame.reuse && !(anim->refresh && i % anim->refresh == 0)) {
+			reuse = *anim->frame.reuse;
+			frame.reuse = &reuse;
+		}
+
+		/* Frame i - 1 is written out while this one is drawn. */
+		if (anim->exp_map)
+			expmap_frame(&map, pool, frame.img, frame.r);
+		else
+			render_frame(pool, &frame);
+		bf_destroy(&r);
+
+		if (anim->stream)
+			stream_convert(anim->stream, pool, frame.img, writers[i % 2].bytes);
+
+		if (writer.joinable()) {
+			writer.join();
+			ret = writers[(i + 1) % 2].failed;
+		}
+
+		if (!anim->stream)
+			writers[i % 2].path = frame_path(anim->path, i);
+		writers[i % 2].frame = i;
+		writers[i % 2].reused = -1.0;
+
+		if (frame.reuse) {
+			writers[i % 2].reused = (double)reuse.reused / (double)reuse.samples;
+			reused += reuse.reused;
+			samples += reuse.samples;
+		} else if (anim->frame.reuse) {
+			writers[i % 2].reused = 0.0;
+			samples += (size_t)frame.img->width * frame.img->height;
+		}
+		writer = std::thread(write_frame, &writers[i % 2]);
+	}
+
+	if (writer.joinable()) {
+		writer.join();
+		ret |= writers[(i + 1) % 2].failed;
+	}
+
+	if (samples)
+		printf("%.1f%% of samples reused\n", 100.0 * (double)reused / (double)samples);
+
+	for (i = 0; i < 2; i++) {
+		bmp_delete(writers[i].img);
+		free(writers[i].bytes);
+	}
+
+	if (anim->exp_map && frames)
+		expmap_destroy(&map);
+
+	for (key = 0; key < keys.size(); key++) {
+		bf_destroy(&key_x[key]);
+		bf_destroy(&key_y[key]);
+	}
+
+	bf_destroy(&x);
+	bf_destroy(&y);
+
+	return ret;
+}
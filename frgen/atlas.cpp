@@ -0,0 +1,149 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <vector>
+#include <atomic>
+
+#include "atlas.h"
+#include "global.h"
+
+struct atlas_job_s {
+	const struct atlas_s *at;
+	size_t sets;
+	size_t batches;
+	std::atomic<size_t> next;
+
+	/* Samples a side of a set, and the constants of all sets, row by row
+	 * from the bottom. */
+	size_t size;
+	std::vector<double> c_real;
+	std::vector<double> c_img;
+
+	/* Grid every set is drawn on. */
+	struct frg_iteration_request_s spec;
+
+	struct bmp_img *img;
+};
+
+static void draw_batches(void *arg, unsigned worker)
+{
+	struct atlas_job_s *job = (struct atlas_job_s *)arg;
+	const struct atlas_s *at = job->at;
+	size_t samples = job->size * job->size;
+	std::vector<unsigned> counts(ATLAS_BATCH * samples);
+	std::vector<struct pixel> pixels(samples);
+	struct frg_sweep_request_s req;
+	size_t batch;
+	size_t first;
+	size_t k;
+	size_t i;
+	size_t col;
+	size_t row;
+
+	(void)worker;
+
+	req.rows = job->spec.rows;
+	req.cols = job->spec.cols;
+	req.iterations = job->spec.iterations;
+	req.from_x = job->spec.from_x;
+	req.from_y = job->spec.from_y;
+	req.step = job->spec.step;
+	req.counts = counts.data();
+
+	while ((batch = job->next++) < job->batches) {
+		first = batch * ATLAS_BATCH;
+		req.count = MB_MIN((size_t)ATLAS_BATCH, job->sets - first);
+		req.c_real = job->c_real.data() + first;
+		req.c_img = job->c_img.data() + first;
+
+		at->sweep(&req, at->frame.params);
+
+		for (k = 0; k < req.count; k++) {
+			at->frame.render(&job->spec, counts.data() + k * samples, pixels.data(),
+				at->frame.params);
+
+			col = (first + k) % at->cols * job->size;
+			row = (first + k) / at->cols * job->size;
+
+			for (i = 0; i < job->size; i++) {
+				memcpy(job->img->image + (row + i) * job->img->width + col,
+					pixels.data() + i * job->size, job->size * sizeof(pixels[0]));
+			}
+		}
+	}
+}
+
+extern "C" int atlas(struct render_pool_s *pool, const struct atlas_s *at)
+{
+	struct atlas_job_s job;
+	struct bmp_img *downsampled;
+	double step;
+	size_t i;
+	size_t j;
+	FILE *f;
+	int ret;
+
+	job.at = at;
+	job.size = (size_t)at->thumb << at->supersample_level;
+
+	if (!at->cols || !at->rows || !job.size
+			|| at->cols * job.size > UINT16_MAX || at->rows * job.size > UINT16_MAX) {
+		fprintf(stderr, "An atlas of %u x %u sets of %zu samples a side is too large\n",
+			at->cols, at->rows, job.size);
+		return 1;
+	}
+
+	job.sets = (size_t)at->cols * at->rows;
+	job.batches = (job.sets + ATLAS_BATCH - 1) / ATLAS_BATCH;
+	job.next = 0;
+
+	step = at->frame.r / MB_MIN(at->cols, at->rows);
+	job.c_real.resize(job.sets);
+	job.c_img.resize(job.sets);
+
+	for (i = 0; i < at->rows; i++) {
+		for (j = 0; j < at->cols; j++) {
+			job.c_real[i * at->cols + j] = at->frame.org.real
+				+ ((long)j - (long)(at->cols / 2)) * step;
+			job.c_img[i * at->cols + j] = at->frame.org.img
+				+ ((long)i - (long)(at->rows / 2)) * step;
+		}
+	}
+
+	/* Laid out as render_frame lays out a frame around 0, with a sample on 0
+	 * itself so that symmetric sets only need half. */
+	memset(&job.spec, 0, sizeof(job.spec));
+	job.spec.rows = (unsigned short)job.size;
+	job.spec.cols = (unsigned short)job.size;
+	job.spec.iterations = at->frame.iterations;
+	job.spec.step = at->julia_r / job.size;
+	job.spec.col_offset = -(long)(job.size / 2);
+	job.spec.row_offset = job.spec.col_offset;
+	job.spec.from_x = job.spec.col_offset * job.spec.step;
+	job.spec.from_y = job.spec.row_offset * job.spec.step;
+
+	printf("Atlas of %u x %u Julia sets in %zu batches\n", at->cols, at->rows, job.batches);
+
+	job.img = bmp_new((uint16_t)(at->cols * job.size), (uint16_t)(at->rows * job.size));
+	render_pool_run(pool, draw_batches, &job);
+
+	if (!(f = fopen(at->path, "wb"))) {
+		perror(at->path);
+		bmp_delete(job.img);
+		return 1;
+	}
+
+	if (at->supersample_level) {
+		downsampled = bmp_downsample(job.img, at->supersample_level);
+		ret = bmp_write_f(downsampled, f) != BMP_SUCCESS;
+		bmp_delete(downsampled);
+	} else {
+		ret = bmp_write_f(job.img, f) != BMP_SUCCESS;
+	}
+
+	ret = fclose(f) || ret;
+	bmp_delete(job.img);
+
+	return ret;
+}
@@ -1,93 +1,445 @@
 #include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <stdio.h>
+#include <math.h>
 #include "mbitr.h"
 #include "big_int.h"
 #include "big_fixed.h"
+#include "u32arr.h"
+#include "decimal.h"
 
-/* Returns integral uint32_t at given offset from binary point. The bigger the
- * offset the more significant the digit. */
-static inline uint32_t get_iu32(const struct big_fixed *f, size_t ofst)
+/* Returns uint32_t at given position relative to the binary point. Position 0
+ * is the least significant integral uint32_t, position -1 is the most
+ * significant fractional one. Anything outside of f reads as zero. */
+static inline uint32_t get_u32(const struct big_fixed *f, long pos)
 {
-	if (ofst > f->binp)
+	long idx;
+
+	idx = pos + (long)bf_frac_u32s(f);
+	if (idx < 0 || idx >= (long)f->i.arr.len)
 		return 0;
 
-	return f->i.arr.buf[f->i.arr.len  - f->binp - 1 + ofst];
+	return f->i.arr.buf[idx];
+}
+
+static inline long top_pos(const struct big_fixed *f)
+{
+	return (long)f->binp - 1;
+}
+
+static inline long bottom_pos(const struct big_fixed *f)
+{
+	return -(long)bf_frac_u32s(f);
+}
+
+static void normalise_sign(struct big_fixed *f)
+{
+	if (bf_is_zero(f))
+		f->neg = 0;
+}
+
+void bf_init(struct big_fixed *f, size_t integral, size_t frac)
+{
+	if (!frac)
+		frac = 1;
+
+	f->binp = integral;
+	f->neg = 0;
+	f->i.arr.len = integral + frac;
+	f->i.arr.buf = calloc(f->i.arr.len, sizeof(f->i.arr.buf[0]));
+}
+
+void bf_init_u64(struct big_fixed *f, size_t integral, size_t frac, uint64_t init)
+{
+	bf_init(f, integral, frac);
+
+	if (integral >= 1)
+		f->i.arr.buf[bf_frac_u32s(f)] = (uint32_t)init;
+	if (integral >= 2)
+		f->i.arr.buf[bf_frac_u32s(f) + 1] = (uint32_t)(init >> 32);
 }
 
-static inline int32_t sub_ss(size_t s1, size_t s2)
+void bf_init_d(struct big_fixed *f, size_t integral, size_t frac, double init)
 {
-	if (s1 > s2)
-		return (int32_t)(s1 - s2);
-	else
-		return -((int32_t)(s2 - s1));
+	bf_init(f, integral, frac);
+	bf_set_d(f, init);
 }
 
-static inline uint32_t get_fu32(const struct big_fixed *f, size_t ofst)
+void bf_destroy(struct big_fixed *f)
+{
+	free(f->i.arr.buf);
+	f->i.arr.buf = NULL;
+	f->i.arr.len = 0;
+}
+
+void bf_set(struct big_fixed *f1, const struct big_fixed *f2)
 {
 	size_t idx;
-	size_t first_fu32;
 
-	first_fu32 = f->i.arr.len - f->binp - 1;
-	if (first_fu32 < ofst)
-		return 0;
-	idx = first_fu32 - ofst;
+	for (idx = 0; idx < f1->i.arr.len; idx++)
+		f1->i.arr.buf[idx] = get_u32(f2, (long)idx + bottom_pos(f1));
 
-	return f->i.arr.buf[idx];
+	f1->neg = f2->neg;
+	normalise_sign(f1);
+}
+
+/* Every step here is exact: division and multiplication by a power of two
+ * only changes the exponent and floor() of a double is representable. */
+void bf_set_d(struct big_fixed *f, double val)
+{
+	double scale;
+	double u32;
+	size_t idx;
+
+	f->neg = val < 0.0;
+	val = fabs(val);
+
+	foreach_reverse_idx (idx, f->i.arr.len) {
+		scale = ldexp(1.0, 32 * ((long)idx + bottom_pos(f)));
+		u32 = floor(val / scale);
+		if (u32 > (double)UINT32_MAX)
+			u32 = (double)UINT32_MAX;
+		f->i.arr.buf[idx] = (uint32_t)u32;
+		val -= u32 * scale;
+	}
+
+	normalise_sign(f);
+}
+
+double bf_to_d(const struct big_fixed *f)
+{
+	double ret = 0.0;
+	size_t idx;
+
+	for (idx = 0; idx < f->i.arr.len; idx++) {
+		if (f->i.arr.buf[idx])
+			ret += ldexp((double)f->i.arr.buf[idx],
+					32 * ((long)idx + bottom_pos(f)));
+	}
+
+	return f->neg ? -ret : ret;
+}
+
+int bf_is_zero(const struct big_fixed *f)
+{
+	size_t idx;
+
+	for (idx = 0; idx < f->i.arr.len; idx++) {
+		if (f->i.arr.buf[idx])
+			return 0;
+	}
+
+	return 1;
+}
+
+/* Digits of a decimal number with the decimal point moved by the exponent.
+ * point is the number of digits before the decimal point and may lie outside
+ * of the digit string. */
+struct dec_str_s {
+	char *digits;
+	size_t len;
+	long point;
+	int neg;
+};
+
+static int read_dec_str(struct dec_str_s *dec, const char *str)
+{
+	const char *int_str;
+	const char *frac_str = "";
+	size_t int_len;
+	size_t frac_len = 0;
+	long exp;
+	char *end;
+
+	dec->digits = NULL;
+	dec->neg = 0;
+
+	while (isspace((unsigned char)*str))
+		str++;
+
+	if (*str == '-' || *str == '+')
+		dec->neg = *str++ == '-';
+
+	if (!isdigit((unsigned char)*str)
+			&& !(*str == '.' && isdigit((unsigned char)str[1])))
+		return 1;
+
+	int_str = str;
+	for (int_len = 0; isdigit((unsigned char)*str); str++)
+		int_len++;
+
+	if (*str == '.') {
+		frac_str = ++str;
+		for (; isdigit((unsigned char)*str); str++)
+			frac_len++;
+	}
+
+	exp = 0;
+	if (*str == 'e' || *str == 'E') {
+		exp = strtol(str + 1, &end, 10);
+		if (end == str + 1)
+			return 1;
+		str = end;
+	}
+
+	if (*str)
+		return 1;
+
+	dec->len = int_len + frac_len;
+	dec->point = (long)int_len + exp;
+	dec->digits = malloc(dec->len + 1);
+	memcpy(dec->digits, int_str, int_len);
+	memcpy(dec->digits + int_len, frac_str, frac_len);
+
+	return 0;
+}
+
+/* Both parts are converted with the divide and conquer routines in decimal.c,
+ * so long coordinates take time close to that of a few multiplications of
+ * their size. */
+int bf_init_from_str(struct big_fixed *f, size_t integral, size_t frac, const char *str)
+{
+	struct dec_str_s dec;
+	struct mb_array_u32 int_part;
+	size_t int_len;
+	size_t frac_skip;
+	size_t skip;
+	int ret = 0;
+
+	bf_init(f, integral, frac);
+
+	if (read_dec_str(&dec, str)) {
+		free(dec.digits);
+		return 1;
+	}
+
+	int_len = (dec.point < 0) ? 0 : (size_t)dec.point;
+	frac_skip = (dec.point < 0) ? (size_t)-dec.point : 0;
+
+	if (int_len) {
+		/* Zeroes are appended if the exponent moves the point past
+		 * the last digit. Huge exponents are clamped to a length that
+		 * still overflows the integral part. */
+		if (int_len > dec.len) {
+			if (int_len > dec_frac_digits(integral) + dec.len)
+				int_len = dec_frac_digits(integral) + dec.len + 1;
+			dec.digits = realloc(dec.digits, int_len);
+			memset(dec.digits + dec.len, '0', int_len - dec.len);
+		}
+		for (skip = 0; skip < int_len && dec.digits[skip] == '0'; skip++)
+			;
+		int_part = dec_parse_int(dec.digits + skip, int_len - skip);
+		if (u32arr_trim(int_part.buf, int_part.len) > integral)
+			ret = 1;
+		memcpy(f->i.arr.buf + bf_frac_u32s(f), int_part.buf,
+				((int_part.len < integral) ? int_part.len : integral)
+				* sizeof(int_part.buf[0]));
+		free(int_part.buf);
+	}
+
+	/* Anything this far past the point is rounded down to zero anyway. */
+	if (int_len < dec.len && frac_skip <= dec_frac_digits(bf_frac_u32s(f))) {
+		char *frac_digits;
+		size_t frac_len;
+
+		frac_len = frac_skip + dec.len - int_len;
+		frac_digits = malloc(frac_len);
+		memset(frac_digits, '0', frac_skip);
+		memcpy(frac_digits + frac_skip, dec.digits + int_len, dec.len - int_len);
+		dec_parse_frac(f->i.arr.buf, bf_frac_u32s(f), frac_digits, frac_len);
+		free(frac_digits);
+	}
+
+	f->neg = dec.neg;
+	normalise_sign(f);
+	free(dec.digits);
+
+	return ret;
+}
+
+size_t bf_str_frac_u32s(const char *str)
+{
+	struct dec_str_s dec;
+	size_t ret = 0;
+
+	if (!read_dec_str(&dec, str) && (long)dec.len > dec.point)
+		ret = dec_frac_u32s((size_t)((long)dec.len - dec.point));
+
+	free(dec.digits);
+
+	return ret;
+}
+
+char * bf_tostr(const struct big_fixed *f, size_t digits)
+{
+	char *int_str;
+	char *frac_str;
+	char *ret;
+	size_t int_len;
+	size_t frac_len;
+
+	if (!digits)
+		digits = dec_frac_digits(bf_frac_u32s(f));
+
+	int_str = dec_format_int(f->i.arr.buf + bf_frac_u32s(f), f->binp);
+	frac_str = dec_format_frac(f->i.arr.buf, bf_frac_u32s(f), digits);
+
+	int_len = strlen(int_str);
+	for (frac_len = digits; frac_len > 1 && frac_str[frac_len - 1] == '0'; frac_len--)
+		;
+
+	ret = malloc(int_len + frac_len + 3);
+	sprintf(ret, "%s%s.%.*s", f->neg ? "-" : "", int_str, (int)frac_len, frac_str);
+
+	free(int_str);
+	free(frac_str);
+
+	return ret;
+}
+
+void bf_neg_i(struct big_fixed *f)
+{
+	f->neg = !f->neg;
+	normalise_sign(f);
+}
+
+/* |f1| += |f2| */
+static void mag_add(struct big_fixed *f1, const struct big_fixed *f2)
+{
+	uint64_t sum = 0;
+	size_t idx;
+
+	for (idx = 0; idx < f1->i.arr.len; idx++) {
+		sum += (uint64_t)f1->i.arr.buf[idx]
+			+ get_u32(f2, (long)idx + bottom_pos(f1));
+		f1->i.arr.buf[idx] = (uint32_t)sum;
+		sum >>= 32;
+	}
 }
 
-static inline size_t fractional_digits(const struct big_fixed *f)
+/* |f1| = |f1| - |f2| if reverse is zero. |f1| = |f2| - |f1| otherwise. The
+ * result is expected to be non-negative. */
+static void mag_sub(struct big_fixed *f1, const struct big_fixed *f2, int reverse)
 {
-	return f->i.arr.len - f->binp;
+	uint64_t a;
+	uint64_t b;
+	uint64_t diff;
+	uint64_t borrow = 0;
+	size_t idx;
+
+	for (idx = 0; idx < f1->i.arr.len; idx++) {
+		a = f1->i.arr.buf[idx];
+		b = get_u32(f2, (long)idx + bottom_pos(f1));
+		diff = reverse ? b - a - borrow : a - b - borrow;
+		f1->i.arr.buf[idx] = (uint32_t)diff;
+		borrow = (diff >> 32) & 1;
+	}
+}
+
+static void add_signed(struct big_fixed *f1, const struct big_fixed *f2, int neg2)
+{
+	if (f1->neg == neg2) {
+		mag_add(f1, f2);
+	} else if (bf_cmp_abs(f1, f2) >= 0) {
+		mag_sub(f1, f2, 0);
+	} else {
+		mag_sub(f1, f2, 1);
+		f1->neg = neg2;
+	}
+
+	normalise_sign(f1);
 }
 
-/* Addition is fairly simple.
- *
- *	1. Shift second integer so that their binary points align.
- *	2. add.
- *
- * Well. This is not what I'll actually do. Instead, I shall add second integer
- * to first at an offset. This does the same thing and does not require
- * shifting an entire big int.
- * */
 void bf_add_i(struct big_fixed *f1, const struct big_fixed *f2)
 {
-	bi_add_is(&f1->i, &f2->i, sub_ss(f2->binp, f1->binp));
+	add_signed(f1, f2, f2->neg);
 }
 
-/* Subtracting is pretty much the exact same as addition just with opposite
- * operation. */
 void bf_sub_i(struct big_fixed *f1, const struct big_fixed *f2)
 {
-	bi_add_is(&f1->i, &f2->i, sub_ss(f2->binp, f1->binp));
+	add_signed(f1, f2, !f2->neg);
 }
 
+/* Schoolbook multiplication of magnitudes. The full product has
+ * frac(f1) + frac(f2) fractional uint32_t's, so the lowest frac(f2) of them
+ * are dropped to bring it back to the format of f1. */
 void bf_mul_i(struct big_fixed *f1, const struct big_fixed *f2)
 {
-	bi_mul_is(&f1->i, &f2->i, sub_ss(f2->binp, f1->binp));
+	uint32_t *prod;
+	uint64_t acc;
+	size_t len1;
+	size_t len2;
+	size_t i;
+	size_t j;
+
+	len1 = f1->i.arr.len;
+	len2 = f2->i.arr.len;
+	prod = calloc(len1 + len2, sizeof(prod[0]));
+
+	for (i = 0; i < len1; i++) {
+		if (!f1->i.arr.buf[i])
+			continue;
+		acc = 0;
+		for (j = 0; j < len2; j++) {
+			acc += (uint64_t)f1->i.arr.buf[i] * f2->i.arr.buf[j]
+				+ prod[i + j];
+			prod[i + j] = (uint32_t)acc;
+			acc >>= 32;
+		}
+		prod[i + len2] = (uint32_t)acc;
+	}
+
+	memcpy(f1->i.arr.buf, prod + bf_frac_u32s(f2), len1 * sizeof(prod[0]));
+	f1->neg ^= f2->neg;
+	normalise_sign(f1);
+
+	free(prod);
 }
 
-int bf_cmp(const struct big_fixed *f1, const struct big_fixed *f2)
+/* Bits carried out of the integral part are dropped. */
+void bf_mul_u32_i(struct big_fixed *f, uint32_t mul)
 {
-	size_t ids;	/* Max integral digits. */
-	size_t fds;	/* Max fractional digits. */
-	size_t i;
-	uint32_t val1;
-	uint32_t val2;
+	u32arr_mul_u32(f->i.arr.buf, f->i.arr.len, mul, 0);
+	normalise_sign(f);
+}
 
-	ids = MB_MAX(f1->binp, f2->binp);
-	fds = MB_MAX(fractional_digits(f1), fractional_digits(f2));
+void bf_div_u32_i(struct big_fixed *f, uint32_t div)
+{
+	u32arr_div_u32(f->i.arr.buf, f->i.arr.len, div);
+	normalise_sign(f);
+}
 
-	foreach_reverse_idx (i, ids) {
-		val1 = get_iu32(f1, i);
-		val2 = get_iu32(f2, i);
-		if (val1 > val2)
-			return 1;
-		else if (val1 < val2)
-			return -1;
+void bf_to_twos_u32(const struct big_fixed *f, uint32_t *dest, size_t u32s,
+		size_t frac, size_t stride)
+{
+	uint64_t acc;
+	uint32_t mask;
+	size_t idx;
+
+	mask = f->neg ? UINT32_MAX : 0;
+	acc = f->neg ? 1 : 0;
+
+	for (idx = 0; idx < u32s; idx++) {
+		acc += get_u32(f, (long)idx - (long)frac) ^ mask;
+		dest[idx * stride] = (uint32_t)acc;
+		acc >>= 32;
 	}
+}
 
-	foreach_reverse_idx (i, fds) {
-		val1 = get_fu32(f1, i);
-		val2 = get_fu32(f2, i);
+int bf_cmp_abs(const struct big_fixed *f1, const struct big_fixed *f2)
+{
+	long pos;
+	long bottom;
+	uint32_t val1;
+	uint32_t val2;
+
+	pos = MB_MAX(top_pos(f1), top_pos(f2));
+	bottom = (bottom_pos(f1) < bottom_pos(f2)) ? bottom_pos(f1) : bottom_pos(f2);
+
+	for (; pos >= bottom; pos--) {
+		val1 = get_u32(f1, pos);
+		val2 = get_u32(f2, pos);
 		if (val1 > val2)
 			return 1;
 		else if (val1 < val2)
@@ -96,3 +448,11 @@ int bf_cmp(const struct big_fixed *f1, const struct big_fixed *f2)
 
 	return 0;
 }
+
+int bf_cmp(const struct big_fixed *f1, const struct big_fixed *f2)
+{
+	if (f1->neg != f2->neg)
+		return f1->neg ? -1 : 1;
+
+	return f1->neg ? -bf_cmp_abs(f1, f2) : bf_cmp_abs(f1, f2);
+}
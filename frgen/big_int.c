@@ -10,6 +10,7 @@
 #include "mbarray.h"
 #include "mbitr.h"
 #include "parse.h"
+#include "decimal.h"
 #include "log.h"
 
 struct u64_split {
@@ -240,6 +241,10 @@ struct mb_array_u32 u32arr_from_str(size_t size, const char *str, unsigned radix
 	case 32:
 		parse_pow2(size, &ret, str, radix);
 		return ret;
+	case 10:
+		ret = dec_parse_int(str, mb_num_of_digits(str, radix));
+		ensure_capacity(&ret, size);
+		return ret;
 	}
 
 	if (radix > 10 + 'z' - 'a' + 1) {
@@ -604,7 +609,7 @@ static char * copy_str(const char *str)
 	char *ret;
 	size_t len;
 
-	len = strlen(str);
+	len = strlen(str) + 1;
 	ret = malloc(len);
 	memcpy(ret, str, len);
 
@@ -624,12 +629,10 @@ char * bi_tostr(const struct big_int *num, unsigned radix)
 	case 16:
 	case 32:
 		return tostr_pow4(num, radix);
+	case 10:
+		return dec_format_int(num->arr.buf, num->arr.len);
 	}
 
-	/* Implementing conversion to a non-power of 2 radix string would
-	 * require division. Division is slow as all hell and is not actually
-	 * needed to draw an image of the mandelbrot set. For the time being,
-	 * it will remain unimplemented.*/
 	m_eprintf("Conversion to string in base %u is not supported yet.\n",
 			radix);
 
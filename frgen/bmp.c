@@ -77,7 +77,7 @@ static struct pixel p32_to_p8(const struct pixel32 *p32)
 	return p;
 }
 
-static struct pixel average_pixel_area(const struct bmp_img *img,
+struct pixel bmp_average_area(const struct bmp_img *img,
 		uint16_t x, uint16_t y, uint16_t width, uint16_t height)
 {
 	uint16_t i, j;
@@ -127,7 +127,7 @@ struct bmp_img * bmp_downsample(const struct bmp_img *img, unsigned level)
 	for (x = 0; x < downsampled_img->width; x++) {
 		for (y = 0; y < downsampled_img->height; y++) {
 			BMP_AT(downsampled_img, x, y)
-				= average_pixel_area(
+				= bmp_average_area(
 						img,
 						x * divisor,
 						y * divisor,
@@ -0,0 +1,294 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+#include <chrono>
+#include <mutex>
+
+#if defined(_WIN32) || defined(_WIN64)
+#include <io.h>
+#define fsync(__fd) _commit(__fd)
+#define ftruncate(__fd, __length) _chsize_s(__fd, __length)
+#else
+#include <unistd.h>
+#endif
+
+#include "checkpoint.h"
+
+#define CHECKPOINT_HEADER	"frgen checkpoint 1\n"
+#define RECORD_MAGIC		(0x454c4954u)
+
+/* Records reach the OS as soon as they are written, which is enough for the
+ * process dying. They reach the disk this often, for the machine dying. */
+#define SYNC_SECONDS		(10)
+
+/* Tiles larger than this are taken for a damaged record. */
+#define MAX_TILE_SAMPLES	(1u << 26)
+
+typedef std::chrono::steady_clock clock_type;
+
+struct record_head_s {
+	uint32_t magic;
+	uint32_t line;
+	uint32_t col;
+	uint32_t rows;
+	uint32_t cols;
+	uint32_t has_distance;
+};
+
+struct render_checkpoint_s {
+	FILE *f;
+	std::string path;
+	std::mutex lock;
+	clock_type::time_point synced;
+
+	/* Set once a record fails to be written. Whatever got through of it is
+	 * dropped on resume, and no record goes after it, so the log still
+	 * resumes from the tiles before. */
+	bool failed;
+
+	/* Records are read back from read_pos up to end, the last whole one. */
+	bool reading;
+	long read_pos;
+	long end;
+	size_t restored;
+
+	std::vector<unsigned> iterations;
+	std::vector<float> distance;
+};
+
+static uint32_t fnv1a(uint32_t hash, const void *data, size_t length)
+{
+	const unsigned char *p = (const unsigned char *)data;
+
+	while (length--) {
+		hash ^= *p++;
+		hash *= 16777619u;
+	}
+
+	return hash;
+}
+
+/* Reads one record, and fails on anything short of a whole one with the
+ * right checksum, as a write cut off by a crash leaves behind. */
+static bool read_record(FILE *f, struct record_head_s *head, std::vector<unsigned> &iterations,
+	std::vector<float> &distance)
+{
+	uint32_t hash = 2166136261u;
+	uint32_t sum;
+	size_t samples;
+
+	if (fread(head, sizeof(*head), 1, f) != 1 || head->magic != RECORD_MAGIC
+			|| (uint64_t)head->rows * head->cols > MAX_TILE_SAMPLES)
+		return false;
+
+	samples = (size_t)head->rows * head->cols;
+	iterations.resize(samples);
+	distance.resize(head->has_distance ? samples : 0);
+
+	if (fread(iterations.data(), sizeof(unsigned), samples, f) != samples
+			|| fread(distance.data(), sizeof(float), distance.size(), f) != distance.size()
+			|| fread(&sum, sizeof(sum), 1, f) != 1)
+		return false;
+
+	hash = fnv1a(hash, head, sizeof(*head));
+	hash = fnv1a(hash, iterations.data(), samples * sizeof(unsigned));
+	hash = fnv1a(hash, distance.data(), distance.size() * sizeof(float));
+
+	return hash == sum;
+}
+
+static bool read_line(FILE *f, std::string &line)
+{
+	int c;
+
+	line.clear();
+	while ((c = fgetc(f)) != EOF) {
+		line.push_back((char)c);
+		if (c == '\n')
+			return true;
+	}
+
+	return false;
+}
+
+/* Checks the log is of this render and finds where its last whole record
+ * ends. Anything after that is cut off. */
+static struct render_checkpoint_s * resume_log(FILE *f, const char *path, const char *key)
+{
+	struct render_checkpoint_s *ckpt;
+	struct record_head_s head;
+	std::string line;
+	long pos;
+
+	if (!read_line(f, line) || line != CHECKPOINT_HEADER
+			|| !read_line(f, line) || line != std::string(key) + "\n") {
+		fprintf(stderr, "Checkpoint %s is of another render\n", path);
+		fclose(f);
+		return NULL;
+	}
+
+	ckpt = new render_checkpoint_s;
+	ckpt->f = f;
+	ckpt->path = path;
+	ckpt->reading = true;
+	ckpt->read_pos = ftell(f);
+	ckpt->restored = 0;
+	ckpt->failed = false;
+
+	pos = ckpt->read_pos;
+	while (read_record(f, &head, ckpt->iterations, ckpt->distance)) {
+		pos = ftell(f);
+		ckpt->restored++;
+	}
+
+	ckpt->end = pos;
+	fseek(f, pos, SEEK_SET);
+
+	if (ftruncate(fileno(f), pos))
+		perror(path);
+
+	return ckpt;
+}
+
+extern "C" struct render_checkpoint_s * checkpoint_open(const char *path, const char *key,
+	int resume)
+{
+	struct render_checkpoint_s *ckpt;
+	FILE *f = NULL;
+
+	if (resume && !(f = fopen(path, "r+b")) && errno != ENOENT) {
+		perror(path);
+		return NULL;
+	}
+
+	if (f) {
+		if (!(ckpt = resume_log(f, path, key)))
+			return NULL;
+	} else {
+		/* Without resume, a log left by a run that died is not thrown away
+		 * unasked. */
+		if (!resume && (f = fopen(path, "rb"))) {
+			fclose(f);
+			fprintf(stderr, "Checkpoint %s already exists. Pass --resume to go on from it, "
+				"or delete it\n", path);
+			return NULL;
+		}
+
+		if (!(f = fopen(path, "w+b")) || fprintf(f, CHECKPOINT_HEADER "%s\n", key) < 0
+				|| fflush(f)) {
+			perror(path);
+			if (f)
+				fclose(f);
+			return NULL;
+		}
+
+		ckpt = new render_checkpoint_s;
+		ckpt->f = f;
+		ckpt->path = path;
+		ckpt->reading = false;
+		ckpt->read_pos = 0;
+		ckpt->end = 0;
+		ckpt->restored = 0;
+		ckpt->failed = false;
+	}
+
+	ckpt->synced = clock_type::now();
+
+	return ckpt;
+}
+
+extern "C" size_t checkpoint_restored(const struct render_checkpoint_s *ckpt)
+{
+	return ckpt->restored;
+}
+
+extern "C" int checkpoint_read(struct render_checkpoint_s *ckpt, struct checkpoint_tile_s *tile,
+	const unsigned **iterations, const float **distance)
+{
+	struct record_head_s head;
+
+	if (ckpt->reading && ckpt->read_pos < ckpt->end) {
+		fseek(ckpt->f, ckpt->read_pos, SEEK_SET);
+
+		if (read_record(ckpt->f, &head, ckpt->iterations, ckpt->distance)) {
+			ckpt->read_pos = ftell(ckpt->f);
+			tile->line = head.line;
+			tile->col = head.col;
+			tile->rows = head.rows;
+			tile->cols = head.cols;
+			*iterations = ckpt->iterations.data();
+			*distance = head.has_distance ? ckpt->distance.data() : NULL;
+
+			return 1;
+		}
+	}
+
+	if (ckpt->reading) {
+		ckpt->reading = false;
+		ckpt->iterations = std::vector<unsigned>();
+		ckpt->distance = std::vector<float>();
+		fseek(ckpt->f, 0, SEEK_END);
+	}
+
+	return 0;
+}
+
+extern "C" int checkpoint_append(struct render_checkpoint_s *ckpt,
+	const struct checkpoint_tile_s *tile, const unsigned *iterations, const float *distance)
+{
+	struct record_head_s head;
+	size_t samples = tile->rows * tile->cols;
+	uint32_t hash = 2166136261u;
+	bool ok;
+
+	head.magic = RECORD_MAGIC;
+	head.line = (uint32_t)tile->line;
+	head.col = (uint32_t)tile->col;
+	head.rows = (uint32_t)tile->rows;
+	head.cols = (uint32_t)tile->cols;
+	head.has_distance = distance != NULL;
+
+	hash = fnv1a(hash, &head, sizeof(head));
+	hash = fnv1a(hash, iterations, samples * sizeof(unsigned));
+	if (distance)
+		hash = fnv1a(hash, distance, samples * sizeof(float));
+
+	std::lock_guard<std::mutex> guard(ckpt->lock);
+
+	if (ckpt->failed)
+		return 1;
+
+	ok = fwrite(&head, sizeof(head), 1, ckpt->f) == 1
+		&& fwrite(iterations, sizeof(unsigned), samples, ckpt->f) == samples
+		&& (!distance || fwrite(distance, sizeof(float), samples, ckpt->f) == samples)
+		&& fwrite(&hash, sizeof(hash), 1, ckpt->f) == 1
+		&& !fflush(ckpt->f);
+
+	if (ok && clock_type::now() - ckpt->synced >= std::chrono::seconds(SYNC_SECONDS)) {
+		ok = !fsync(fileno(ckpt->f));
+		ckpt->synced = clock_type::now();
+	}
+
+	if (!ok) {
+		perror(ckpt->path.c_str());
+		ckpt->failed = true;
+		return 1;
+	}
+
+	return 0;
+}
+
+extern "C" void checkpoint_close(struct render_checkpoint_s *ckpt, int finished)
+{
+	fclose(ckpt->f);
+
+	if (finished)
+		remove(ckpt->path.c_str());
+
+	delete ckpt;
+}
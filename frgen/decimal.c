@@ -0,0 +1,462 @@
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include "mbarray.h"
+#include "u32arr.h"
+#include "decimal.h"
+
+#define BASE_DIGITS		(9)		/* Digits per uint32_t in base case */
+#define BASE_POW		(1000000000UL)	/* 10^BASE_DIGITS */
+#define BASE_CASE_DIGITS	(BASE_DIGITS * 8)
+#define MAX_LEVELS		(48)
+
+/* 32 * log10(2). Decimal digits per uint32_t. */
+#define DIGITS_PER_U32		(9.63296)
+
+/* Powers of ten and their reciprocals for a single conversion. Kept per call
+ * rather than cached globally so that plugins may convert from several
+ * threads at once.
+ *
+ * pow[j] = 10^(BASE_DIGITS * 2^j)
+ * recip[j] = floor(B^scale[j] / pow[j]), B = 2^32
+ *
+ * scale[j] is picked so that recip[j] has a few more uint32_t's than pow[j].
+ * That keeps the error of a quotient by pow[j] estimated with recip[j] below
+ * one as long as the dividend is less than pow[j]^2. */
+struct dec_ctx_s {
+	struct mb_array_u32 pow[MAX_LEVELS];
+	struct mb_array_u32 recip[MAX_LEVELS];
+	size_t scale[MAX_LEVELS];
+	size_t pows;
+	size_t recips;
+};
+
+static void ctx_init(struct dec_ctx_s *ctx)
+{
+	ctx->pows = 0;
+	ctx->recips = 0;
+}
+
+static void ctx_destroy(struct dec_ctx_s *ctx)
+{
+	size_t i;
+
+	for (i = 0; i < ctx->pows; i++)
+		free(ctx->pow[i].buf);
+
+	for (i = 0; i < ctx->recips; i++)
+		free(ctx->recip[i].buf);
+}
+
+static struct mb_array_u32 arr_new(size_t len)
+{
+	struct mb_array_u32 ret;
+
+	ret.len = len;
+	ret.buf = calloc(len ? len : 1, sizeof(ret.buf[0]));
+
+	return ret;
+}
+
+static void arr_trim(struct mb_array_u32 *arr)
+{
+	arr->len = u32arr_trim(arr->buf, arr->len);
+}
+
+static struct mb_array_u32 arr_mul(const uint32_t *a, size_t a_len,
+		const uint32_t *b, size_t b_len)
+{
+	struct mb_array_u32 ret;
+
+	ret = arr_new(a_len + b_len);
+	u32arr_mul(ret.buf, a, a_len, b, b_len);
+	arr_trim(&ret);
+
+	return ret;
+}
+
+static const struct mb_array_u32 * ctx_pow(struct dec_ctx_s *ctx, size_t level)
+{
+	const struct mb_array_u32 *prev;
+
+	while (ctx->pows <= level) {
+		if (ctx->pows == 0) {
+			ctx->pow[0] = arr_new(1);
+			ctx->pow[0].buf[0] = BASE_POW;
+		} else {
+			prev = &ctx->pow[ctx->pows - 1];
+			ctx->pow[ctx->pows] = arr_mul(prev->buf, prev->len,
+					prev->buf, prev->len);
+		}
+		ctx->pows++;
+	}
+
+	return &ctx->pow[level];
+}
+
+/* Newton's iteration for recip = floor(B^scale / pow). Every step roughly
+ * doubles the number of correct uint32_t's, so a starting value that is right
+ * in its upper half only needs one or two. The last steps move by one until
+ * the remainder B^scale - pow * recip lies in [0, pow). */
+static void recip_refine(const struct mb_array_u32 *pow, struct mb_array_u32 *recip,
+		size_t scale)
+{
+	struct mb_array_u32 prod;
+	struct mb_array_u32 err;
+	struct mb_array_u32 corr;
+	size_t len;
+	size_t recip_len;
+	size_t corr_len;
+	int over;
+	static const uint32_t one = 1;
+
+	len = scale + 2;
+	recip_len = scale - pow->len + 2;
+	prod = arr_new(pow->len + recip_len);
+	err = arr_new(len);
+	corr = arr_new(recip_len + len);
+
+	for (;;) {
+		u32arr_mul(prod.buf, pow->buf, pow->len, recip->buf, recip_len);
+
+		memset(err.buf, 0, len * sizeof(err.buf[0]));
+		err.buf[scale] = 1;
+		over = u32arr_cmp(prod.buf, prod.len, err.buf, len) > 0;
+		if (over) {
+			memcpy(err.buf, prod.buf, len * sizeof(err.buf[0]));
+			u32arr_sub(err.buf + scale, len - scale, &one, 1);
+		} else {
+			u32arr_sub(err.buf, len, prod.buf, u32arr_trim(prod.buf, prod.len));
+			if (u32arr_cmp(err.buf, len, pow->buf, pow->len) < 0)
+				break;
+		}
+
+		u32arr_mul(corr.buf, recip->buf, recip_len, err.buf, u32arr_trim(err.buf, len));
+		corr_len = u32arr_trim(corr.buf + scale, corr.len - scale);
+		if (!corr_len) {
+			corr.buf[scale] = 1;
+			corr_len = 1;
+		}
+
+		if (over)
+			u32arr_sub(recip->buf, recip_len, corr.buf + scale, corr_len);
+		else
+			u32arr_add(recip->buf, recip_len, corr.buf + scale, corr_len);
+	}
+
+	free(prod.buf);
+	free(err.buf);
+	free(corr.buf);
+}
+
+static const struct mb_array_u32 * ctx_recip(struct dec_ctx_s *ctx, size_t level)
+{
+	struct mb_array_u32 *recip;
+	struct mb_array_u32 sqr;
+	const struct mb_array_u32 *pow;
+	const struct mb_array_u32 *prev;
+	size_t shift;
+	size_t len;
+	size_t j;
+
+	while (ctx->recips <= level) {
+		j = ctx->recips;
+		pow = ctx_pow(ctx, j);
+		recip = &ctx->recip[j];
+		ctx->scale[j] = 2 * pow->len + 3;
+		len = ctx->scale[j] - pow->len + 2;
+		*recip = arr_new(len);
+
+		/* The first one is a single division. Above that, squaring
+		 * the reciprocal from the level below gives a good enough
+		 * starting point. */
+		if (j == 0) {
+			recip->buf[ctx->scale[0]] = 1;
+			u32arr_div_u32(recip->buf, recip->len, BASE_POW);
+		} else {
+			prev = &ctx->recip[j - 1];
+			sqr = arr_mul(prev->buf, prev->len, prev->buf, prev->len);
+			shift = 2 * ctx->scale[j - 1] - ctx->scale[j];
+			memcpy(recip->buf, sqr.buf + shift,
+					((sqr.len - shift < len) ? sqr.len - shift : len)
+					* sizeof(recip->buf[0]));
+			free(sqr.buf);
+		}
+
+		recip_refine(pow, recip, ctx->scale[j]);
+		arr_trim(recip);
+		ctx->recips++;
+	}
+
+	return &ctx->recip[level];
+}
+
+/* Largest level whose power of ten has fewer digits than digits. */
+static size_t split_level(size_t digits)
+{
+	size_t level = 0;
+
+	while ((size_t)BASE_DIGITS << (level + 1) < digits)
+		level++;
+
+	return level;
+}
+
+/* Smallest level whose power of ten has at least digits digits. */
+static size_t cover_level(size_t digits)
+{
+	size_t level = 0;
+
+	while ((size_t)BASE_DIGITS << level < digits)
+		level++;
+
+	return level;
+}
+
+static uint32_t parse_u32(const char *digits, size_t len)
+{
+	uint32_t ret = 0;
+
+	while (len--)
+		ret = ret * 10 + (uint32_t)(*digits++ - '0');
+
+	return ret;
+}
+
+static struct mb_array_u32 parse_int(struct dec_ctx_s *ctx, const char *digits, size_t len)
+{
+	struct mb_array_u32 ret;
+	struct mb_array_u32 high;
+	struct mb_array_u32 low;
+	const struct mb_array_u32 *pow;
+	size_t chunk;
+	size_t low_digits;
+
+	if (len <= BASE_CASE_DIGITS) {
+		ret = arr_new(len / BASE_DIGITS + 1);
+		chunk = len % BASE_DIGITS;
+		if (chunk)
+			ret.buf[0] = parse_u32(digits, chunk);
+		for (; chunk < len; chunk += BASE_DIGITS)
+			u32arr_mul_u32(ret.buf, ret.len, BASE_POW,
+					parse_u32(digits + chunk, BASE_DIGITS));
+		arr_trim(&ret);
+		return ret;
+	}
+
+	low_digits = (size_t)BASE_DIGITS << split_level(len);
+	pow = ctx_pow(ctx, split_level(len));
+	high = parse_int(ctx, digits, len - low_digits);
+	low = parse_int(ctx, digits + len - low_digits, low_digits);
+
+	ret = arr_new(high.len + pow->len + 1);
+	u32arr_mul(ret.buf, high.buf, high.len, pow->buf, pow->len);
+	u32arr_add(ret.buf, ret.len, low.buf, low.len);
+	arr_trim(&ret);
+
+	free(high.buf);
+	free(low.buf);
+
+	return ret;
+}
+
+/* quot = n / pow[level], n %= pow[level]. n->len does not change. */
+static struct mb_array_u32 divmod_pow(struct dec_ctx_s *ctx, struct mb_array_u32 *n,
+		size_t level)
+{
+	const struct mb_array_u32 *pow;
+	const struct mb_array_u32 *recip;
+	struct mb_array_u32 prod;
+	struct mb_array_u32 quot;
+	size_t scale;
+	size_t n_len;
+	static const uint32_t one = 1;
+
+	pow = ctx_pow(ctx, level);
+	recip = ctx_recip(ctx, level);
+	scale = ctx->scale[level];
+	n_len = u32arr_trim(n->buf, n->len);
+
+	prod = arr_mul(n->buf, n_len, recip->buf, recip->len);
+	if (prod.len > scale) {
+		quot = arr_new(prod.len - scale + 1);
+		memcpy(quot.buf, prod.buf + scale, (prod.len - scale) * sizeof(quot.buf[0]));
+	} else {
+		quot = arr_new(1);
+	}
+	free(prod.buf);
+	arr_trim(&quot);
+
+	/* The reciprocal is never too big, so the quotient can only be short
+	 * by a little. */
+	prod = arr_mul(quot.buf, quot.len, pow->buf, pow->len);
+	u32arr_sub(n->buf, n->len, prod.buf, prod.len);
+	free(prod.buf);
+
+	quot.len++;
+	while (u32arr_cmp(n->buf, n->len, pow->buf, pow->len) >= 0) {
+		u32arr_sub(n->buf, n->len, pow->buf, pow->len);
+		u32arr_add(quot.buf, quot.len, &one, 1);
+	}
+	arr_trim(&quot);
+
+	return quot;
+}
+
+/* Writes exactly digits digits of n into str, padded with zeroes. n must be
+ * less than 10^digits. Consumes n. */
+static void format_int(struct dec_ctx_s *ctx, struct mb_array_u32 *n, char *str, size_t digits)
+{
+	struct mb_array_u32 quot;
+	size_t low_digits;
+	size_t level;
+	uint32_t rem;
+	size_t i;
+
+	n->len = u32arr_trim(n->buf, n->len);
+
+	if (digits <= BASE_CASE_DIGITS || n->len <= BASE_CASE_DIGITS / BASE_DIGITS) {
+		while (digits) {
+			rem = u32arr_div_u32(n->buf, n->len, BASE_POW);
+			for (i = 0; i < BASE_DIGITS && digits; i++, digits--) {
+				str[digits - 1] = (char)('0' + rem % 10);
+				rem /= 10;
+			}
+		}
+		return;
+	}
+
+	level = split_level(digits);
+	low_digits = (size_t)BASE_DIGITS << level;
+	quot = divmod_pow(ctx, n, level);
+
+	format_int(ctx, &quot, str, digits - low_digits);
+	format_int(ctx, n, str + digits - low_digits, low_digits);
+
+	free(quot.buf);
+}
+
+struct mb_array_u32 dec_parse_int(const char *digits, size_t len)
+{
+	struct dec_ctx_s ctx;
+	struct mb_array_u32 ret;
+
+	ctx_init(&ctx);
+	ret = parse_int(&ctx, digits, len);
+	ctx_destroy(&ctx);
+
+	if (!ret.len)
+		ret.len = 1;
+
+	return ret;
+}
+
+/* 0.<digits> = N / 10^D, so the fraction is N * B^u32s / 10^D. D is padded
+ * to a power the context knows and to at least as many digits as dest can
+ * tell apart, which keeps the dividend below the square of the divisor. */
+void dec_parse_frac(uint32_t *dest, size_t u32s, const char *digits, size_t len)
+{
+	struct dec_ctx_s ctx;
+	struct mb_array_u32 num;
+	struct mb_array_u32 shifted;
+	struct mb_array_u32 quot;
+	char *padded;
+	size_t padded_len;
+	size_t level;
+
+	memset(dest, 0, u32s * sizeof(dest[0]));
+	if (!len)
+		return;
+
+	level = cover_level((len > dec_frac_digits(u32s)) ? len : dec_frac_digits(u32s));
+	padded_len = (size_t)BASE_DIGITS << level;
+	padded = malloc(padded_len);
+	memcpy(padded, digits, len);
+	memset(padded + len, '0', padded_len - len);
+
+	ctx_init(&ctx);
+	num = parse_int(&ctx, padded, padded_len);
+	shifted = arr_new(num.len + u32s);
+	memcpy(shifted.buf + u32s, num.buf, num.len * sizeof(num.buf[0]));
+	quot = divmod_pow(&ctx, &shifted, level);
+	memcpy(dest, quot.buf, ((quot.len < u32s) ? quot.len : u32s) * sizeof(dest[0]));
+
+	free(quot.buf);
+	free(shifted.buf);
+	free(num.buf);
+	free(padded);
+	ctx_destroy(&ctx);
+}
+
+char * dec_format_int(const uint32_t *n, size_t len)
+{
+	struct dec_ctx_s ctx;
+	struct mb_array_u32 num;
+	char *str;
+	size_t digits;
+	size_t skip;
+
+	len = u32arr_trim(n, len);
+	digits = (size_t)(len * DIGITS_PER_U32) + 1;
+
+	num = arr_new(len);
+	memcpy(num.buf, n, len * sizeof(n[0]));
+	str = malloc(digits + 1);
+
+	ctx_init(&ctx);
+	format_int(&ctx, &num, str, digits);
+	ctx_destroy(&ctx);
+
+	for (skip = 0; skip + 1 < digits && str[skip] == '0'; skip++)
+		;
+	memmove(str, str + skip, digits - skip);
+	str[digits - skip] = '\0';
+
+	free(num.buf);
+
+	return str;
+}
+
+/* The first D digits of a fraction f are floor(f * 10^D). */
+char * dec_format_frac(const uint32_t *frac, size_t u32s, size_t digits)
+{
+	struct dec_ctx_s ctx;
+	struct mb_array_u32 prod;
+	struct mb_array_u32 num;
+	const struct mb_array_u32 *pow;
+	size_t level;
+	size_t padded_len;
+	char *str;
+
+	level = cover_level(digits);
+	padded_len = (size_t)BASE_DIGITS << level;
+
+	ctx_init(&ctx);
+	pow = ctx_pow(&ctx, level);
+
+	prod = arr_new(u32s + pow->len);
+	u32arr_mul(prod.buf, frac, u32s, pow->buf, pow->len);
+	num = arr_new(pow->len);
+	memcpy(num.buf, prod.buf + u32s, pow->len * sizeof(num.buf[0]));
+	free(prod.buf);
+
+	str = malloc(padded_len + 1);
+	format_int(&ctx, &num, str, padded_len);
+	str[digits] = '\0';
+
+	free(num.buf);
+	ctx_destroy(&ctx);
+
+	return str;
+}
+
+size_t dec_frac_digits(size_t u32s)
+{
+	return (size_t)ceil(u32s * DIGITS_PER_U32);
+}
+
+size_t dec_frac_u32s(size_t digits)
+{
+	return (size_t)ceil(digits / DIGITS_PER_U32);
+}
@@ -0,0 +1,641 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <chrono>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+#if !defined(_WIN32) && !defined(_WIN64)
+#include <signal.h>
+#include <unistd.h>
+#include <poll.h>
+#include <netdb.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#endif
+
+#include "distrib.h"
+#include "netio.h"
+#include "global.h"
+
+/* Workers send a heartbeat this often, and are given up on once nothing has
+ * come from them for LOST_SECONDS. */
+#define HEARTBEAT_SECONDS	(1)
+#define LOST_SECONDS		(5)
+
+/* A worker is handed as many tiles at a time as it draws in about this long,
+ * going by how fast it drew the ones before, up to MAX_RUN. */
+#define TARGET_SECONDS		(0.5)
+#define MAX_RUN				(16)
+
+/* Runs sent to a worker and not yet drawn. More than one keeps it busy
+ * while the last one it drew is on its way back. */
+#define MAX_IN_FLIGHT		(2)
+
+typedef std::chrono::steady_clock clock_type;
+
+#if !defined(_WIN32) && !defined(_WIN64)
+
+static int send_str(int fd, const std::string &str)
+{
+	return net_send_all(fd, str.data(), str.size());
+}
+
+/* Tiles first to first + count - 1 of a row, numbered row by row from the
+ * bottom. */
+struct run_s {
+	unsigned long first;
+	unsigned long count;
+};
+
+struct peer_s {
+	int fd;
+	std::string name;
+	std::string in;
+
+	/* 0 until the worker has said hello. */
+	unsigned threads;
+
+	/* Pixels a second, 0 until the first run comes back. */
+	double rate;
+	clock_type::time_point last_seen;
+	std::deque<struct run_s> runs;
+	bool lost;
+};
+
+struct coord_job_s {
+	const struct coordinator_s *coord;
+	unsigned long cols;
+	unsigned long rows;
+	std::deque<unsigned long> todo;
+	unsigned long done;
+	struct bmp_img *img;
+	std::string args;
+};
+
+static void run_rect(const struct coord_job_s *job, const struct run_s *run,
+	unsigned long *x, unsigned long *y, unsigned long *w, unsigned long *h)
+{
+	const struct coordinator_s *coord = job->coord;
+	unsigned long from_bottom = (run->first / job->cols) * DISTRIB_TILE;
+
+	/* Rows of tiles go up from the bottom, as the tiles of render_frame do,
+	 * so that every part splits into the same tiles as the whole image. */
+	*x = (run->first % job->cols) * DISTRIB_TILE;
+	*w = MB_MIN(run->count * DISTRIB_TILE, coord->width - *x);
+	*h = MB_MIN((unsigned long)DISTRIB_TILE, coord->height - from_bottom);
+	*y = coord->height - from_bottom - *h;
+}
+
+static unsigned long run_length(const struct peer_s *peer)
+{
+	double tiles = peer->rate * TARGET_SECONDS / (DISTRIB_TILE * DISTRIB_TILE);
+
+	if (tiles < 1)
+		return 1;
+
+	return (unsigned long)MB_MIN(tiles, (double)MAX_RUN);
+}
+
+/* Takes the next tiles to draw, as many as follow one another in a row. */
+static struct run_s take_run(struct coord_job_s *job, unsigned long length)
+{
+	struct run_s run;
+
+	run.first = job->todo.front();
+	run.count = 1;
+	job->todo.pop_front();
+
+	while (run.count < length && !job->todo.empty()
+			&& job->todo.front() == run.first + run.count
+			&& job->todo.front() / job->cols == run.first / job->cols) {
+		job->todo.pop_front();
+		run.count++;
+	}
+
+	return run;
+}
+
+/* Hands the worker runs until it has as many as it may. */
+static int dispatch(struct coord_job_s *job, struct peer_s *peer)
+{
+	struct run_s run;
+	unsigned long x;
+	unsigned long y;
+	unsigned long w;
+	unsigned long h;
+	char line[128];
+
+	while (peer->threads && peer->runs.size() < MAX_IN_FLIGHT && !job->todo.empty()) {
+		run = take_run(job, run_length(peer));
+		peer->runs.push_back(run);
+		run_rect(job, &run, &x, &y, &w, &h);
+
+		snprintf(line, sizeof(line), "TILE %lu %lu %lu %lu %lu\n", run.first, x, y, w, h);
+		if (net_send_all(peer->fd, line, strlen(line)))
+			return 1;
+	}
+
+	return 0;
+}
+
+/* Puts the runs of a lost worker back in front, to go out first. */
+static void drop_peer(struct coord_job_s *job, struct peer_s *peer)
+{
+	unsigned long tiles = 0;
+	unsigned long i;
+
+	while (!peer->runs.empty()) {
+		const struct run_s &run = peer->runs.back();
+
+		for (i = run.count; i--; )
+			job->todo.push_front(run.first + i);
+
+		tiles += run.count;
+		peer->runs.pop_back();
+	}
+
+	printf("Lost worker %s, %lu tiles to draw again\n", peer->name.c_str(), tiles);
+	close(peer->fd);
+}
+
+static void put_run(struct coord_job_s *job, struct peer_s *peer, const char *pixels,
+	unsigned long usec)
+{
+	const struct run_s run = peer->runs.front();
+	struct bmp_img *img = job->img;
+	unsigned long x;
+	unsigned long y;
+	unsigned long w;
+	unsigned long h;
+	unsigned long i;
+	double rate;
+
+	run_rect(job, &run, &x, &y, &w, &h);
+
+	/* Rows come bottom first, as in a bitmap. */
+	for (i = 0; i < h; i++) {
+		memcpy(&img->image[(img->height - y - h + i) * img->width + x],
+			pixels + i * w * sizeof(struct pixel), w * sizeof(struct pixel));
+	}
+
+	rate = (double)(w * h) / (MB_MAX(usec, 1UL) / 1e6);
+	peer->rate = peer->rate ? 0.7 * peer->rate + 0.3 * rate : rate;
+	peer->runs.pop_front();
+	job->done += run.count;
+
+	printf("Tile %lu / %lu from %s\n", job->done, job->cols * job->rows, peer->name.c_str());
+}
+
+/* Takes in what the worker has sent so far. Returns non-zero on anything
+ * that makes no sense. */
+static int handle_input(struct coord_job_s *job, struct peer_s *peer)
+{
+	unsigned long id;
+	unsigned long usec;
+	unsigned long x;
+	unsigned long y;
+	unsigned long w;
+	unsigned long h;
+	size_t bytes;
+	size_t end;
+	std::string line;
+
+	while ((end = peer->in.find('\n')) != std::string::npos) {
+		line = peer->in.substr(0, end);
+
+		if (line == "BEAT") {
+			peer->in.erase(0, end + 1);
+		} else if (sscanf(line.c_str(), "HELLO %u", &peer->threads) == 1 && peer->threads) {
+			printf("Worker %s joined with %u threads\n", peer->name.c_str(), peer->threads);
+			peer->in.erase(0, end + 1);
+		} else if (sscanf(line.c_str(), "DONE %lu %lu", &id, &usec) == 2
+				&& !peer->runs.empty() && peer->runs.front().first == id) {
+			run_rect(job, &peer->runs.front(), &x, &y, &w, &h);
+			bytes = w * h * sizeof(struct pixel);
+			if (peer->in.size() < end + 1 + bytes)
+				break;
+
+			put_run(job, peer, peer->in.data() + end + 1, usec);
+			peer->in.erase(0, end + 1 + bytes);
+		} else {
+			return 1;
+		}
+	}
+
+	return peer->in.size() > 256 && peer->in.find('\n') == std::string::npos;
+}
+
+static void accept_peer(struct coord_job_s *job, int fd, std::vector<struct peer_s> &peers)
+{
+	struct sockaddr_in addr;
+	socklen_t len = sizeof(addr);
+	struct peer_s peer;
+	char name[64];
+
+	peer.fd = accept(fd, (struct sockaddr *)&addr, &len);
+	if (peer.fd < 0)
+		return;
+
+	snprintf(name, sizeof(name), "%s:%u", inet_ntoa(addr.sin_addr), (unsigned)ntohs(addr.sin_port));
+	peer.name = name;
+	peer.threads = 0;
+	peer.rate = 0;
+	peer.last_seen = clock_type::now();
+	peer.lost = false;
+
+	if (send_str(peer.fd, job->args)) {
+		close(peer.fd);
+		return;
+	}
+
+	peers.push_back(peer);
+}
+
+/* Arguments for the workers, which leave out what only the coordinator
+ * does: where it listens, where the image goes and its own threads. */
+static std::string job_args(const struct coordinator_s *coord)
+{
+	std::vector<std::string> args;
+	std::string ret;
+	int i;
+
+	for (i = 1; i < coord->argc; i++) {
+		if (!strcmp(coord->argv[i], "--coordinate") || !strcmp(coord->argv[i], "--bind")
+				|| !strcmp(coord->argv[i], "-f") || !strcmp(coord->argv[i], "-t")) {
+			i++;
+			continue;
+		}
+
+		args.push_back(coord->argv[i]);
+	}
+
+	ret = "ARGS " + std::to_string(args.size()) + "\n";
+	for (const std::string &arg : args)
+		ret += arg + "\n";
+
+	return ret;
+}
+
+int coordinate(const struct coordinator_s *coord)
+{
+	std::vector<struct peer_s> peers;
+	std::vector<struct pollfd> fds;
+	struct coord_job_s job;
+	unsigned long total;
+	unsigned long i;
+	char buf[65536];
+	ssize_t got;
+	FILE *f;
+	int fd;
+
+	signal(SIGPIPE, SIG_IGN);
+
+	job.coord = coord;
+	job.cols = (coord->width + DISTRIB_TILE - 1) / DISTRIB_TILE;
+	job.rows = (coord->height + DISTRIB_TILE - 1) / DISTRIB_TILE;
+	job.done = 0;
+	job.args = job_args(coord);
+	total = job.cols * job.rows;
+	for (i = 0; i < total; i++)
+		job.todo.push_back(i);
+
+	if ((fd = net_listen("Coordinator", coord->host, coord->port, 16)) < 0)
+		return 1;
+
+	job.img = bmp_new(coord->width, coord->height);
+	printf("Waiting for workers on %s:%u\n", coord->host, (unsigned)coord->port);
+	fflush(stdout);
+
+	while (job.done < total) {
+		fds.resize(peers.size() + 1);
+		fds[0].fd = fd;
+		fds[0].events = POLLIN;
+		for (i = 0; i < peers.size(); i++) {
+			fds[i + 1].fd = peers[i].fd;
+			fds[i + 1].events = POLLIN;
+		}
+
+		if (poll(fds.data(), fds.size(), HEARTBEAT_SECONDS * 1000) < 0 && errno != EINTR) {
+			perror("poll");
+			break;
+		}
+
+		for (i = 0; i < peers.size(); i++) {
+			if (!(fds[i + 1].revents & (POLLIN | POLLHUP | POLLERR)))
+				continue;
+
+			got = recv(peers[i].fd, buf, sizeof(buf), 0);
+			if (got < 0 && errno == EINTR)
+				continue;
+
+			if (got <= 0) {
+				peers[i].lost = true;
+				continue;
+			}
+
+			peers[i].in.append(buf, (size_t)got);
+			peers[i].last_seen = clock_type::now();
+			peers[i].lost = handle_input(&job, &peers[i]) != 0;
+		}
+
+		if (fds[0].revents & POLLIN)
+			accept_peer(&job, fd, peers);
+
+		for (i = 0; i < peers.size(); i++) {
+			if (clock_type::now() - peers[i].last_seen > std::chrono::seconds(LOST_SECONDS))
+				peers[i].lost = true;
+		}
+
+		for (i = peers.size(); i--; ) {
+			if (peers[i].lost) {
+				drop_peer(&job, &peers[i]);
+				peers.erase(peers.begin() + i);
+			}
+		}
+
+		/* A worker that fails to take its runs is dropped next time
+		 * round. */
+		for (i = 0; i < peers.size(); i++)
+			peers[i].lost = dispatch(&job, &peers[i]) != 0;
+
+		fflush(stdout);
+	}
+
+	for (i = 0; i < peers.size(); i++) {
+		send_str(peers[i].fd, "QUIT\n");
+		close(peers[i].fd);
+	}
+
+	close(fd);
+
+	if (job.done < total) {
+		bmp_delete(job.img);
+		return 1;
+	}
+
+	printf("Rendering finished. Saving to %s\n", coord->path);
+
+	if (!(f = fopen(coord->path, "wb"))) {
+		fputs("Can't open file for writing!\n", stderr);
+		bmp_delete(job.img);
+		return 1;
+	}
+
+	bmp_write_f(job.img, f);
+	fclose(f);
+	bmp_delete(job.img);
+
+	return 0;
+}
+
+static int connect_to(const char *address)
+{
+	struct addrinfo hints;
+	struct addrinfo *res;
+	struct addrinfo *ai;
+	std::string host(address);
+	std::string port;
+	size_t colon;
+	int fd = -1;
+	int err;
+
+	colon = host.rfind(':');
+	if (colon == std::string::npos) {
+		fprintf(stderr, "Expected host:port, not %s\n", address);
+		return -1;
+	}
+
+	port = host.substr(colon + 1);
+	host.erase(colon);
+
+	memset(&hints, 0, sizeof(hints));
+	hints.ai_family = AF_UNSPEC;
+	hints.ai_socktype = SOCK_STREAM;
+
+	if ((err = getaddrinfo(host.c_str(), port.c_str(), &hints, &res))) {
+		fprintf(stderr, "%s: %s\n", address, gai_strerror(err));
+		return -1;
+	}
+
+	for (ai = res; ai; ai = ai->ai_next) {
+		fd = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+		if (fd < 0)
+			continue;
+		if (!connect(fd, ai->ai_addr, ai->ai_addrlen))
+			break;
+
+		close(fd);
+		fd = -1;
+	}
+
+	freeaddrinfo(res);
+
+	if (fd < 0)
+		perror(address);
+
+	return fd;
+}
+
+int worker_connect(struct worker_s *worker, const char *address, int argc, char **argv)
+{
+	std::string line;
+	unsigned long count;
+	unsigned long i;
+	int fd;
+
+	worker->fd = -1;
+	worker->in = NULL;
+	worker->argc = 0;
+	worker->argv = NULL;
+
+	if ((fd = connect_to(address)) < 0)
+		return 1;
+
+	worker->fd = fd;
+	worker->in = fdopen(dup(fd), "rb");
+
+	if (!worker->in || !net_read_line(worker->in, line)
+			|| sscanf(line.c_str(), "ARGS %lu", &count) != 1) {
+		fprintf(stderr, "No job from %s\n", address);
+		return 1;
+	}
+
+	/* The worker's own arguments come first, so they win over the job's. */
+	worker->argv = (char **)malloc(sizeof(char *) * ((size_t)argc + count + 1));
+	for (i = 0; i < (unsigned long)argc; i++)
+		worker->argv[worker->argc++] = strdup(argv[i]);
+
+	for (i = 0; i < count; i++) {
+		if (!net_read_line(worker->in, line)) {
+			fprintf(stderr, "No job from %s\n", address);
+			return 1;
+		}
+
+		worker->argv[worker->argc++] = strdup(line.c_str());
+	}
+
+	worker->argv[worker->argc] = NULL;
+
+	return 0;
+}
+
+struct beat_s {
+	int fd;
+	std::mutex lock;
+	std::condition_variable stop_cv;
+	bool stop;
+};
+
+/* Keeps telling the coordinator the worker is up while it draws. */
+static void heartbeat(struct beat_s *beat)
+{
+	std::unique_lock<std::mutex> guard(beat->lock);
+
+	while (!beat->stop_cv.wait_for(guard, std::chrono::seconds(HEARTBEAT_SECONDS),
+			[&] { return beat->stop; })) {
+		if (send_str(beat->fd, "BEAT\n"))
+			break;
+	}
+}
+
+static int send_run(struct beat_s *beat, unsigned long id, unsigned long usec,
+	const struct bmp_img *img)
+{
+	std::lock_guard<std::mutex> guard(beat->lock);
+	char line[64];
+
+	snprintf(line, sizeof(line), "DONE %lu %lu\n", id, usec);
+
+	return net_send_all(beat->fd, line, strlen(line))
+		|| net_send_all(beat->fd, img->image,
+			(size_t)img->width * img->height * sizeof(struct pixel));
+}
+
+int work(struct render_pool_s *pool, const struct worker_s *worker)
+{
+	struct beat_s beat;
+	struct bmp_img *img;
+	std::string line;
+	clock_type::time_point start;
+	unsigned long id;
+	unsigned long x;
+	unsigned long y;
+	unsigned long w;
+	unsigned long h;
+	unsigned long usec;
+	int ret = 1;
+
+	signal(SIGPIPE, SIG_IGN);
+
+	beat.fd = worker->fd;
+	beat.stop = false;
+
+	if (send_str(worker->fd, "HELLO " + std::to_string(render_pool_threads(pool)) + "\n"))
+		return 1;
+
+	std::thread beater(heartbeat, &beat);
+
+	while (net_read_line(worker->in, line)) {
+		if (line == "QUIT") {
+			ret = 0;
+			break;
+		}
+
+		if (sscanf(line.c_str(), "TILE %lu %lu %lu %lu %lu", &id, &x, &y, &w, &h) != 5
+				|| !w || !h || x + w > worker->width || y + h > worker->height) {
+			fprintf(stderr, "Bad request: %s\n", line.c_str());
+			break;
+		}
+
+		start = clock_type::now();
+		img = render_part(pool, &worker->frame, worker->width, worker->height,
+			worker->supersample_level, x, y, w, h);
+		usec = (unsigned long)std::chrono::duration_cast<std::chrono::microseconds>(
+			clock_type::now() - start).count();
+
+		printf("Drew %lu x %lu at (%lu, %lu) in %.3f s\n", w, h, x, y, usec / 1e6);
+		fflush(stdout);
+
+		if (send_run(&beat, id, usec, img)) {
+			bmp_delete(img);
+			break;
+		}
+
+		bmp_delete(img);
+	}
+
+	if (ret)
+		fputs("Lost the coordinator\n", stderr);
+
+	{
+		std::lock_guard<std::mutex> guard(beat.lock);
+		beat.stop = true;
+		beat.stop_cv.notify_one();
+	}
+
+	beater.join();
+
+	return ret;
+}
+
+void worker_close(struct worker_s *worker)
+{
+	int i;
+
+	if (worker->in)
+		fclose(worker->in);
+	if (worker->fd >= 0)
+		close(worker->fd);
+
+	for (i = 0; i < worker->argc; i++)
+		free(worker->argv[i]);
+
+	free(worker->argv);
+}
+
+#else
+
+int coordinate(const struct coordinator_s *coord)
+{
+	(void)coord;
+	fputs("Distributed rendering is not supported on this platform\n", stderr);
+
+	return 1;
+}
+
+int worker_connect(struct worker_s *worker, const char *address, int argc, char **argv)
+{
+	(void)address;
+	(void)argc;
+	(void)argv;
+	worker->fd = -1;
+	worker->in = NULL;
+	worker->argc = 0;
+	worker->argv = NULL;
+	fputs("Distributed rendering is not supported on this platform\n", stderr);
+
+	return 1;
+}
+
+int work(struct render_pool_s *pool, const struct worker_s *worker)
+{
+	(void)pool;
+	(void)worker;
+
+	return 1;
+}
+
+void worker_close(struct worker_s *worker)
+{
+	(void)worker;
+}
+
+#endif
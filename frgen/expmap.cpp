@@ -0,0 +1,240 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <math.h>
+
+#include <vector>
+#include <atomic>
+
+#include "expmap.h"
+#include "global.h"
+
+/* Rows of the strip handed out at a time. */
+#define BAND_ROWS			(8)
+
+/* Smallest distance between samples, relative to the size of the centre,
+ * that double precision still resolves. */
+#define MIN_RELATIVE_STEP	(1e-13)
+
+struct expmap_job_s {
+	const struct expmap_s *map;
+	const struct render_frame_s *frame;
+	std::atomic<size_t> next;
+	size_t count;
+
+	/* Frame to resample into and its log_outer - ln(step), over dr. */
+	struct bmp_img *img;
+	double u_offset;
+};
+
+/* Counts each band through the iterator's points function, as the samples of
+ * a polar grid do not make a request of their own. */
+static void draw_bands(void *arg, unsigned worker)
+{
+	struct expmap_job_s *job = (struct expmap_job_s *)arg;
+	const struct expmap_s *map = job->map;
+	const struct render_frame_s *frame = job->frame;
+	std::vector<unsigned> iterations(BAND_ROWS * map->cols);
+	std::vector<double> real(BAND_ROWS * map->cols);
+	std::vector<double> img(BAND_ROWS * map->cols);
+	std::vector<double> radius(map->cols);
+	struct frg_iteration_request_s spec;
+	struct frg_points_request_s req;
+	size_t band;
+	size_t rows;
+	size_t i;
+	size_t j;
+	double angle;
+	double cos_a;
+	double sin_a;
+
+	(void)worker;
+
+	for (j = 0; j < map->cols; j++)
+		radius[j] = exp(map->log_outer - (double)j * map->dr);
+
+	memset(&spec, 0, sizeof(spec));
+	spec.cols = (unsigned short)map->cols;
+	spec.iterations = frame->iterations;
+
+	req.iterations = frame->iterations;
+	req.real = real.data();
+	req.img = img.data();
+	req.counts = iterations.data();
+	req.final_real = NULL;
+	req.final_img = NULL;
+
+	while ((band = job->next++) < job->count) {
+		rows = MB_MIN(BAND_ROWS, map->rows - band * BAND_ROWS);
+
+		for (i = 0; i < rows; i++) {
+			angle = -M_PI + (double)(band * BAND_ROWS + i) * map->dr;
+			cos_a = cos(angle);
+			sin_a = sin(angle);
+
+			for (j = 0; j < map->cols; j++) {
+				real[i * map->cols + j] = frame->org.real + radius[j] * cos_a;
+				img[i * map->cols + j] = frame->org.img + radius[j] * sin_a;
+			}
+		}
+
+		req.count = rows * map->cols;
+		frame->points(&req, frame->params);
+
+		spec.rows = (unsigned short)rows;
+		frame->render(&spec, iterations.data(),
+			map->strip + band * BAND_ROWS * map->cols, frame->params);
+	}
+}
+
+int expmap_init(struct expmap_s *map, struct render_pool_s *pool,
+	const struct render_frame_s *frame, double r_outer, double r_inner,
+	uint16_t width, uint16_t height)
+{
+	struct expmap_job_s job;
+	uint16_t smaller_dimension;
+	double max_px;
+	double x;
+	double y;
+	size_t i;
+	size_t j;
+
+	smaller_dimension = MB_MIN(width, height);
+	if (r_inner / smaller_dimension < MIN_RELATIVE_STEP
+			* MB_MAX(1.0, MB_MAX(fabs(frame->org.real), fabs(frame->org.img)))) {
+		fputs("Exponential map frames are limited to double precision\n", stderr);
+		return 1;
+	}
+
+	if (!frame->points) {
+		fputs("Exponential maps need an iterator that takes points, such as mandelbrot-double\n",
+			stderr);
+		return 1;
+	}
+
+	/* One sample per pixel along the arc through the farthest corner, and
+	 * square samples, which makes the map conformal. The innermost column
+	 * lies half a pixel from the centre of the deepest frame. */
+	max_px = hypot(width - width / 2, height - height / 2);
+	map->rows = (size_t)ceil(2.0 * M_PI * max_px);
+	map->dr = 2.0 * M_PI / (double)map->rows;
+	map->log_outer = log(max_px * r_outer / smaller_dimension);
+	map->cols = (size_t)ceil((map->log_outer - log(0.5 * r_inner / smaller_dimension))
+		/ map->dr) + 1;
+
+	if (map->cols > USHRT_MAX) {
+		fputs("Exponential map too long, zoom in fewer steps\n", stderr);
+		return 1;
+	}
+
+	map->width = width;
+	map->height = height;
+	map->strip = (struct pixel *)malloc(map->rows * map->cols * sizeof(map->strip[0]));
+	map->pixel_log = (float *)malloc((size_t)width * height * sizeof(map->pixel_log[0]));
+	map->pixel_angle = (float *)malloc((size_t)width * height * sizeof(map->pixel_angle[0]));
+
+	printf("Exponential map: %zu angles x %zu radii\n", map->rows, map->cols);
+
+	for (i = 0; i < height; i++) {
+		for (j = 0; j < width; j++) {
+			x = (double)j - width / 2;
+			y = (double)i - height / 2;
+			map->pixel_log[i * width + j] = (x || y)
+				? (float)(log(hypot(x, y)) / map->dr)
+				: -INFINITY;
+			map->pixel_angle[i * width + j] = (float)((atan2(y, x) + M_PI) / map->dr);
+		}
+	}
+
+	job.map = map;
+	job.frame = frame;
+	job.next = 0;
+	job.count = (map->rows + BAND_ROWS - 1) / BAND_ROWS;
+
+	render_pool_run(pool, draw_bands, &job);
+
+	return 0;
+}
+
+void expmap_destroy(struct expmap_s *map)
+{
+	free(map->strip);
+	free(map->pixel_log);
+	free(map->pixel_angle);
+}
+
+static unsigned char blend(unsigned char a, unsigned char b, unsigned char c,
+	unsigned char d, float fu, float fv)
+{
+	float top;
+	float bottom;
+
+	top = a + (b - a) * fu;
+	bottom = c + (d - c) * fu;
+
+	return (unsigned char)(top + (bottom - top) * fv + 0.5f);
+}
+
+/* Bilinear lookup in the strip, wrapping around in angle. */
+static void resample_lines(void *arg, unsigned worker)
+{
+	struct expmap_job_s *job = (struct expmap_job_s *)arg;
+	const struct expmap_s *map = job->map;
+	const struct pixel *p[4];
+	struct pixel *out;
+	size_t line;
+	size_t col;
+	size_t idx;
+	size_t row0;
+	size_t row1;
+	size_t col0;
+	size_t col1;
+	double u;
+	double v;
+	float fu;
+	float fv;
+
+	(void)worker;
+
+	while ((line = job->next++) < job->count) {
+		for (col = 0; col < map->width; col++) {
+			idx = line * map->width + col;
+			u = job->u_offset - map->pixel_log[idx];
+			u = MB_MIN(MB_MAX(u, 0.0), (double)(map->cols - 1));
+			v = map->pixel_angle[idx];
+
+			col0 = (size_t)u;
+			col1 = MB_MIN(col0 + 1, map->cols - 1);
+			row0 = (size_t)v % map->rows;
+			row1 = (row0 + 1) % map->rows;
+			fu = (float)(u - floor(u));
+			fv = (float)(v - floor(v));
+
+			p[0] = &map->strip[row0 * map->cols + col0];
+			p[1] = &map->strip[row0 * map->cols + col1];
+			p[2] = &map->strip[row1 * map->cols + col0];
+			p[3] = &map->strip[row1 * map->cols + col1];
+			out = &job->img->image[idx];
+
+			out->r = blend(p[0]->r, p[1]->r, p[2]->r, p[3]->r, fu, fv);
+			out->g = blend(p[0]->g, p[1]->g, p[2]->g, p[3]->g, fu, fv);
+			out->b = blend(p[0]->b, p[1]->b, p[2]->b, p[3]->b, fu, fv);
+		}
+	}
+}
+
+void expmap_frame(const struct expmap_s *map, struct render_pool_s *pool,
+	struct bmp_img *img, double r)
+{
+	struct expmap_job_s job;
+
+	job.map = map;
+	job.frame = NULL;
+	job.next = 0;
+	job.count = map->height;
+	job.img = img;
+	job.u_offset = (map->log_outer - log(r / MB_MIN(map->width, map->height))) / map->dr;
+
+	render_pool_run(pool, resample_lines, &job);
+}
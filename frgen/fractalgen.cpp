@@ -5,16 +5,22 @@
 #include <math.h>
 #include <inttypes.h>
 
-#include <vector>
-#include <thread>
-#include <memory>
-
 #include "bmp.h"
 #include "hue.h"
 #include "cdouble.h"
 #include "fixed.h"
 #include "global.h"
+#include "big_fixed.h"
 #include "frgen_string.h"
+#include "render.h"
+#include "animate.h"
+#include "serve.h"
+#include "tileserve.h"
+#include "pyramid.h"
+#include "distrib.h"
+#include "scatter.h"
+#include "atlas.h"
+#include "points.h"
 
 #include "fractalgen/param_set.h"
 #include "fractalgen/plugin.h"
@@ -111,194 +117,89 @@ static unsigned long get_opt_ul(const char *opt, int offset,
 	return ret;
 }
 
-struct draw_lines_data_s {
-	struct frg_iteration_request_s spec;
-	unsigned * iterations;
-	struct pixel *img;
-	const struct frg_param_set_s *params;
-	iterate_fn iterate;
-	render_fn render;
-};
-
-static void draw_lines(struct draw_lines_data_s *data)
-{
-	data->iterate(&data->spec, data->iterations, data->params);
-	data->render(&data->spec, data->iterations, data->img, data->params);
-}
-
-static void join_all(std::vector<std::unique_ptr<std::thread>> &thread_pool)
-{
-	for (size_t i = 0; i < thread_pool.size(); i++) {
-		thread_pool[i].get()->join();
-	}
-}
-
-#ifndef NDEBUG
-
-static unsigned u_max(const unsigned *itr, size_t length)
+/* Parses a coordinate with every digit it was given. Falls back to the value
+ * already parsed as a double if the string is not a plain decimal number. */
+static void get_opt_bf(struct big_fixed *f, const char *opt, double val, size_t frac,
+		int argc, char **argv)
 {
-	size_t i;
-	unsigned ret;
-
-	ret = itr[0];
+	const char *str;
 
-	for (i = 1; i < length; i++) {
-		if (ret < itr[i]) {
-			ret = itr[i];
-		}
-	}
+	str = get_opt(opt, 1, NULL, argc, argv);
+	if (str && !bf_init_from_str(f, 1, frac, str))
+		return;
 
-	return ret;
+	if (str)
+		bf_destroy(f);
+	bf_init_d(f, 1, frac, val);
 }
 
-#define DUMP_COLS	(120)
-#define DUMP_ROWS	(35)
-
-static void dump_iterations(const unsigned *itr, size_t rows, size_t cols)
+/* Enough fractional uint32_t's for every digit of the viewport and for a step
+ * of radius / 2^16, with 64 bits to spare. */
+static size_t viewport_frac_u32s(int argc, char **argv)
 {
-	size_t i = 0;
-	size_t j = 0;
-	size_t a = 0;
-	size_t b = 0;
-	size_t line = 0;
-	size_t next_line = 0;
-	size_t col;
-	size_t next_col;
-	size_t rows_to_dump;
-	size_t cols_to_dump;
-	unsigned long sum;
-	unsigned max_itr;
-	unsigned char brightness;
-
-	max_itr = u_max(itr, rows * cols);
-
-	rows_to_dump = (rows < DUMP_ROWS) ? rows : DUMP_ROWS;
-	cols_to_dump = (cols < DUMP_COLS) ? cols : DUMP_COLS;
-
-	while (i < rows_to_dump) {
-		line = (rows * i) / rows_to_dump;
-		next_line = (rows * (i + 1)) / rows_to_dump;
-
-		if (line >= rows) {
-			break;
-		}
-
-		if (next_line >= rows) {
-			next_line = rows - 1;
-		}
-
-		j = 0;
-
-		while (j < cols_to_dump) {
-			col = (j * cols) / cols_to_dump;
-			next_col = ((j + 1) * cols) / cols_to_dump;
-
-			if (col >= cols) {
-				break;
-			}
-
-			if (next_col >= cols) {
-				next_col = cols - 1;
-			}
-
-			sum = 0;
+	size_t ret;
 
-			for (b = line; b <= next_line; b++) {
-				for (a = col; a <= next_col; a++) {
-					sum += itr[b * cols + a];
-				}
-			}
+	ret = bf_str_frac_u32s(get_opt("-x", 1, "0", argc, argv));
+	ret = MB_MAX(ret, bf_str_frac_u32s(get_opt("-y", 1, "0", argc, argv)));
+	ret = MB_MAX(ret, bf_str_frac_u32s(get_opt("-r", 1, "0", argc, argv)) + 1);
 
-			brightness = (unsigned char)(
-				255UL - ((sum * 255UL)
-					/
-				(((next_line - line + 1) * (next_col - col + 1)))) / max_itr
-			);
-
-			printf("\e[48;2;%u;%u;%um \e[0m", brightness, brightness, brightness);
-
-			j++;
-		}
-
-		putchar('\n');
-
-		i++;
-	}
+	return ret + 2;
 }
 
-#else
-#define dump_iterations(__itr, __r, __c)
-#endif
-
-static void draw_fractal(struct bmp_img *img, struct cdouble org, double r,
-	iterate_fn iterate, render_fn render, const struct frg_param_set_s *params)
+static int in_list(const char *arg, const char *const *list)
 {
-	std::vector<std::unique_ptr<std::thread>> thread_pool;
-	std::vector<struct draw_lines_data_s> data;
-	uint16_t i;
-	uint16_t lines_per_thread;
-	uint16_t lines_remainder;
-	double step;
-	uint16_t smaller_dimension;
-	struct draw_lines_data_s new_data;
-	unsigned *itrbuf;
-
-	smaller_dimension = (img->height < img->width)
-		? img->height
-		: img->width;
-	step = r / smaller_dimension;
-	lines_per_thread = img->height / threads;
-	lines_remainder = img->height % lines_per_thread;
-
-	if (lines_remainder == 0) {
-		lines_remainder = lines_per_thread;
+	for (; *list; list++) {
+		if (!strcmp(arg, *list))
+			return 1;
 	}
 
-	itrbuf = (unsigned *)calloc(img->width * img->height, sizeof(itrbuf[0]));
-
-	for (i = 0; i < threads - 1; i++) {
-		new_data.spec.rows = lines_per_thread;
-		new_data.spec.cols = img->width;
-		new_data.spec.iterations = attempts;
-		new_data.spec.from_x = org.real - step * (img->width / 2);
-		new_data.spec.from_y = org.img - step * (img->height / 2) + lines_per_thread * step * i;
-		new_data.spec.step = step;
+	return 0;
+}
 
-		new_data.iterations = itrbuf + i * lines_per_thread * img->width;
-		new_data.img = img->image + i * lines_per_thread * img->width;
-		new_data.params = params;
-		new_data.iterate = iterate;
-		new_data.render = render;
+/* The arguments that decide what a render draws, to tell what it left on
+ * disk from what other renders left: every argument as given, in order,
+ * apart from options in skip_values, along with the value after each, and
+ * those in skip. Those are left to options that only decide how fast or
+ * where to. A later run has to repeat the rest word for word, so -w 640 is
+ * not -w 0640 and moving an option makes another render. Iterators are not
+ * asked whether they changed, so a plugin rebuilt between runs has to draw
+ * the same counts. */
+static char * render_key(int argc, char **argv, const char *const *skip_values,
+	const char *const *skip)
+{
+	size_t length = 1;
+	char *key;
+	int i;
 
-		data.push_back(new_data);
-	}
+	for (i = 1; i < argc; i++)
+		length += strlen(argv[i]) + 1;
 
-	new_data.spec.rows = lines_remainder;
-	new_data.spec.cols = img->width;
-	new_data.spec.iterations = attempts;
-	new_data.spec.from_x = org.real - step * (img->width / 2);
-	new_data.spec.from_y = org.img - step * (img->height / 2) + lines_per_thread * step * i;
-	new_data.spec.step = step;
+	key = (char *)malloc(length);
+	key[0] = '\0';
 
-	new_data.iterations = itrbuf + i * lines_per_thread * img->width;
-	new_data.params = params;
-	new_data.img = img->image + i * lines_per_thread * img->width;
-	new_data.iterate = iterate;
-	new_data.render = render;
+	for (i = 1; i < argc; i++) {
+		if (in_list(argv[i], skip_values)) {
+			i++;
+			continue;
+		}
 
-	data.push_back(new_data);
+		if (in_list(argv[i], skip))
+			continue;
 
-	for (i = 0; i < threads; i++) {
-		thread_pool.push_back(std::make_unique<std::thread>(draw_lines , &data[i]));
+		if (key[0])
+			strcat(key, " ");
+		strcat(key, argv[i]);
 	}
 
-	join_all(thread_pool);
-
-	dump_iterations(itrbuf, img->height, img->width);
-
-	free(itrbuf);
+	return key;
 }
 
+/* What a checkpoint and a tile directory are not told apart by. */
+static const char *const checkpoint_skip_values[] = { "-t", NULL };
+static const char *const checkpoint_skip[] = { "--checkpoint", "--resume", NULL };
+static const char *const tile_skip_values[] = { "-t", "--http", "--tile-cache", "--tile-dir", NULL };
+static const char *const tile_skip[] = { NULL };
+
 static void gather_params(const int argc, const char **argv, struct frg_param_set_s *set)
 {
 	struct gr_dynarray params;
@@ -316,14 +217,16 @@ static void gather_params(const int argc, const char **argv, struct frg_param_se
 			if (eq_idx < 0) {
 				value.type = VALUE_NONE;
 				value.name = str_copy(argv[i] + 2);
+				value.text = NULL;
 			} else {
 				value.name = strn_copy(argv[i] + 2, eq_idx - 2);
+				value.text = str_copy(argv[i] + eq_idx + 1);
 
-				value.val.d = strtod(argv[i] + eq_idx + 1, &endptr);
+				value.val.d = strtod(value.text, &endptr);
 
 				if (*endptr) {
 					value.type = VALUE_STR;
-					value.val.str = str_copy(argv[i] + eq_idx + 1);
+					value.val.str = value.text;
 				} else {
 					value.type = VALUE_DOUBLE;
 				}
@@ -349,24 +252,82 @@ int main(int argc, char **argv)
 	size_t i;
 	struct frg_param_set_s params;
 	iterate_fn iterator_func = NULL;
+	unsigned iterator_flags = 0;
 	render_fn render_func = NULL;
 	struct frg_render_fn_repo_s iterators;
+	struct render_pool_s *pool;
+	struct render_frame_s frame;
+	struct animation_s anim;
+	struct render_reuse_s reuse;
+	struct render_adaptive_s adaptive;
+	struct frame_stream_s stream;
+	enum stream_format stream_format = STREAM_NONE;
+	struct server_s server;
+	struct tile_server_s tiles;
+	struct pyramid_s pyr;
+	struct scatter_s sc;
+	const char *scatter_plugin_name;
+	scatter_fn scatter_func = NULL;
+	struct atlas_s at;
+	sweep_fn sweep_func = NULL;
+	int mapping;
+	struct points_s pts;
+	const char *points_path;
+	const char *points_out;
+	points_fn points_func = NULL;
+	struct coordinator_s coord;
+	struct worker_s worker;
+	const char *worker_address;
+	char *ckpt_path;
+	char *ckpt_key;
+	char *tiles_key;
+	int resume;
+	int adapting;
+	int animating;
+	int serving;
+	size_t frac;
+	int ret = 0;
 
 #if defined(_WIN32) || defined(_WIN64)
 	_set_fmode(_O_BINARY);
 #endif
 
+	/* A worker takes everything else from the coordinator's arguments. */
+	worker_address = get_opt("--worker", 1, NULL, argc, argv);
+	if (worker_address) {
+		if (worker_connect(&worker, worker_address, argc, argv)) {
+			worker_close(&worker);
+			return 1;
+		}
+
+		argc = worker.argc;
+		argv = worker.argv;
+	}
+
 	width = get_opt_u16("-w", 1, 640, argc, argv);
 	height = get_opt_u16("-h", 1, 480, argc, argv);
 	origin.real = get_opt_d("-x", 1, 0.0, argc, argv);
 	origin.img = get_opt_d("-y", 1, 0.0, argc, argv);
 	radius = get_opt_d("-r", 1, 1.5, argc, argv);
-	attempts = get_opt_ul("-a", 1, 1000, argc, argv);
+	frac = viewport_frac_u32s(argc, argv);
+	get_opt_bf(&origin_real_bf, "-x", origin.real, frac, argc, argv);
+	get_opt_bf(&origin_img_bf, "-y", origin.img, frac, argc, argv);
+	get_opt_bf(&radius_bf, "-r", radius, frac, argc, argv);
+	adapting = opt_is_set("--adaptive", 1, 0, argc, argv);
+	attempts = get_opt_ul("-a", 1, adapting ? 1000000 : 1000, argc, argv);
 	threads = get_opt_u16("-t", 1, 4, argc, argv);
+	tile_size = get_opt_u16("--tile", 1, 64, argc, argv);
 	supersample_level = get_opt_u16("-s", 1, 0, argc, argv);
-	iterate_plugin_name = get_opt("--iterate", 1, "mandelbrot-double", argc, argv);
+	mapping = opt_is_set("--atlas", 1, 0, argc, argv);
+	iterate_plugin_name = get_opt("--iterate", 1, mapping ? "julia-double" : "mandelbrot-double",
+		argc, argv);
 	render_plugin_name = get_opt("--render", 1, "render-rgb", argc, argv);
 	list_funcs = get_opt("--list", 0, NULL, argc, argv) != NULL;
+	animating = get_opt("--animate", 1, NULL, argc, argv)
+		|| get_opt("--keyframes", 1, NULL, argc, argv);
+	serving = opt_is_set("--serve", 1, 0, argc, argv);
+	scatter_plugin_name = get_opt("--scatter", 1, NULL, argc, argv);
+	points_path = get_opt("--points", 1, NULL, argc, argv);
 
 	gather_params(argc, (const char **)argv, &params);
 
@@ -374,6 +335,42 @@ int main(int argc, char **argv)
 		return 0;
 	}
 
+	/* Opened ahead of everything else, which prints to stderr instead if
+	 * frames go to stdout. */
+	if (get_opt("--stream", 1, NULL, argc, argv)) {
+		stream_format = stream_format_parse(get_opt("--stream", 1, NULL, argc, argv));
+
+		if (stream_format == STREAM_NONE || !animating) {
+			fputs("--stream takes y4m or rgb, and --animate or --keyframes\n", stderr);
+			return 1;
+		}
+
+		if (stream_open(&stream, get_opt("-f", 1, "-", argc, argv), stream_format,
+				width, height, supersample_level, get_opt_u16("--fps", 1, 30, argc, argv)))
+			return 1;
+	}
+
+	server.socket_path = get_opt("--socket", 1, NULL, argc, argv);
+	server.in = stdin;
+	server.out = NULL;
+
+	if (serving && !server.socket_path && !(server.out = stream_take_stdout())) {
+		fputs("Can't answer requests on stdout\n", stderr);
+		return 1;
+	}
+
+	/* Counts go to stdout unless -f says otherwise, and everything else to
+	 * stderr. */
+	if (points_path) {
+		points_out = get_opt("-f", 1, "-", argc, argv);
+		pts.out = strcmp(points_out, "-") ? fopen(points_out, "w") : stream_take_stdout();
+
+		if (!pts.out) {
+			fprintf(stderr, "Can't open %s for writing!\n", points_out);
+			return 1;
+		}
+	}
+
 	const char *plugin_pattern = getenv("FRACTALGEN_PLUGIN_PATTERN");
 
 	if (!plugin_pattern) {
@@ -388,7 +385,13 @@ int main(int argc, char **argv)
 	}
 
 	iterator_func = frg_fn_repo_get_iterator(&iterators, iterate_plugin_name);
+	iterator_flags = frg_fn_repo_get_iterator_flags(&iterators, iterate_plugin_name);
 	render_func = frg_fn_repo_get_renderer(&iterators, render_plugin_name);
+	if (scatter_plugin_name)
+		scatter_func = frg_fn_repo_get_scatter(&iterators, scatter_plugin_name);
+	if (mapping)
+		sweep_func = frg_fn_repo_get_sweep(&iterators, iterate_plugin_name);
+	points_func = frg_fn_repo_get_points(&iterators, iterate_plugin_name);
 
 	if (iterator_func == NULL) {
 		fprintf(stderr, "Cannot find iteration function %s!\n", iterate_plugin_name);
@@ -400,6 +403,21 @@ int main(int argc, char **argv)
 		return 1;
 	}
 
+	if (scatter_plugin_name && scatter_func == NULL) {
+		fprintf(stderr, "Cannot find scatter function %s!\n", scatter_plugin_name);
+		return 1;
+	}
+
+	if (mapping && sweep_func == NULL) {
+		fprintf(stderr, "Cannot find sweep function %s!\n", iterate_plugin_name);
+		return 1;
+	}
+
+	if (points_path && points_func == NULL) {
+		fprintf(stderr, "Cannot find points function %s!\n", iterate_plugin_name);
+		return 1;
+	}
+
 	frg_fn_repo_destroy(&iterators);
 
 	printf("Iterating %s\nRendering %s\n", iterate_plugin_name, render_plugin_name);
@@ -408,37 +426,225 @@ int main(int argc, char **argv)
 		threads = 1;
 	}
 
-	file = get_opt("-f", 1, "bitmap.bmp", argc, argv);
-
-	if (!(f = fopen(file, "w"))) {
-		fputs("Can't open file for writing!\n", stderr);
-		return 1;
+	if (!tile_size) {
+		tile_size = 64;
 	}
 
+	frame.img = NULL;
+	frame.org = origin;
+	frame.r = radius;
+	frame.org_real_bf = &origin_real_bf;
+	frame.org_img_bf = &origin_img_bf;
+	frame.r_bf = &radius_bf;
+	frame.iterations = attempts;
+	frame.iterate = iterator_func;
+	frame.iterate_flags = iterator_flags;
+	frame.render = render_func;
+	frame.params = &params;
+	frame.points = points_func;
+	frame.reuse = NULL;
+	frame.incremental = opt_is_set("--incremental", 1, 0, argc, argv);
+	frame.checkpoint = NULL;
+	frame.adaptive = adapting ? &adaptive : NULL;
+
 	printf("Super-sample level %" PRIu16 "\n", supersample_level);
 	printf("Base width: %" PRIu16 "\n", width * (1 << supersample_level));
 	printf("Base height: %" PRIu16 "\n", height * (1 << supersample_level));
 	printf("Threads: %" PRIu16 "\n", threads);
-	img = bmp_new(width * (1 << supersample_level), height * (1 << supersample_level));
-	draw_fractal(img, origin, radius, iterator_func, render_func, &params);
-	printf("Rendering finished. Saving to %s\n", file);
+	pool = render_pool_new(threads);
+
+	if (worker_address) {
+		worker.width = width;
+		worker.height = height;
+		worker.supersample_level = supersample_level;
+		worker.frame = frame;
+
+		ret = work(pool, &worker);
+	} else if (get_opt("--coordinate", 1, NULL, argc, argv)) {
+		coord.host = get_opt("--bind", 1, "127.0.0.1", argc, argv);
+		coord.port = get_opt_u16("--coordinate", 1, 7070, argc, argv);
+		coord.path = get_opt("-f", 1, "bitmap.bmp", argc, argv);
+		coord.width = width;
+		coord.height = height;
+		coord.argc = argc;
+		coord.argv = argv;
+
+		ret = coordinate(&coord);
+	} else if (scatter_plugin_name) {
+		sc.path = get_opt("-f", 1, "bitmap.bmp", argc, argv);
+		sc.width = width;
+		sc.height = height;
+		sc.supersample_level = supersample_level;
+		sc.orbits = get_opt_ul("--orbits", 1,
+			100ul * width * height << (2 * supersample_level), argc, argv);
+		sc.gamma = get_opt_d("--gamma", 1, 0.5, argc, argv);
+		sc.scatter = scatter_func;
+		sc.frame = frame;
+
+		ret = scatter(pool, &sc);
+	} else if (mapping) {
+		at.path = get_opt("-f", 1, "bitmap.bmp", argc, argv);
+		at.cols = (unsigned)get_opt_ul("--atlas", 1, 10, argc, argv);
+		at.rows = (unsigned)get_opt_ul("--atlas-rows", 1, at.cols, argc, argv);
+		at.thumb = get_opt_u16("--thumb", 1, 64, argc, argv);
+		at.supersample_level = supersample_level;
+		at.julia_r = get_opt_d("--julia-r", 1, 3.2, argc, argv);
+		at.sweep = sweep_func;
+		at.frame = frame;
+
+		ret = atlas(pool, &at);
+	} else if (points_path) {
+		pts.in = strcmp(points_path, "-") ? fopen(points_path, "r") : stdin;
+		pts.final_z = opt_is_set("--final-z", 1, 0, argc, argv);
+		pts.frame = frame;
+
+		if (pts.in) {
+			ret = points(pool, &pts);
+		} else {
+			perror(points_path);
+			ret = 1;
+		}
 
-	if (supersample_level) {
-		downsampled_img = bmp_downsample(img, supersample_level);
-		bmp_write_f(downsampled_img, f);
+		if (pts.in && pts.in != stdin)
+			fclose(pts.in);
+
+		fclose(pts.out);
+	} else if (get_opt("--pyramid", 1, NULL, argc, argv)) {
+		pyr.dir = get_opt("--pyramid", 1, NULL, argc, argv);
+		pyr.width = get_opt_ul("-w", 1, 640, argc, argv);
+		pyr.height = get_opt_ul("-h", 1, 480, argc, argv);
+		pyr.supersample_level = supersample_level;
+		pyr.frame = frame;
+
+		ret = pyramid(pool, &pyr);
+	} else if (get_opt("--http", 1, NULL, argc, argv)) {
+		tiles.port = get_opt_u16("--http", 1, 8080, argc, argv);
+		tiles.cache_bytes = get_opt_ul("--tile-cache", 1, 64, argc, argv) << 20;
+		tiles.dir = get_opt("--tile-dir", 1, NULL, argc, argv);
+		tiles_key = render_key(argc, argv, tile_skip_values, tile_skip);
+		tiles.key = tiles_key;
+		tiles.supersample_level = supersample_level;
+		tiles.frame = frame;
+
+		ret = tile_serve(pool, &tiles);
+		free(tiles_key);
+	} else if (serving) {
+		server.supersample_level = supersample_level;
+		server.frame = frame;
+
+		ret = serve(pool, &server);
+
+		if (server.out)
+			fclose(server.out);
+	} else if (animating) {
+		anim.keyframes = get_opt("--keyframes", 1, NULL, argc, argv);
+		anim.frames = get_opt_ul("--animate", 1, 120, argc, argv);
+		anim.x = get_opt("-x", 1, "0", argc, argv);
+		anim.y = get_opt("-y", 1, "0", argc, argv);
+		anim.zoom_from = get_opt_d("--zoom-from", 1, 0.0, argc, argv);
+		anim.zoom_to = get_opt_d("--zoom-to", 1, 15.0, argc, argv);
+		anim.smoothing = get_opt_d("--smoothing", 1, 0.1, argc, argv);
+		anim.exp_map = opt_is_set("--exp-map", 1, 0, argc, argv);
+		anim.refresh = get_opt_ul("--reuse-refresh", 1, 25, argc, argv);
+		anim.path = get_opt("-f", 1, "%u_frame.bmp", argc, argv);
+		anim.stream = (stream_format != STREAM_NONE) ? &stream : NULL;
+		anim.width = width;
+		anim.height = height;
+		anim.supersample_level = supersample_level;
+		anim.frame = frame;
+
+		if (get_opt("--reuse", 1, NULL, argc, argv)) {
+			reuse.tolerance = get_opt_d("--reuse", 1, 1.0, argc, argv);
+			reuse.edge = (unsigned)get_opt_ul("--reuse-edge", 1, 0, argc, argv);
+			anim.frame.reuse = &reuse;
+		}
+
+		ret = animate(pool, &anim);
+
+		if (anim.stream)
+			stream_close(&stream);
 	} else {
-		bmp_write_f(img, f);
+		file = get_opt("-f", 1, "bitmap.bmp", argc, argv);
+
+		if (!(f = fopen(file, "w"))) {
+			fputs("Can't open file for writing!\n", stderr);
+			render_pool_delete(pool);
+			return 1;
+		}
+
+		resume = opt_is_set("--resume", 1, 0, argc, argv);
+		if (resume || opt_is_set("--checkpoint", 1, 0, argc, argv)) {
+			ckpt_path = (char *)malloc(strlen(file) + sizeof(".ckpt"));
+			sprintf(ckpt_path, "%s.ckpt", file);
+			ckpt_key = render_key(argc, argv, checkpoint_skip_values, checkpoint_skip);
+			frame.checkpoint = checkpoint_open(ckpt_path, ckpt_key, resume);
+			free(ckpt_key);
+
+			if (!frame.checkpoint) {
+				free(ckpt_path);
+				fclose(f);
+				render_pool_delete(pool);
+				return 1;
+			}
+
+			if (checkpoint_restored(frame.checkpoint)) {
+				printf("Resuming from %s, %zu tiles done\n", ckpt_path,
+					checkpoint_restored(frame.checkpoint));
+			}
+
+			free(ckpt_path);
+		}
+
+		img = bmp_new(width * (1 << supersample_level), height * (1 << supersample_level));
+		frame.img = img;
+		/* Only a log that can't be written cancels the frame. */
+		if (render_frame(pool, &frame)) {
+			fputs("Checkpoint can't be written, stopping. --resume goes on from the tiles "
+				"it holds\n", stderr);
+			checkpoint_close(frame.checkpoint, 0);
+			bmp_delete(img);
+			fclose(f);
+			render_pool_delete(pool);
+			return 1;
+		}
+
+		if (frame.adaptive) {
+			printf("Probe settled at %u iterations\n", adaptive.probe);
+			for (i = 0; i < adaptive.count; i++)
+				printf("%zu tiles at %u iterations\n", adaptive.tiles[i], adaptive.budgets[i]);
+		}
+
+		printf("Rendering finished. Saving to %s\n", file);
+
+		if (supersample_level) {
+			downsampled_img = bmp_downsample(img, supersample_level);
+			ret = bmp_write_f(downsampled_img, f) != BMP_SUCCESS;
+		} else {
+			ret = bmp_write_f(img, f) != BMP_SUCCESS;
+		}
+
+		ret = fclose(f) || ret;
+
+		/* The log goes once the image it was for is safely written. */
+		if (frame.checkpoint)
+			checkpoint_close(frame.checkpoint, !ret);
+
+		bmp_delete(img);
+		bmp_delete(downsampled_img);
 	}
 
-	fclose(f);
-	bmp_delete(img);
-	bmp_delete(downsampled_img);
+	render_pool_delete(pool);
 
 	for (i = 0; (int)i < params.length; i++) {
-		if (params.values[i].type == VALUE_STR) {
-			free(params.values[i].val.str);
-		}
+		free(params.values[i].text);
 	}
 
-	return 0;
+	bf_destroy(&origin_real_bf);
+	bf_destroy(&origin_img_bf);
+	bf_destroy(&radius_bf);
+
+	if (worker_address)
+		worker_close(&worker);
+
+	return ret;
 }
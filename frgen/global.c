@@ -1,6 +1,7 @@
 #include <stdlib.h>
 #include <stdint.h>
 #include "cdouble.h"
+#include "big_fixed.h"
 
 #ifdef __cplusplus
 extern "C"
@@ -14,7 +15,11 @@ struct cdouble origin = { 0.0, 0.0 };
 const char *file = "bitmap.bmp";
 unsigned long attempts = 1000;
 uint16_t threads = 4;
+uint16_t tile_size = 64;
 uint16_t supersample_level = 0;
+struct big_fixed origin_real_bf;
+struct big_fixed origin_img_bf;
+struct big_fixed radius_bf;
 
 #ifdef __cplusplus
 }
@@ -0,0 +1,106 @@
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+
+#include <string>
+
+#if !defined(_WIN32) && !defined(_WIN64)
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#endif
+
+#include "netio.h"
+
+bool net_read_line(FILE *in, std::string &line)
+{
+	char buf[256];
+	size_t len;
+
+	line.clear();
+	while (fgets(buf, sizeof(buf), in)) {
+		len = strlen(buf);
+		if (len && buf[len - 1] == '\n') {
+			line.append(buf, len - 1);
+			return true;
+		}
+
+		line.append(buf, len);
+	}
+
+	return !line.empty();
+}
+
+#if !defined(_WIN32) && !defined(_WIN64)
+
+extern "C" int net_send_all(int fd, const void *buf, size_t length)
+{
+	const char *p = (const char *)buf;
+	ssize_t sent;
+
+	while (length) {
+		sent = send(fd, p, length, 0);
+		if (sent < 0 && errno == EINTR)
+			continue;
+		if (sent <= 0)
+			return 1;
+
+		p += sent;
+		length -= (size_t)sent;
+	}
+
+	return 0;
+}
+
+extern "C" int net_listen(const char *who, const char *host, unsigned short port, int backlog)
+{
+	struct sockaddr_in addr;
+	int one = 1;
+	int fd;
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_port = htons(port);
+
+	if (inet_pton(AF_INET, host, &addr.sin_addr) != 1) {
+		fprintf(stderr, "%s: %s is not an IPv4 address\n", who, host);
+		return -1;
+	}
+
+	fd = socket(AF_INET, SOCK_STREAM, 0);
+	if (fd >= 0)
+		setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+
+	if (fd < 0 || bind(fd, (struct sockaddr *)&addr, sizeof(addr)) || listen(fd, backlog)) {
+		perror(who);
+		if (fd >= 0)
+			close(fd);
+		return -1;
+	}
+
+	return fd;
+}
+
+#else
+
+extern "C" int net_send_all(int fd, const void *buf, size_t length)
+{
+	(void)fd;
+	(void)buf;
+	(void)length;
+
+	return 1;
+}
+
+extern "C" int net_listen(const char *who, const char *host, unsigned short port, int backlog)
+{
+	(void)host;
+	(void)port;
+	(void)backlog;
+	fprintf(stderr, "%s: not supported on this platform\n", who);
+
+	return -1;
+}
+
+#endif
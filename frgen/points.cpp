@@ -0,0 +1,138 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+
+#include <vector>
+#include <atomic>
+
+#include "points.h"
+#include "global.h"
+
+/* Longest line read. */
+#define LINE_LENGTH	(256)
+
+struct points_job_s {
+	const struct points_s *pts;
+	size_t count;
+	std::atomic<size_t> next;
+
+	std::vector<double> real;
+	std::vector<double> img;
+	std::vector<unsigned> counts;
+	std::vector<double> final_real;
+	std::vector<double> final_img;
+};
+
+static void count_points(void *arg, unsigned worker)
+{
+	struct points_job_s *job = (struct points_job_s *)arg;
+	struct frg_points_request_s req;
+	size_t first;
+
+	(void)worker;
+
+	req.iterations = job->pts->frame.iterations;
+
+	while ((first = job->next.fetch_add(POINTS_TASK)) < job->count) {
+		req.count = MB_MIN((size_t)POINTS_TASK, job->count - first);
+		req.real = job->real.data() + first;
+		req.img = job->img.data() + first;
+		req.counts = job->counts.data() + first;
+		req.final_real = job->pts->final_z ? job->final_real.data() + first : NULL;
+		req.final_img = job->pts->final_z ? job->final_img.data() + first : NULL;
+
+		job->pts->frame.points(&req, job->pts->frame.params);
+	}
+}
+
+/* Reads up to POINTS_BATCH points. Returns non-zero on a line that is not
+ * one. */
+static int read_batch(struct points_job_s *job, FILE *in, unsigned long *line)
+{
+	char buf[LINE_LENGTH];
+	char *p;
+	char *end;
+	double x;
+	double y;
+
+	job->count = 0;
+
+	while (job->count < POINTS_BATCH && fgets(buf, sizeof(buf), in)) {
+		++*line;
+
+		for (p = buf; isspace((unsigned char)*p); p++)
+			;
+
+		if (!*p || *p == '#')
+			continue;
+
+		x = strtod(p, &end);
+		if (end == p)
+			goto bad_line;
+
+		p = end;
+		y = strtod(p, &end);
+		if (end == p)
+			goto bad_line;
+
+		for (p = end; isspace((unsigned char)*p); p++)
+			;
+
+		if (*p)
+			goto bad_line;
+
+		job->real[job->count] = x;
+		job->img[job->count] = y;
+		job->count++;
+	}
+
+	return 0;
+
+bad_line:
+	fprintf(stderr, "Line %lu is not a point: %s", *line, buf);
+	return 1;
+}
+
+extern "C" int points(struct render_pool_s *pool, const struct points_s *pts)
+{
+	struct points_job_s job;
+	unsigned long line = 0;
+	unsigned long long total = 0;
+	size_t i;
+
+	job.pts = pts;
+	job.real.resize(POINTS_BATCH);
+	job.img.resize(POINTS_BATCH);
+	job.counts.resize(POINTS_BATCH);
+
+	if (pts->final_z) {
+		job.final_real.resize(POINTS_BATCH);
+		job.final_img.resize(POINTS_BATCH);
+	}
+
+	do {
+		if (read_batch(&job, pts->in, &line))
+			return 1;
+
+		job.next = 0;
+		render_pool_run(pool, count_points, &job);
+
+		for (i = 0; i < job.count; i++) {
+			if (pts->final_z) {
+				fprintf(pts->out, "%.17g %.17g %u %.17g %.17g\n", job.real[i], job.img[i],
+					job.counts[i], job.final_real[i], job.final_img[i]);
+			} else {
+				fprintf(pts->out, "%.17g %.17g %u\n", job.real[i], job.img[i],
+					job.counts[i]);
+			}
+		}
+
+		total += job.count;
+	} while (job.count == POINTS_BATCH);
+
+	fflush(pts->out);
+	fprintf(stderr, "Counted %llu points\n", total);
+
+	return 0;
+}
@@ -0,0 +1,417 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <memory>
+
+#if defined(_WIN32) || defined(_WIN64)
+#include <direct.h>
+#define mkdir(__path, __mode) _mkdir(__path)
+#else
+#include <sys/stat.h>
+#endif
+
+#include "pyramid.h"
+#include "global.h"
+
+/* Blocks are drawn this many levels above the full image, which makes them
+ * 1024 pixels wide. */
+#define BLOCK_LEVELS	(2)
+
+/* Images queued for a level but not yet cut into tiles. Bounds memory if a
+ * level falls behind. */
+#define MAX_QUEUED		(2)
+
+struct level_s {
+	unsigned long width;
+	unsigned long height;
+	unsigned long cols;
+	unsigned long rows;
+};
+
+/* Block (col, row) of the block level, at the resolution of some level at or
+ * above it, or tile (col, row) of a level below it. */
+struct block_s {
+	unsigned long col;
+	unsigned long row;
+	struct bmp_img *img;
+};
+
+/* Tile of a level waiting for the tiles below it. */
+struct parent_s {
+	struct bmp_img *canvas;
+	unsigned missing;
+};
+
+/* Every level has a thread of its own, which cuts what is queued for it
+ * into tiles and queues it halved for the level below. */
+struct stage_s {
+	std::mutex lock;
+	std::condition_variable changed;
+	std::deque<struct block_s> queue;
+	bool closed;
+	std::thread thread;
+
+	/* Tile of the level below that this level fills in, below the block
+	 * level. */
+	struct parent_s parent;
+};
+
+struct pyramid_job_s {
+	const struct pyramid_s *pyr;
+	std::vector<struct level_s> levels;
+	unsigned top;
+	unsigned block_level;
+	unsigned long block_px;
+	std::string files;
+
+	/* One per level. Blocks come in Z order, so the tiles under a parent
+	 * come one after the other. */
+	std::unique_ptr<struct stage_s[]> stages;
+	std::atomic<bool> failed;
+};
+
+/* Rows of bmp_img run from the bottom. Pyramids count them from the top. */
+static uint16_t bottom_row(const struct bmp_img *img, unsigned long top_row)
+{
+	return (uint16_t)(img->height - 1 - top_row);
+}
+
+static struct bmp_img * crop(const struct bmp_img *src, unsigned long x, unsigned long y,
+	unsigned long width, unsigned long height)
+{
+	struct bmp_img *dest;
+	unsigned long i;
+
+	dest = bmp_new((uint16_t)width, (uint16_t)height);
+
+	for (i = 0; i < height; i++) {
+		memcpy(&BMP_AT(dest, 0, bottom_row(dest, i)),
+			&BMP_AT(src, x, bottom_row(src, y + i)), width * sizeof(struct pixel));
+	}
+
+	return dest;
+}
+
+static void blit(struct bmp_img *dest, const struct bmp_img *src, unsigned long x,
+	unsigned long y)
+{
+	unsigned long i;
+
+	for (i = 0; i < src->height; i++) {
+		memcpy(&BMP_AT(dest, x, bottom_row(dest, y + i)),
+			&BMP_AT(src, 0, bottom_row(src, i)), src->width * sizeof(struct pixel));
+	}
+}
+
+/* Box filter over 2 x 2 pixels counted from the top left, like
+ * bmp_downsample. An odd last row or column is averaged on its own. */
+static struct bmp_img * halve(const struct bmp_img *src)
+{
+	struct bmp_img *dest;
+	unsigned long rows;
+	unsigned long cols;
+	unsigned long x;
+	unsigned long y;
+
+	dest = bmp_new((uint16_t)((src->width + 1) / 2), (uint16_t)((src->height + 1) / 2));
+
+	for (y = 0; y < dest->height; y++) {
+		rows = MB_MIN(2, src->height - 2 * y);
+
+		for (x = 0; x < dest->width; x++) {
+			cols = MB_MIN(2, src->width - 2 * x);
+			BMP_AT(dest, x, bottom_row(dest, y)) = bmp_average_area(src,
+				(uint16_t)(2 * x), bottom_row(src, 2 * y + rows - 1),
+				(uint16_t)cols, (uint16_t)rows);
+		}
+	}
+
+	return dest;
+}
+
+static int write_tile(struct pyramid_job_s *job, unsigned level, unsigned long col,
+	unsigned long row, const struct bmp_img *img)
+{
+	std::string path;
+	FILE *f;
+
+	path = job->files + "/" + std::to_string(level) + "/" + std::to_string(col) + "_"
+		+ std::to_string(row) + ".bmp";
+
+	if (!(f = fopen(path.c_str(), "wb"))) {
+		fprintf(stderr, "Can't open %s for writing!\n", path.c_str());
+		return 1;
+	}
+
+	bmp_write_f(img, f);
+
+	return fclose(f) != 0;
+}
+
+/* Waits for room in the queue of a level. */
+static void stage_push(struct stage_s *stage, const struct block_s *block)
+{
+	std::unique_lock<std::mutex> guard(stage->lock);
+
+	stage->changed.wait(guard, [&] { return stage->queue.size() < MAX_QUEUED; });
+	stage->queue.push_back(*block);
+	stage->changed.notify_all();
+}
+
+/* Returns false once the queue is closed and empty. */
+static bool stage_pop(struct stage_s *stage, struct block_s *block)
+{
+	std::unique_lock<std::mutex> guard(stage->lock);
+
+	stage->changed.wait(guard, [&] { return stage->closed || !stage->queue.empty(); });
+	if (stage->queue.empty())
+		return false;
+
+	*block = stage->queue.front();
+	stage->queue.pop_front();
+	stage->changed.notify_all();
+
+	return true;
+}
+
+static void stage_close(struct stage_s *stage)
+{
+	std::lock_guard<std::mutex> guard(stage->lock);
+
+	stage->closed = true;
+	stage->changed.notify_all();
+}
+
+/* Writes every tile of a block at the resolution of level, or the one tile
+ * below the block level. */
+static int cut_block(struct pyramid_job_s *job, unsigned level, const struct block_s *block)
+{
+	const struct bmp_img *img = block->img;
+	struct bmp_img *tile;
+	unsigned long tiles;
+	unsigned long x;
+	unsigned long y;
+	int ret = 0;
+
+	tiles = (level > job->block_level) ? 1ul << (level - job->block_level) : 1;
+
+	for (y = 0; y < img->height && !ret; y += PYRAMID_TILE) {
+		for (x = 0; x < img->width && !ret; x += PYRAMID_TILE) {
+			tile = crop(img, x, y, MB_MIN(PYRAMID_TILE, img->width - x),
+				MB_MIN(PYRAMID_TILE, img->height - y));
+			ret = write_tile(job, level, block->col * tiles + x / PYRAMID_TILE,
+				block->row * tiles + y / PYRAMID_TILE, tile);
+			bmp_delete(tile);
+		}
+	}
+
+	return ret;
+}
+
+/* Queues a block halved for the level below, or at and below the block level
+ * adds a tile to the tile below it, which is queued once it has all of its
+ * tiles. */
+static void hand_down(struct pyramid_job_s *job, unsigned level, const struct block_s *block)
+{
+	const struct level_s *below = &job->levels[level];
+	struct parent_s *parent = &job->stages[level].parent;
+	struct block_s next;
+
+	if (level > job->block_level) {
+		next.col = block->col;
+		next.row = block->row;
+		next.img = halve(block->img);
+		stage_push(&job->stages[level - 1], &next);
+		return;
+	}
+
+	if (!parent->canvas) {
+		parent->canvas = bmp_new(
+			(uint16_t)MB_MIN(2 * PYRAMID_TILE, below->width - (block->col / 2) * 2 * PYRAMID_TILE),
+			(uint16_t)MB_MIN(2 * PYRAMID_TILE, below->height - (block->row / 2) * 2 * PYRAMID_TILE));
+		parent->missing = (unsigned)(MB_MIN(2, below->cols - (block->col / 2) * 2)
+			* MB_MIN(2, below->rows - (block->row / 2) * 2));
+	}
+
+	blit(parent->canvas, block->img, (block->col % 2) * PYRAMID_TILE,
+		(block->row % 2) * PYRAMID_TILE);
+	if (--parent->missing)
+		return;
+
+	next.col = block->col / 2;
+	next.row = block->row / 2;
+	next.img = halve(parent->canvas);
+	bmp_delete(parent->canvas);
+	parent->canvas = NULL;
+	stage_push(&job->stages[level - 1], &next);
+}
+
+/* Thread of a level. After a failure it only drains its queue, so that the
+ * levels above it never wait on it for good. */
+static void write_level(struct pyramid_job_s *job, unsigned level)
+{
+	struct stage_s *stage = &job->stages[level];
+	struct block_s block;
+
+	while (stage_pop(stage, &block)) {
+		if (!job->failed && cut_block(job, level, &block))
+			job->failed = true;
+
+		if (!job->failed && level)
+			hand_down(job, level, &block);
+
+		bmp_delete(block.img);
+	}
+
+	if (level)
+		stage_close(&job->stages[level - 1]);
+}
+
+/* Draws the block at (col, row) of the block level with the samples it would
+ * have in one frame of the whole image. */
+static struct bmp_img * draw_block(struct render_pool_s *pool, struct pyramid_job_s *job,
+	unsigned long col, unsigned long row)
+{
+	const struct pyramid_s *pyr = job->pyr;
+	unsigned long x = col * job->block_px;
+	unsigned long y = row * job->block_px;
+
+	return render_part(pool, &pyr->frame, pyr->width, pyr->height, pyr->supersample_level,
+		x, y, MB_MIN(job->block_px, pyr->width - x), MB_MIN(job->block_px, pyr->height - y));
+}
+
+/* Draws the blocks under tile (col, row) of level in Z order. */
+static int draw_blocks(struct render_pool_s *pool, struct pyramid_job_s *job,
+	unsigned level, unsigned long col, unsigned long row, unsigned long *done,
+	unsigned long total)
+{
+	struct block_s block;
+	unsigned i;
+
+	if (level < job->block_level) {
+		for (i = 0; i < 4; i++) {
+			if (2 * col + i % 2 >= job->levels[level + 1].cols
+					|| 2 * row + i / 2 >= job->levels[level + 1].rows)
+				continue;
+
+			if (draw_blocks(pool, job, level + 1, 2 * col + i % 2, 2 * row + i / 2,
+					done, total))
+				return 1;
+		}
+
+		return 0;
+	}
+
+	block.col = col;
+	block.row = row;
+	block.img = draw_block(pool, job, col, row);
+	printf("Block %lu / %lu\n", ++*done, total);
+
+	if (job->failed) {
+		bmp_delete(block.img);
+		return 1;
+	}
+
+	stage_push(&job->stages[job->top], &block);
+
+	return 0;
+}
+
+static int write_dzi(const struct pyramid_s *pyr)
+{
+	std::string path;
+	FILE *f;
+
+	path = std::string(pyr->dir) + "/image.dzi";
+	if (!(f = fopen(path.c_str(), "w"))) {
+		fprintf(stderr, "Can't open %s for writing!\n", path.c_str());
+		return 1;
+	}
+
+	fprintf(f, "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+		"<Image xmlns=\"http://schemas.microsoft.com/deepzoom/2008\" Format=\"bmp\" "
+		"Overlap=\"0\" TileSize=\"%u\">\n"
+		"\t<Size Width=\"%lu\" Height=\"%lu\"/>\n"
+		"</Image>\n", PYRAMID_TILE, pyr->width, pyr->height);
+
+	return fclose(f) != 0;
+}
+
+int pyramid(struct render_pool_s *pool, const struct pyramid_s *pyr)
+{
+	struct pyramid_job_s job;
+	struct level_s level;
+	unsigned long done = 0;
+	unsigned long total;
+	unsigned long side;
+	unsigned i;
+	int ret;
+
+	if (!pyr->width || !pyr->height
+			|| (MB_MAX(pyr->width, pyr->height) << pyr->supersample_level) > INT32_MAX) {
+		fputs("Pyramid image size out of range\n", stderr);
+		return 1;
+	}
+
+	job.pyr = pyr;
+	job.failed = false;
+	job.files = std::string(pyr->dir) + "/image_files";
+
+	/* Level top is the full image, and every level below is half of the
+	 * one above it, rounded up. */
+	for (job.top = 0, side = 1; side < MB_MAX(pyr->width, pyr->height); side *= 2)
+		job.top++;
+
+	job.levels.resize(job.top + 1);
+	level.width = pyr->width;
+	level.height = pyr->height;
+	for (i = job.top + 1; i-- > 0;) {
+		level.cols = (level.width + PYRAMID_TILE - 1) / PYRAMID_TILE;
+		level.rows = (level.height + PYRAMID_TILE - 1) / PYRAMID_TILE;
+		job.levels[i] = level;
+		level.width = (level.width + 1) / 2;
+		level.height = (level.height + 1) / 2;
+	}
+
+	job.block_level = (job.top > BLOCK_LEVELS) ? job.top - BLOCK_LEVELS : 0;
+	job.block_px = (unsigned long)PYRAMID_TILE << (job.top - job.block_level);
+	job.stages.reset(new stage_s[job.top + 1]);
+
+	mkdir(pyr->dir, 0777);
+	mkdir(job.files.c_str(), 0777);
+	for (i = 0; i <= job.top; i++)
+		mkdir((job.files + "/" + std::to_string(i)).c_str(), 0777);
+
+	if (write_dzi(pyr))
+		return 1;
+
+	total = job.levels[job.block_level].cols * job.levels[job.block_level].rows;
+	printf("Pyramid of %u levels, %lu blocks of %lu pixels\n", job.top + 1, total,
+		job.block_px);
+
+	for (i = 0; i <= job.top; i++) {
+		job.stages[i].closed = false;
+		job.stages[i].parent.canvas = NULL;
+		job.stages[i].thread = std::thread(write_level, &job, i);
+	}
+
+	ret = draw_blocks(pool, &job, 0, 0, 0, &done, total);
+
+	stage_close(&job.stages[job.top]);
+
+	for (i = job.top + 1; i-- > 0;) {
+		job.stages[i].thread.join();
+		bmp_delete(job.stages[i].parent.canvas);
+	}
+
+	return ret || job.failed;
+}
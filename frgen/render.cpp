@@ -0,0 +1,1496 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <math.h>
+
+#include <vector>
+#include <algorithm>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+
+#include "render.h"
+#include "global.h"
+#include "tile.h"
+
+#include "debug.h"
+
+/* Regions are not split any further than this. */
+#define MIN_TILE_SIZE	(16)
+
+/* Regions are split down to this size to take over what they can from the
+ * previous frame. */
+#define MIN_REUSE_SIZE	(8)
+
+/* Adaptive budgets start here and grow by ADAPTIVE_GROWTH while at least one
+ * sample in ADAPTIVE_LATE_SHARE escapes in the last half of the budget. The
+ * probe has one sample for every PROBE_STRIDE x PROBE_STRIDE, but at least
+ * PROBE_MIN_SIDE a side. */
+#define ADAPTIVE_START		(256)
+#define ADAPTIVE_GROWTH		(4)
+#define ADAPTIVE_LATE_SHARE	(256)
+#define PROBE_STRIDE		(8)
+#define PROBE_MIN_SIDE		(16)
+
+/* Marks a sample that cannot be taken over from the previous frame. */
+#define REPROJ_NONE		(UINT_MAX)
+
+/* Largest factor two frames may be zoomed apart by and still line up, and how
+ * far off a whole sample their grids may lie, in samples. */
+#define MAX_ALIGN_FACTOR	(16)
+#define ALIGN_TOLERANCE		(1e-4)
+
+struct tile_buffers_s {
+	unsigned *iterations;
+	float *distance;
+	struct pixel *img;
+	size_t length;
+};
+
+struct render_pool_s {
+	std::vector<std::thread> workers;
+	std::vector<struct tile_buffers_s> buffers;
+	std::mutex lock;
+	std::condition_variable wake;
+	std::condition_variable done;
+	render_job_fn job;
+	void *arg;
+	unsigned long generation;
+	unsigned busy;
+	bool quit;
+
+	/* Set to make render_frame give up on the frame it is drawing. */
+	std::atomic<bool> cancel;
+
+	/* Whole-image buffers, kept for the next frame. */
+	unsigned *iterations;
+	float *distance;
+	unsigned *reproj;
+	size_t length;
+
+	/* The frame drawn last and its iteration counts. */
+	unsigned *prev_iterations;
+	int prev_valid;
+	uint16_t prev_width;
+	uint16_t prev_height;
+	double prev_r;
+	unsigned prev_count;
+	iterate_fn prev_iterate;
+	struct big_fixed prev_org_real;
+	struct big_fixed prev_org_img;
+};
+
+struct draw_tiles_data_s {
+	/* Request for the whole image. Tiles narrow it down. */
+	struct frg_iteration_request_s spec;
+	std::atomic<size_t> next_tile;
+	size_t tile_count;
+	size_t tiles_per_row;
+	uint16_t tile_rows;
+	uint16_t tile_cols;
+	uint16_t first_line;
+	uint16_t last_line;
+	unsigned *iterations;
+	float *distance;
+	/* NULL to only count. */
+	struct pixel *img;
+	const struct frg_param_set_s *params;
+	iterate_fn iterate;
+	unsigned iterate_flags;
+	render_fn render;
+	struct render_pool_s *pool;
+
+	/* Counts taken over from the previous frame, REPROJ_NONE where there
+	 * are none. NULL if nothing is. */
+	const unsigned *reproj;
+	std::atomic<size_t> reused;
+
+	/* Where the image lies on the grid of spec, which is that of a larger
+	 * image when drawing part of one. */
+	size_t col_base;
+	size_t row_base;
+
+	/* Tiles taken over from the checkpoint, by index, and where the rest go.
+	 * Empty and NULL if there is none. */
+	std::vector<char> restored;
+	struct render_checkpoint_s *checkpoint;
+
+	/* Budget of each tile of an adaptive frame, from the probe at first and
+	 * as far as the tile went once drawn. Empty for other frames. */
+	std::vector<unsigned> budgets;
+};
+
+static void worker_main(struct render_pool_s *pool, unsigned worker)
+{
+	std::unique_lock<std::mutex> guard(pool->lock);
+	unsigned long seen = 0;
+
+	for (;;) {
+		pool->wake.wait(guard, [&] { return pool->quit || pool->generation != seen; });
+		if (pool->quit)
+			return;
+
+		seen = pool->generation;
+		guard.unlock();
+		pool->job(pool->arg, worker);
+		guard.lock();
+
+		if (!--pool->busy)
+			pool->done.notify_all();
+	}
+}
+
+extern "C" struct render_pool_s * render_pool_new(unsigned threads)
+{
+	struct render_pool_s *pool;
+	unsigned i;
+
+	pool = new render_pool_s;
+	pool->job = NULL;
+	pool->arg = NULL;
+	pool->generation = 0;
+	pool->busy = 0;
+	pool->quit = false;
+	pool->cancel = false;
+	pool->iterations = NULL;
+	pool->distance = NULL;
+	pool->reproj = NULL;
+	pool->length = 0;
+	pool->prev_iterations = NULL;
+	pool->prev_valid = 0;
+	bf_init(&pool->prev_org_real, 1, 1);
+	bf_init(&pool->prev_org_img, 1, 1);
+	pool->buffers.resize(threads ? threads : 1, tile_buffers_s { NULL, NULL, NULL, 0 });
+
+	for (i = 0; i < pool->buffers.size(); i++)
+		pool->workers.emplace_back(worker_main, pool, i);
+
+	return pool;
+}
+
+extern "C" void render_pool_delete(struct render_pool_s *pool)
+{
+	size_t i;
+
+	{
+		std::lock_guard<std::mutex> guard(pool->lock);
+		pool->quit = true;
+	}
+
+	pool->wake.notify_all();
+
+	for (i = 0; i < pool->workers.size(); i++)
+		pool->workers[i].join();
+
+	for (i = 0; i < pool->buffers.size(); i++) {
+		free(pool->buffers[i].iterations);
+		free(pool->buffers[i].distance);
+		free(pool->buffers[i].img);
+	}
+
+	free(pool->iterations);
+	free(pool->distance);
+	free(pool->reproj);
+	free(pool->prev_iterations);
+	bf_destroy(&pool->prev_org_real);
+	bf_destroy(&pool->prev_org_img);
+	delete pool;
+}
+
+extern "C" unsigned render_pool_threads(const struct render_pool_s *pool)
+{
+	return (unsigned)pool->workers.size();
+}
+
+extern "C" void render_pool_cancel(struct render_pool_s *pool, int cancel)
+{
+	pool->cancel = cancel != 0;
+}
+
+extern "C" void render_pool_run(struct render_pool_s *pool, render_job_fn job, void *arg)
+{
+	std::unique_lock<std::mutex> guard(pool->lock);
+
+	pool->job = job;
+	pool->arg = arg;
+	pool->busy = (unsigned)pool->workers.size();
+	pool->generation++;
+	pool->wake.notify_all();
+
+	pool->done.wait(guard, [&] { return !pool->busy; });
+}
+
+/* Grows a worker's tile buffers to hold length samples. */
+static void tile_buffers_reserve(struct tile_buffers_s *buf, size_t length, bool distance)
+{
+	if (buf->length < length) {
+		free(buf->iterations);
+		free(buf->img);
+		free(buf->distance);
+		buf->iterations = (unsigned *)malloc(length * sizeof(buf->iterations[0]));
+		buf->img = (struct pixel *)malloc(length * sizeof(buf->img[0]));
+		buf->distance = NULL;
+		buf->length = length;
+	}
+
+	if (distance && !buf->distance)
+		buf->distance = (float *)malloc(buf->length * sizeof(buf->distance[0]));
+}
+
+/* Request for rows x cols samples from (line, col) on. */
+static void region_spec(const struct draw_tiles_data_s *data, size_t line, size_t col,
+	size_t rows, size_t cols, struct frg_iteration_request_s *spec)
+{
+	*spec = data->spec;
+	spec->rows = (uint16_t)rows;
+	spec->cols = (uint16_t)cols;
+	spec->col_offset += (long)(data->col_base + col);
+	spec->row_offset += (long)(data->row_base + line);
+	spec->from_x = data->spec.from_x + (data->col_base + col) * spec->step;
+	spec->from_y = data->spec.from_y + (data->row_base + line) * spec->step;
+}
+
+/* Settles a region from the request's doubles. That is the view the iterator
+ * draws too, as it may only refine the centre it is handed, not move it, and
+ * tile_classify pads the box by what the doubles lose of it. */
+static int region_is_uniform(const struct draw_tiles_data_s *data, size_t line,
+	size_t col, size_t rows, size_t cols, unsigned budget, unsigned *n)
+{
+	struct frg_iteration_request_s spec;
+
+	if (!(data->iterate_flags & FRG_ITERATOR_MANDELBROT) || !rows || !cols)
+		return 0;
+
+	region_spec(data, line, col, rows, cols, &spec);
+
+	return tile_classify(spec.from_x, spec.from_y, spec.step, spec.rows, spec.cols,
+		budget, n);
+}
+
+/* Number of samples in a region that can be taken over from the previous
+ * frame. */
+static size_t region_reusable(const struct draw_tiles_data_s *data, size_t line,
+	size_t col, size_t rows, size_t cols)
+{
+	const unsigned *reproj;
+	size_t ret = 0;
+	size_t i;
+	size_t j;
+
+	if (!data->reproj)
+		return 0;
+
+	for (i = 0; i < rows; i++) {
+		reproj = data->reproj + (line + i) * data->spec.cols + col;
+
+		for (j = 0; j < cols; j++)
+			ret += reproj[j] != REPROJ_NONE;
+	}
+
+	return ret;
+}
+
+/* Copies rows x cols samples laid out one after the other into the image
+ * buffer at (line, col), or the other way round. */
+template <typename T>
+static void put_region(const struct draw_tiles_data_s *data, T *dest, const T *src,
+	size_t line, size_t col, size_t rows, size_t cols)
+{
+	size_t i;
+
+	for (i = 0; i < rows; i++)
+		memcpy(dest + (line + i) * data->spec.cols + col, src + i * cols, cols * sizeof(T));
+}
+
+template <typename T>
+static void get_region(const struct draw_tiles_data_s *data, T *dest, const T *src,
+	size_t line, size_t col, size_t rows, size_t cols)
+{
+	size_t i;
+
+	for (i = 0; i < rows; i++)
+		memcpy(dest + i * cols, src + (line + i) * data->spec.cols + col, cols * sizeof(T));
+}
+
+/* Fills the counts of a region in from interval arithmetic where it can
+ * vouch for all of it, from the previous frame where that still holds, and
+ * calls the iterator where neither does. A region none of whose quarters can
+ * be settled goes to the iterator whole, so that it is not split up
+ * needlessly. */
+static void draw_region(struct draw_tiles_data_s *data, size_t line, size_t col,
+	size_t rows, size_t cols, unsigned budget, struct tile_buffers_s *buf)
+{
+	struct frg_iteration_request_s spec;
+	size_t half_rows;
+	size_t half_cols;
+	size_t length;
+	size_t reusable;
+	size_t i;
+	size_t j;
+	unsigned n;
+	int split = 0;
+
+	if (!rows || !cols)
+		return;
+
+	half_rows = rows / 2;
+	half_cols = cols / 2;
+	region_spec(data, line, col, rows, cols, &spec);
+	spec.iterations = budget;
+	spec.distance = data->distance ? buf->distance : NULL;
+	length = rows * cols;
+	reusable = region_reusable(data, line, col, rows, cols);
+
+	if (region_is_uniform(data, line, col, rows, cols, budget, &n)) {
+		for (i = 0; i < rows; i++) {
+			for (j = 0; j < cols; j++)
+				data->iterations[(line + i) * data->spec.cols + col + j] = n;
+
+			for (j = 0; spec.distance && j < cols; j++) {
+				data->distance[(line + i) * data->spec.cols + col + j] =
+					(n < spec.iterations) ? INFINITY : 0.0f;
+			}
+		}
+
+		return;
+	}
+
+	if (reusable == length) {
+		get_region(data, buf->iterations, data->reproj, line, col, rows, cols);
+		put_region(data, data->iterations, buf->iterations,
+			line, col, rows, cols);
+		data->reused += length;
+		return;
+	}
+
+	if (half_rows >= MIN_TILE_SIZE && half_cols >= MIN_TILE_SIZE) {
+		split = region_is_uniform(data, line, col, half_rows, half_cols, budget, &n)
+			|| region_is_uniform(data, line, col + half_cols, half_rows,
+				cols - half_cols, budget, &n)
+			|| region_is_uniform(data, line + half_rows, col, rows - half_rows,
+				half_cols, budget, &n)
+			|| region_is_uniform(data, line + half_rows, col + half_cols,
+				rows - half_rows, cols - half_cols, budget, &n);
+	}
+
+	/* Pieces of what the previous frame left over are worth going after
+	 * down to MIN_REUSE_SIZE. Below that, calling the iterator costs more
+	 * than it saves. */
+	if (reusable && half_rows >= MIN_REUSE_SIZE && half_cols >= MIN_REUSE_SIZE)
+		split = 1;
+
+	if (split) {
+		draw_region(data, line, col, half_rows, half_cols, budget, buf);
+		draw_region(data, line, col + half_cols, half_rows, cols - half_cols, budget, buf);
+		draw_region(data, line + half_rows, col, rows - half_rows, half_cols, budget, buf);
+		draw_region(data, line + half_rows, col + half_cols,
+			rows - half_rows, cols - half_cols, budget, buf);
+		return;
+	}
+
+	data->iterate(&spec, buf->iterations, data->params);
+	put_region(data, data->iterations, buf->iterations,
+		line, col, rows, cols);
+
+	if (spec.distance) {
+		put_region(data, data->distance, spec.distance,
+			line, col, rows, cols);
+	}
+}
+
+/* Whether a budget four times as large stands to let samples escape that
+ * do not now: some are left, and enough escaped in the last half of this
+ * one. Near the boundary counts go up smoothly, well inside they do not. */
+static bool needs_more(const unsigned *itr, size_t stride, size_t rows, size_t cols,
+	unsigned budget)
+{
+	size_t unescaped = 0;
+	size_t late = 0;
+	size_t i;
+	size_t j;
+
+	for (i = 0; i < rows; i++) {
+		for (j = 0; j < cols; j++) {
+			if (itr[i * stride + j] >= budget)
+				unescaped++;
+			else if (itr[i * stride + j] >= budget / 2)
+				late++;
+		}
+	}
+
+	return unescaped && late * ADAPTIVE_LATE_SHARE >= rows * cols;
+}
+
+static unsigned next_budget(unsigned budget, unsigned ceiling)
+{
+	return (unsigned)MB_MIN((unsigned long long)budget * ADAPTIVE_GROWTH, ceiling);
+}
+
+/* Counts a tile at *budget, and again at ever larger ones for as long as it
+ * needs more. Samples that never escape are set to the count of the frame,
+ * so that tiles of every budget mean the same by it. */
+static void draw_budgeted(struct draw_tiles_data_s *data, size_t line, size_t col,
+	size_t rows, size_t cols, struct tile_buffers_s *buf, unsigned *budget)
+{
+	unsigned *itr = data->iterations + line * data->spec.cols + col;
+	unsigned ceiling = data->spec.iterations;
+	size_t i;
+	size_t j;
+
+	for (;;) {
+		draw_region(data, line, col, rows, cols, *budget, buf);
+
+		if (*budget >= ceiling || data->pool->cancel
+				|| !needs_more(itr, data->spec.cols, rows, cols, *budget))
+			break;
+
+		*budget = next_budget(*budget, ceiling);
+	}
+
+	for (i = 0; i < rows; i++) {
+		for (j = 0; j < cols; j++) {
+			if (itr[i * data->spec.cols + j] >= *budget)
+				itr[i * data->spec.cols + j] = ceiling;
+		}
+	}
+}
+
+/* Counts the samples of a tile, unless they were restored, and turns them
+ * into pixels in one go. budget is NULL but for adaptive frames. */
+static void draw_tile(struct draw_tiles_data_s *data, size_t line, size_t col,
+	size_t rows, size_t cols, struct tile_buffers_s *buf, bool restored, unsigned *budget)
+{
+	struct frg_iteration_request_s spec;
+	struct checkpoint_tile_s tile;
+
+	if (!restored && budget)
+		draw_budgeted(data, line, col, rows, cols, buf, budget);
+	else if (!restored)
+		draw_region(data, line, col, rows, cols, data->spec.iterations, buf);
+
+	if (!data->img && !data->checkpoint)
+		return;
+
+	region_spec(data, line, col, rows, cols, &spec);
+	spec.distance = data->distance ? buf->distance : NULL;
+
+	get_region(data, buf->iterations, data->iterations,
+		line, col, rows, cols);
+
+	if (spec.distance)
+		get_region(data, spec.distance, data->distance, line, col, rows, cols);
+
+	if (data->checkpoint && !restored) {
+		tile.line = line;
+		tile.col = col;
+		tile.rows = rows;
+		tile.cols = cols;
+
+		/* A render that asked for a log stops rather than go on without
+		 * one, and resumes from the tiles that made it in. */
+		if (checkpoint_append(data->checkpoint, &tile, buf->iterations, spec.distance))
+			render_pool_cancel(data->pool, 1);
+	}
+
+	if (!data->img)
+		return;
+
+	data->render(&spec, buf->iterations, buf->img, data->params);
+	put_region(data, data->img, buf->img, line, col, rows, cols);
+}
+
+/* Tiles only pay off where they can be settled without the iterator.
+ * Anything else gets one strip per thread, as large as possible. */
+static void tiles_layout(struct draw_tiles_data_s *data, unsigned threads)
+{
+	if (data->iterate_flags & FRG_ITERATOR_MANDELBROT) {
+		data->tile_rows = tile_size;
+		data->tile_cols = tile_size;
+	} else {
+		data->tile_rows = (data->last_line - data->first_line + threads - 1) / threads;
+		data->tile_cols = data->spec.cols;
+	}
+
+	data->next_tile = 0;
+	data->tiles_per_row = (data->spec.cols + data->tile_cols - 1) / data->tile_cols;
+	data->tile_count = data->tiles_per_row
+		* ((data->last_line - data->first_line + data->tile_rows - 1) / data->tile_rows);
+}
+
+/* Takes tiles off the shared counter until there are none left. */
+static void draw_tiles(void *arg, unsigned worker)
+{
+	struct draw_tiles_data_s *data = (struct draw_tiles_data_s *)arg;
+	struct tile_buffers_s *buf = &data->pool->buffers[worker];
+	size_t tile;
+	size_t line;
+	size_t col;
+
+	tile_buffers_reserve(buf, (size_t)data->tile_rows * data->tile_cols,
+		data->distance != NULL);
+
+	while (!data->pool->cancel && (tile = data->next_tile++) < data->tile_count) {
+		line = data->first_line + (tile / data->tiles_per_row) * data->tile_rows;
+		col = (tile % data->tiles_per_row) * data->tile_cols;
+
+		draw_tile(data, line, col, MB_MIN(data->tile_rows, data->last_line - line),
+			MB_MIN(data->tile_cols, data->spec.cols - col), buf,
+			!data->restored.empty() && data->restored[tile],
+			data->budgets.empty() ? NULL : &data->budgets[tile]);
+	}
+}
+
+/* The log keeps counts, not budgets. The least budget that holds every count
+ * that escaped is as near as can be had. */
+static unsigned restored_budget(const unsigned *itr, size_t length, unsigned ceiling)
+{
+	unsigned budget = MB_MIN(ADAPTIVE_START, ceiling);
+	size_t i;
+
+	for (i = 0; i < length; i++) {
+		while (itr[i] < ceiling && itr[i] >= budget)
+			budget = next_budget(budget, ceiling);
+	}
+
+	return budget;
+}
+
+/* Takes over the tiles of the checkpoint that are tiles of this layout. Any
+ * others, as from a different tile size, are counted again. */
+static void restore_tiles(struct draw_tiles_data_s *data)
+{
+	struct checkpoint_tile_s tile;
+	const unsigned *iterations;
+	const float *distance;
+	size_t index;
+
+	data->restored.assign(data->tile_count, 0);
+
+	while (checkpoint_read(data->checkpoint, &tile, &iterations, &distance)) {
+		if (tile.line < data->first_line || tile.line >= data->last_line
+				|| tile.col >= data->spec.cols
+				|| (tile.line - data->first_line) % data->tile_rows
+				|| tile.col % data->tile_cols
+				|| tile.rows != MB_MIN(data->tile_rows, data->last_line - tile.line)
+				|| tile.cols != MB_MIN(data->tile_cols, data->spec.cols - tile.col)
+				|| !distance != !data->distance)
+			continue;
+
+		index = (tile.line - data->first_line) / data->tile_rows * data->tiles_per_row
+			+ tile.col / data->tile_cols;
+		data->restored[index] = 1;
+		if (!data->budgets.empty())
+			data->budgets[index] = restored_budget(iterations, tile.rows * tile.cols,
+				data->spec.iterations);
+
+		put_region(data, data->iterations, iterations, tile.line, tile.col, tile.rows, tile.cols);
+		if (distance)
+			put_region(data, data->distance, distance, tile.line, tile.col, tile.rows, tile.cols);
+	}
+}
+
+#ifndef NDEBUG
+
+static unsigned u_max(const unsigned *itr, size_t length)
+{
+	size_t i;
+	unsigned ret;
+
+	ret = itr[0];
+
+	for (i = 1; i < length; i++) {
+		if (ret < itr[i]) {
+			ret = itr[i];
+		}
+	}
+
+	return ret;
+}
+
+#define DUMP_COLS	(120)
+#define DUMP_ROWS	(35)
+
+static void dump_iterations(const unsigned *itr, size_t rows, size_t cols)
+{
+	size_t i = 0;
+	size_t j = 0;
+	size_t a = 0;
+	size_t b = 0;
+	size_t line = 0;
+	size_t next_line = 0;
+	size_t col;
+	size_t next_col;
+	size_t rows_to_dump;
+	size_t cols_to_dump;
+	unsigned long sum;
+	unsigned max_itr;
+	unsigned char brightness;
+
+	max_itr = u_max(itr, rows * cols);
+
+	rows_to_dump = (rows < DUMP_ROWS) ? rows : DUMP_ROWS;
+	cols_to_dump = (cols < DUMP_COLS) ? cols : DUMP_COLS;
+
+	while (i < rows_to_dump) {
+		line = (rows * i) / rows_to_dump;
+		next_line = (rows * (i + 1)) / rows_to_dump;
+
+		if (line >= rows) {
+			break;
+		}
+
+		if (next_line >= rows) {
+			next_line = rows - 1;
+		}
+
+		j = 0;
+
+		while (j < cols_to_dump) {
+			col = (j * cols) / cols_to_dump;
+			next_col = ((j + 1) * cols) / cols_to_dump;
+
+			if (col >= cols) {
+				break;
+			}
+
+			if (next_col >= cols) {
+				next_col = cols - 1;
+			}
+
+			sum = 0;
+
+			for (b = line; b <= next_line; b++) {
+				for (a = col; a <= next_col; a++) {
+					sum += itr[b * cols + a];
+				}
+			}
+
+			brightness = (unsigned char)(
+				255UL - ((sum * 255UL)
+					/
+				(((next_line - line + 1) * (next_col - col + 1)))) / max_itr
+			);
+
+			printf("\e[48;2;%u;%u;%um \e[0m", brightness, brightness, brightness);
+
+			j++;
+		}
+
+		putchar('\n');
+
+		i++;
+	}
+}
+
+#else
+#define dump_iterations(__itr, __r, __c)
+#endif
+
+/* Sample row i lies at from_y + i * step. If -2 from_y / step is a whole
+ * number axis, row i mirrors row axis - i across the real axis. Narrows
+ * [*first, *last) down to the rows that have no mirror in the range already,
+ * and returns axis, or -1 if the rows are not symmetric. org_img is -y,
+ * which iterators draw around too; its rounding to a double is far below a
+ * sample wherever the axis is in view. */
+static long conj_row_range(double org_img, double step, uint16_t rows,
+	uint16_t *first, uint16_t *last)
+{
+	double twice;
+	double rounded;
+	long axis;
+
+	*first = 0;
+	*last = rows;
+
+	twice = 2.0 * (rows / 2) - 2.0 * org_img / step;
+	rounded = floor(twice + 0.5);
+
+	if (!(rounded >= 1.0 && rounded <= 2.0 * rows - 3.0) || fabs(twice - rounded) > 1e-3)
+		return -1;
+
+	axis = (long)rounded;
+
+	if (axis < rows)
+		*first = (uint16_t)((axis + 1) / 2);
+	else
+		*last = (uint16_t)(axis / 2 + 1);
+
+	return axis;
+}
+
+/* Grows the pool's whole-image buffers to hold length samples. The previous
+ * frame is lost if they have to. */
+static void image_buffers_reserve(struct render_pool_s *pool, size_t length, bool distance)
+{
+	if (pool->length < length) {
+		free(pool->iterations);
+		free(pool->distance);
+		free(pool->reproj);
+		free(pool->prev_iterations);
+		pool->iterations = (unsigned *)malloc(length * sizeof(pool->iterations[0]));
+		pool->prev_iterations = (unsigned *)malloc(length * sizeof(pool->prev_iterations[0]));
+		pool->distance = NULL;
+		pool->reproj = NULL;
+		pool->length = length;
+		pool->prev_valid = 0;
+	}
+
+	if (distance && !pool->distance)
+		pool->distance = (float *)malloc(pool->length * sizeof(pool->distance[0]));
+}
+
+struct reproject_data_s {
+	const struct render_pool_s *pool;
+	unsigned *reproj;
+	std::atomic<size_t> next_line;
+	uint16_t rows;
+	uint16_t cols;
+
+	/* Sample (i, j) of the new frame lies at (j_0 + j * scale, i_0 + i *
+	 * scale) in samples of the previous one. */
+	double j_0;
+	double i_0;
+	double scale;
+	double tolerance;
+	unsigned edge;
+};
+
+/* Finds, for every sample of the new frame, the nearest sample of the previous
+ * one and takes its count over if it is close enough and does not lie on an
+ * edge between counts. */
+static void reproject_lines(void *arg, unsigned worker)
+{
+	struct reproject_data_s *data = (struct reproject_data_s *)arg;
+	const struct render_pool_s *pool = data->pool;
+	const unsigned *prev;
+	size_t line;
+	size_t col;
+	long ri;
+	long rj;
+	long a;
+	long b;
+	double u;
+	double v;
+	unsigned lo;
+	unsigned hi;
+	unsigned n;
+
+	(void)worker;
+
+	while ((line = data->next_line++) < data->rows) {
+		v = data->i_0 + (double)line * data->scale;
+		ri = (long)floor(v + 0.5);
+
+		for (col = 0; col < data->cols; col++) {
+			u = data->j_0 + (double)col * data->scale;
+			rj = (long)floor(u + 0.5);
+			data->reproj[line * data->cols + col] = REPROJ_NONE;
+
+			if (ri < 1 || ri >= (long)pool->prev_height - 1
+					|| rj < 1 || rj >= (long)pool->prev_width - 1
+					|| hypot(u - rj, v - ri) > data->tolerance * data->scale)
+				continue;
+
+			lo = UINT_MAX;
+			hi = 0;
+
+			for (a = ri - 1; a <= ri + 1; a++) {
+				prev = pool->prev_iterations + a * pool->prev_width;
+
+				for (b = rj - 1; b <= rj + 1; b++) {
+					n = prev[b];
+					lo = MB_MIN(lo, n);
+					hi = MB_MAX(hi, n);
+				}
+			}
+
+			if (hi - lo <= data->edge)
+				data->reproj[line * data->cols + col] = pool->prev_iterations[ri * pool->prev_width + rj];
+		}
+	}
+}
+
+/* Finds where sample (i, j) of the new frame lies among the samples of the
+ * previous one, at (*j_0 + j * *scale, *i_0 + i * *scale). Returns non-zero
+ * if the two cannot be compared. */
+static int prev_position(const struct render_pool_s *pool, const struct render_frame_s *frame,
+	double step, double *j_0, double *i_0, double *scale)
+{
+	struct big_fixed diff;
+	double prev_step;
+	double dx;
+	double dy;
+
+	if (!pool->prev_valid || pool->prev_count != frame->iterations
+			|| pool->prev_iterate != frame->iterate
+			|| (frame->iterate_flags & FRG_ITERATOR_DISTANCE))
+		return 1;
+
+	prev_step = pool->prev_r / MB_MIN(pool->prev_width, pool->prev_height);
+	if (!(prev_step > 0.0 && step > 0.0 && isfinite(prev_step) && isfinite(step)))
+		return 1;
+
+	/* The centres are subtracted with all their digits, since deep down
+	 * they differ in the last few only. */
+	bf_init(&diff, 1, MB_MAX(bf_frac_u32s(frame->org_real_bf), bf_frac_u32s(frame->org_img_bf)));
+	bf_set(&diff, frame->org_real_bf);
+	bf_sub_i(&diff, &pool->prev_org_real);
+	dx = bf_to_d(&diff) / prev_step;
+	bf_set(&diff, frame->org_img_bf);
+	bf_sub_i(&diff, &pool->prev_org_img);
+	dy = bf_to_d(&diff) / prev_step;
+	bf_destroy(&diff);
+
+	*scale = step / prev_step;
+	*j_0 = dx - (double)(frame->img->width / 2) * *scale + pool->prev_width / 2;
+	*i_0 = dy - (double)(frame->img->height / 2) * *scale + pool->prev_height / 2;
+
+	return 0;
+}
+
+/* Lays the new frame over the previous one. Returns NULL if the two cannot
+ * be compared. */
+static const unsigned * reproject(struct render_pool_s *pool, const struct render_frame_s *frame,
+	double step)
+{
+	struct reproject_data_s data;
+
+	if (prev_position(pool, frame, step, &data.j_0, &data.i_0, &data.scale))
+		return NULL;
+
+	if (!pool->reproj)
+		pool->reproj = (unsigned *)malloc(pool->length * sizeof(pool->reproj[0]));
+
+	data.pool = pool;
+	data.reproj = pool->reproj;
+	data.next_line = 0;
+	data.rows = frame->img->height;
+	data.cols = frame->img->width;
+	data.tolerance = frame->reuse->tolerance;
+	data.edge = frame->reuse->edge;
+
+	render_pool_run(pool, reproject_lines, &data);
+
+	return pool->reproj;
+}
+
+/* Keeps the counts of the frame just drawn for the next one. */
+static void remember_frame(struct render_pool_s *pool, const struct render_frame_s *frame)
+{
+	unsigned *tmp;
+
+	tmp = pool->prev_iterations;
+	pool->prev_iterations = pool->iterations;
+	pool->iterations = tmp;
+
+	pool->prev_valid = 1;
+	pool->prev_width = frame->img->width;
+	pool->prev_height = frame->img->height;
+	pool->prev_r = frame->r;
+	pool->prev_count = frame->iterations;
+	pool->prev_iterate = frame->iterate;
+
+	bf_destroy(&pool->prev_org_real);
+	bf_destroy(&pool->prev_org_img);
+	bf_init(&pool->prev_org_real, 1, bf_frac_u32s(frame->org_real_bf));
+	bf_init(&pool->prev_org_img, 1, bf_frac_u32s(frame->org_img_bf));
+	bf_set(&pool->prev_org_real, frame->org_real_bf);
+	bf_set(&pool->prev_org_img, frame->org_img_bf);
+}
+
+/* How a frame lines up with the previous one along one axis. Every stride-th
+ * sample from first on lies on a sample of the previous frame, the n-th of
+ * them on sample prev_first + n * prev_stride. Those from from up to to lie
+ * within the previous frame. */
+struct grid_align_s {
+	unsigned stride;
+	unsigned first;
+	long prev_first;
+	unsigned prev_stride;
+	size_t from;
+	size_t to;
+};
+
+/* Sample n of the frame lies on p_0 + n * scale of the previous one. Returns
+ * non-zero unless that is a whole sample for every stride-th n. */
+static int align_axis(double p_0, double scale, size_t samples, size_t prev_samples,
+	struct grid_align_s *align)
+{
+	double factor;
+	double rounded;
+	long lo;
+	long hi;
+	size_t count;
+
+	factor = floor(((scale >= 1.0) ? scale : 1.0 / scale) + 0.5);
+	if (factor > MAX_ALIGN_FACTOR)
+		return 1;
+
+	align->stride = (scale >= 1.0) ? 1 : (unsigned)factor;
+	align->prev_stride = (scale >= 1.0) ? (unsigned)factor : 1;
+
+	/* How far the last sample drifts off the grid of the previous frame. */
+	if (fabs(scale * align->stride - align->prev_stride) * samples / align->stride
+			> ALIGN_TOLERANCE)
+		return 1;
+
+	if (scale >= 1.0) {
+		align->first = 0;
+		rounded = floor(p_0 + 0.5);
+		if (fabs(p_0 - rounded) > ALIGN_TOLERANCE)
+			return 1;
+
+		align->prev_first = (long)rounded;
+	} else {
+		/* Sample first + n * stride lies on p_0 + first / stride + n. */
+		rounded = floor(p_0 * align->stride + 0.5);
+		if (fabs(p_0 * align->stride - rounded) > ALIGN_TOLERANCE)
+			return 1;
+
+		align->first = (unsigned)((((long)-rounded % (long)align->stride) + align->stride)
+			% align->stride);
+		align->prev_first = ((long)rounded + (long)align->first) / (long)align->stride;
+	}
+
+	count = (align->first < samples)
+		? (samples - align->first + align->stride - 1) / align->stride
+		: 0;
+
+	lo = (align->prev_first >= 0) ? 0
+		: (-align->prev_first + align->prev_stride - 1) / align->prev_stride;
+	hi = ((long)prev_samples - 1 - align->prev_first >= 0)
+		? ((long)prev_samples - 1 - align->prev_first) / align->prev_stride + 1
+		: 0;
+
+	align->from = MB_MIN((size_t)lo, count);
+	align->to = MB_MAX(align->from, MB_MIN((size_t)hi, count));
+
+	return 0;
+}
+
+struct render_lines_data_s {
+	const struct frg_iteration_request_s *spec;
+	const unsigned *iterations;
+	struct pixel *img;
+	const struct frg_param_set_s *params;
+	render_fn render;
+	unsigned threads;
+};
+
+/* Turns the counts of the whole image into pixels, one strip per thread. */
+static void render_lines(void *arg, unsigned worker)
+{
+	struct render_lines_data_s *data = (struct render_lines_data_s *)arg;
+	struct frg_iteration_request_s spec = *data->spec;
+	size_t rows;
+	size_t first;
+
+	rows = (data->spec->rows + data->threads - 1) / data->threads;
+	first = worker * rows;
+	if (first >= data->spec->rows)
+		return;
+
+	spec.rows = (uint16_t)MB_MIN(rows, data->spec->rows - first);
+	spec.row_offset += (long)first;
+	spec.from_y += first * spec.step;
+	data->render(&spec, (unsigned *)data->iterations + first * spec.cols,
+		data->img + first * spec.cols, data->params);
+}
+
+/* Counts rows x cols samples of the frame, sample (i, j) being sample
+ * (line + stride * i, col + stride * j) of spec, up to budget. Returns
+ * non-zero if cancelled. */
+static int count_subgrid(struct render_pool_s *pool, const struct render_frame_s *frame,
+	const struct frg_iteration_request_s *spec, unsigned stride, size_t line, size_t col,
+	size_t rows, size_t cols, unsigned budget, unsigned *counts, float *distance)
+{
+	struct draw_tiles_data_s data;
+	struct big_fixed centre_x;
+	struct big_fixed centre_y;
+	struct big_fixed step_bf;
+	size_t i;
+	long rem_x;
+	long rem_y;
+
+	/* Sample offsets from the centre have to stay whole numbers of the
+	 * wider step, so the centre moves by what is left over. */
+	data.spec = *spec;
+	data.spec.rows = (uint16_t)rows;
+	data.spec.cols = (uint16_t)cols;
+	data.spec.iterations = budget;
+	data.spec.step = stride * spec->step;
+	data.spec.from_x = spec->from_x + col * spec->step;
+	data.spec.from_y = spec->from_y + line * spec->step;
+	rem_x = ((spec->col_offset + (long)col) % (long)stride + stride) % stride;
+	rem_y = ((spec->row_offset + (long)line) % (long)stride + stride) % stride;
+	data.spec.col_offset = (spec->col_offset + (long)col - rem_x) / (long)stride;
+	data.spec.row_offset = (spec->row_offset + (long)line - rem_y) / (long)stride;
+
+	bf_init(&step_bf, 1, bf_frac_u32s(spec->step_bf));
+	bf_init(&centre_x, 1, bf_frac_u32s(spec->centre_x));
+	bf_init(&centre_y, 1, bf_frac_u32s(spec->centre_y));
+	bf_set(&centre_x, spec->centre_x);
+	bf_set(&centre_y, spec->centre_y);
+
+	for (i = 0; i < stride; i++) {
+		bf_add_i(&step_bf, spec->step_bf);
+		if ((long)i < rem_x)
+			bf_add_i(&centre_x, spec->step_bf);
+		if ((long)i < rem_y)
+			bf_add_i(&centre_y, spec->step_bf);
+	}
+
+	data.spec.centre_x = &centre_x;
+	data.spec.centre_y = &centre_y;
+	data.spec.step_bf = &step_bf;
+
+	data.col_base = 0;
+	data.row_base = 0;
+	data.checkpoint = NULL;
+	data.first_line = 0;
+	data.last_line = data.spec.rows;
+	data.iterations = counts;
+	data.distance = distance;
+	data.img = NULL;
+	data.params = frame->params;
+	data.iterate = frame->iterate;
+	data.iterate_flags = frame->iterate_flags;
+	data.render = frame->render;
+	data.pool = pool;
+	data.reproj = NULL;
+	data.reused = 0;
+	tiles_layout(&data, render_pool_threads(pool));
+
+	render_pool_run(pool, draw_tiles, &data);
+
+	bf_destroy(&step_bf);
+	bf_destroy(&centre_x);
+	bf_destroy(&centre_y);
+
+	return pool->cancel;
+}
+
+/* Counts rows [r_0, r_1) and columns [c_0, c_1) of the samples (line, col)
+ * of the frame with line = a + stride * row and col = b + stride * column.
+ * Returns non-zero if cancelled. */
+static int draw_subgrid(struct render_pool_s *pool, const struct render_frame_s *frame,
+	const struct frg_iteration_request_s *spec, unsigned stride, unsigned a, unsigned b,
+	size_t r_0, size_t r_1, size_t c_0, size_t c_1)
+{
+	std::vector<unsigned> counts;
+	size_t line;
+	size_t col;
+	size_t i;
+	size_t j;
+
+	if (r_0 >= r_1 || c_0 >= c_1)
+		return pool->cancel;
+
+	line = a + stride * r_0;
+	col = b + stride * c_0;
+	counts.resize((r_1 - r_0) * (c_1 - c_0));
+
+	if (count_subgrid(pool, frame, spec, stride, line, col, r_1 - r_0, c_1 - c_0,
+			spec->iterations, counts.data(), NULL))
+		return 1;
+
+	for (i = 0; i < r_1 - r_0; i++) {
+		for (j = 0; j < c_1 - c_0; j++) {
+			pool->iterations[(line + i * stride) * spec->cols + col + j * stride] =
+				counts[i * (c_1 - c_0) + j];
+		}
+	}
+
+	return 0;
+}
+
+/* Draws a frame whose grid lines up with the previous one, as it does after a
+ * pan by whole samples or a zoom by a whole factor. Samples that lie on one of
+ * the previous frame are copied, and the rest counted as one grid per offset
+ * within the factor, each with a step that many times wider. Returns -1 if
+ * the frames do not line up, 1 if cancelled and 0 otherwise. */
+static int draw_aligned(struct render_pool_s *pool, const struct render_frame_s *frame,
+	const struct frg_iteration_request_s *spec)
+{
+	struct grid_align_s rows;
+	struct grid_align_s cols;
+	struct render_lines_data_s lines;
+	unsigned stride;
+	unsigned a;
+	unsigned b;
+	size_t sub_rows;
+	size_t sub_cols;
+	size_t i;
+	size_t j;
+	double j_0;
+	double i_0;
+	double scale;
+	int cancelled = 0;
+
+	if (prev_position(pool, frame, spec->step, &j_0, &i_0, &scale)
+			|| align_axis(j_0, scale, spec->cols, pool->prev_width, &cols)
+			|| align_axis(i_0, scale, spec->rows, pool->prev_height, &rows))
+		return -1;
+
+	for (i = rows.from; i < rows.to; i++) {
+		const unsigned *prev = pool->prev_iterations
+			+ (rows.prev_first + (long)(i * rows.prev_stride)) * pool->prev_width;
+		unsigned *dest = pool->iterations + (rows.first + i * rows.stride) * spec->cols;
+
+		for (j = cols.from; j < cols.to; j++)
+			dest[cols.first + j * cols.stride] = prev[cols.prev_first + (long)(j * cols.prev_stride)];
+	}
+
+	stride = cols.stride;
+	for (a = 0; a < stride && !cancelled; a++) {
+		for (b = 0; b < stride && !cancelled; b++) {
+			sub_rows = (spec->rows > a) ? (spec->rows - a + stride - 1) / stride : 0;
+			sub_cols = (spec->cols > b) ? (spec->cols - b + stride - 1) / stride : 0;
+
+			if (a != rows.first || b != cols.first) {
+				cancelled = draw_subgrid(pool, frame, spec, stride, a, b,
+					0, sub_rows, 0, sub_cols);
+				continue;
+			}
+
+			/* What the previous frame does not cover. */
+			cancelled = draw_subgrid(pool, frame, spec, stride, a, b,
+					0, rows.from, 0, sub_cols)
+				|| draw_subgrid(pool, frame, spec, stride, a, b,
+					rows.to, sub_rows, 0, sub_cols)
+				|| draw_subgrid(pool, frame, spec, stride, a, b,
+					rows.from, rows.to, 0, cols.from)
+				|| draw_subgrid(pool, frame, spec, stride, a, b,
+					rows.from, rows.to, cols.to, sub_cols);
+		}
+	}
+
+	if (cancelled)
+		return 1;
+
+	if (frame->reuse) {
+		frame->reuse->samples = (size_t)spec->rows * spec->cols;
+		frame->reuse->reused = (rows.to - rows.from) * (cols.to - cols.from);
+	}
+
+	lines.spec = spec;
+	lines.iterations = pool->iterations;
+	lines.img = frame->img->image;
+	lines.params = frame->params;
+	lines.render = frame->render;
+	lines.threads = render_pool_threads(pool);
+	render_pool_run(pool, render_lines, &lines);
+
+	return 0;
+}
+
+/* First of the samples first, first + stride, ... of a probe at or past
+ * sample n of the image. */
+static size_t probe_index(size_t n, size_t first, unsigned stride)
+{
+	return (n > first) ? (n - first + stride - 1) / stride : 0;
+}
+
+/* Probes the image the way a tile is drawn, and starts each tile at the
+ * first budget past twice the most any probe sample in it took to escape.
+ * Returns non-zero if cancelled. */
+static int plan_budgets(struct render_pool_s *pool, const struct render_frame_s *frame,
+	struct draw_tiles_data_s *data)
+{
+	struct frg_iteration_request_s spec;
+	std::vector<unsigned> counts;
+	std::vector<float> distance;
+	unsigned ceiling = data->spec.iterations;
+	unsigned budget = MB_MIN(ADAPTIVE_START, ceiling);
+	unsigned stride = PROBE_STRIDE;
+	unsigned most;
+	size_t a;
+	size_t b;
+	size_t rows;
+	size_t cols;
+	size_t tile;
+	size_t line;
+	size_t col;
+	size_t i;
+	size_t j;
+
+	while (stride > 1 && MB_MIN(data->spec.rows, data->spec.cols) / stride < PROBE_MIN_SIDE)
+		stride /= 2;
+
+	/* The probe goes through the centre of the viewport, so that iterators
+	 * that keep something of the centre can keep it for the tiles. */
+	region_spec(data, 0, 0, data->spec.rows, data->spec.cols, &spec);
+	a = (size_t)((-spec.row_offset % (long)stride + stride) % stride);
+	b = (size_t)((-spec.col_offset % (long)stride + stride) % stride);
+	rows = probe_index(data->spec.rows, a, stride);
+	cols = probe_index(data->spec.cols, b, stride);
+	counts.resize(rows * cols);
+	distance.resize(data->distance ? rows * cols : 0);
+
+	for (;;) {
+		if (count_subgrid(pool, frame, &spec, stride, a, b, rows, cols,
+				budget, counts.data(), data->distance ? distance.data() : NULL))
+			return 1;
+
+		if (budget >= ceiling || !needs_more(counts.data(), cols, rows, cols, budget))
+			break;
+
+		budget = next_budget(budget, ceiling);
+	}
+
+	frame->adaptive->probe = budget;
+	data->budgets.assign(data->tile_count, 0);
+
+	for (tile = 0; tile < data->tile_count; tile++) {
+		line = data->first_line + (tile / data->tiles_per_row) * data->tile_rows;
+		col = (tile % data->tiles_per_row) * data->tile_cols;
+		most = 0;
+
+		for (i = probe_index(line, a, stride);
+				i < probe_index(MB_MIN(line + data->tile_rows, data->last_line), a, stride); i++) {
+			for (j = probe_index(col, b, stride);
+					j < probe_index(MB_MIN(col + data->tile_cols, data->spec.cols), b, stride); j++) {
+				if (counts[i * cols + j] < budget)
+					most = MB_MAX(most, counts[i * cols + j]);
+			}
+		}
+
+		data->budgets[tile] = MB_MIN(ADAPTIVE_START, ceiling);
+		while (data->budgets[tile] < ceiling && data->budgets[tile] <= 2ull * most)
+			data->budgets[tile] = next_budget(data->budgets[tile], ceiling);
+	}
+
+	return 0;
+}
+
+/* Tells how far tiles went, and colours the frame as if that were as far
+ * as it was counted. Parts are coloured up to the ceiling, which all of
+ * them share. */
+static void finish_budgets(struct render_pool_s *pool, const struct render_frame_s *frame,
+	struct draw_tiles_data_s *data, bool part)
+{
+	struct render_adaptive_s *adaptive = frame->adaptive;
+	struct render_lines_data_s lines;
+	struct frg_iteration_request_s spec;
+	std::vector<unsigned> budgets;
+	size_t i;
+
+	for (i = 0; i < data->budgets.size(); i++) {
+		if (data->budgets[i])
+			budgets.push_back(data->budgets[i]);
+	}
+
+	std::sort(budgets.begin(), budgets.end());
+	adaptive->count = 0;
+
+	for (i = 0; i < budgets.size(); i++) {
+		if (!adaptive->count || adaptive->budgets[adaptive->count - 1] != budgets[i]) {
+			if (adaptive->count == RENDER_MAX_BUDGETS)
+				break;
+
+			adaptive->budgets[adaptive->count] = budgets[i];
+			adaptive->tiles[adaptive->count++] = 0;
+		}
+
+		adaptive->tiles[adaptive->count - 1]++;
+	}
+
+	region_spec(data, 0, 0, data->spec.rows, data->spec.cols, &spec);
+	if (!part && !budgets.empty())
+		spec.iterations = budgets.back();
+
+	lines.spec = &spec;
+	lines.iterations = data->iterations;
+	lines.img = frame->img->image;
+	lines.params = frame->params;
+	lines.render = frame->render;
+	lines.threads = render_pool_threads(pool);
+	render_pool_run(pool, render_lines, &lines);
+}
+
+/* Where an image lies in a larger one, in samples from the bottom left. */
+struct part_s {
+	size_t width;
+	size_t height;
+	size_t x;
+	size_t y;
+};
+
+/* Draws the image, or the part of a larger one if part is set. */
+static int draw_frame(struct render_pool_s *pool, const struct render_frame_s *frame,
+	const struct part_s *part)
+{
+	struct bmp_img *img = frame->img;
+	struct draw_tiles_data_s data;
+	uint16_t first_line;
+	uint16_t last_line;
+	uint16_t line;
+	long axis;
+	double step;
+	size_t width = part ? part->width : img->width;
+	size_t height = part ? part->height : img->height;
+	size_t smaller_dimension;
+	unsigned threads;
+	unsigned *itrbuf;
+	float *distbuf = NULL;
+	struct big_fixed step_bf;
+	int ret;
+
+	smaller_dimension = MB_MIN(width, height);
+	step = frame->r / smaller_dimension;
+	bf_init(&step_bf, 1, bf_frac_u32s(frame->r_bf));
+	bf_set(&step_bf, frame->r_bf);
+	bf_div_u32_i(&step_bf, (uint32_t)smaller_dimension);
+
+	axis = -1;
+	first_line = 0;
+	last_line = img->height;
+
+	if ((frame->iterate_flags & FRG_ITERATOR_CONJ_SYMMETRIC) && !part)
+		axis = conj_row_range(frame->org.img, step, img->height, &first_line, &last_line);
+
+	image_buffers_reserve(pool, (size_t)img->width * img->height,
+		frame->iterate_flags & FRG_ITERATOR_DISTANCE);
+	itrbuf = pool->iterations;
+
+	if (frame->iterate_flags & FRG_ITERATOR_DISTANCE)
+		distbuf = pool->distance;
+
+	data.spec.rows = img->height;
+	data.spec.cols = img->width;
+	data.spec.iterations = frame->iterations;
+	data.spec.col_offset = -(long)(width / 2);
+	data.spec.row_offset = -(long)(height / 2);
+	data.spec.from_x = frame->org.real + data.spec.col_offset * step;
+	data.spec.from_y = frame->org.img + data.spec.row_offset * step;
+	data.spec.step = step;
+	data.spec.centre_x = frame->org_real_bf;
+	data.spec.centre_y = frame->org_img_bf;
+	data.spec.step_bf = &step_bf;
+	data.spec.distance = NULL;
+	data.col_base = part ? part->x : 0;
+	data.row_base = part ? part->y : 0;
+
+	if (frame->incremental && !part && !frame->adaptive) {
+		ret = draw_aligned(pool, frame, &data.spec);
+
+		if (ret >= 0) {
+			if (!ret) {
+				dump_iterations(itrbuf, img->height, img->width);
+				remember_frame(pool, frame);
+			}
+
+			bf_destroy(&step_bf);
+			return ret;
+		}
+	}
+
+	threads = render_pool_threads(pool);
+	data.first_line = first_line;
+	data.last_line = last_line;
+	data.iterations = itrbuf;
+	data.distance = distbuf;
+	data.img = img->image;
+	data.params = frame->params;
+	data.iterate = frame->iterate;
+	data.iterate_flags = frame->iterate_flags;
+	data.render = frame->render;
+	data.pool = pool;
+	data.reproj = (frame->reuse && !frame->adaptive) ? reproject(pool, frame, step) : NULL;
+	data.reused = 0;
+	data.checkpoint = part ? NULL : frame->checkpoint;
+	tiles_layout(&data, threads);
+
+	/* Tiles of an adaptive frame are coloured once all are done, when it is
+	 * known how far the furthest one went. */
+	if (frame->adaptive) {
+		data.img = NULL;
+
+		if (plan_budgets(pool, frame, &data)) {
+			bf_destroy(&step_bf);
+			return 1;
+		}
+	}
+
+	if (data.checkpoint)
+		restore_tiles(&data);
+
+	render_pool_run(pool, draw_tiles, &data);
+
+	/* The counts drawn so far are no good to the next frame, but those of
+	 * the frame before are still there. */
+	if (pool->cancel) {
+		bf_destroy(&step_bf);
+		return 1;
+	}
+
+	if (frame->reuse && !frame->adaptive) {
+		/* Rows copied across the real axis count as drawn. */
+		frame->reuse->samples = (size_t)data.spec.cols * (last_line - first_line);
+		frame->reuse->reused = data.reused;
+	}
+
+	for (line = 0; axis >= 0 && line < img->height; line++) {
+		if (line >= first_line && line < last_line)
+			continue;
+
+		memcpy(itrbuf + line * img->width, itrbuf + (axis - line) * img->width,
+			img->width * sizeof(itrbuf[0]));
+		memcpy(img->image + line * img->width, img->image + (axis - line) * img->width,
+			img->width * sizeof(img->image[0]));
+
+		if (distbuf) {
+			memcpy(distbuf + line * img->width, distbuf + (axis - line) * img->width,
+				img->width * sizeof(distbuf[0]));
+		}
+	}
+
+	if (frame->adaptive)
+		finish_budgets(pool, frame, &data, part != NULL);
+
+	dump_iterations(itrbuf, img->height, img->width);
+
+	/* A part has no place of its own to line the next frame up with. */
+	if (!part)
+		remember_frame(pool, frame);
+
+	bf_destroy(&step_bf);
+
+	return 0;
+}
+
+extern "C" int render_frame(struct render_pool_s *pool, const struct render_frame_s *frame)
+{
+	return draw_frame(pool, frame, NULL);
+}
+
+extern "C" struct bmp_img * render_part(struct render_pool_s *pool,
+	const struct render_frame_s *whole, unsigned long width, unsigned long height,
+	unsigned level, unsigned long x, unsigned long y, unsigned long w, unsigned long h)
+{
+	struct render_frame_s frame = *whole;
+	struct part_s part;
+	struct bmp_img *img;
+	struct bmp_img *downsampled;
+
+	part.width = width << level;
+	part.height = height << level;
+	part.x = x << level;
+	part.y = (height - y - h) << level;
+
+	img = bmp_new((uint16_t)(w << level), (uint16_t)(h << level));
+	frame.img = img;
+	frame.reuse = NULL;
+	frame.incremental = 0;
+	draw_frame(pool, &frame, &part);
+
+	if (!level)
+		return img;
+
+	downsampled = bmp_downsample(img, level);
+	bmp_delete(img);
+
+	return downsampled;
+}
@@ -0,0 +1,176 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <stdint.h>
+
+#include <vector>
+#include <atomic>
+#include <algorithm>
+
+#include "scatter.h"
+#include "global.h"
+
+/* One sample in this many may be brighter than the reference and is clipped
+ * to white. */
+#define CLIP_SHARE	(1000)
+
+struct scatter_job_s {
+	const struct scatter_s *sc;
+	struct frg_scatter_request_s spec;
+	unsigned threads;
+
+	std::atomic<unsigned long long> next;
+	unsigned long long batches;
+
+	/* One histogram per thread, and their sum. */
+	std::vector<std::vector<uint64_t> > histograms;
+	std::vector<uint64_t> total;
+
+	double reference;
+	struct bmp_img *img;
+};
+
+/* Each thread counts into its own histogram, which it also clears, so that
+ * its pages end up close to it. */
+static void scatter_batches(void *arg, unsigned worker)
+{
+	struct scatter_job_s *job = (struct scatter_job_s *)arg;
+	struct frg_scatter_request_s spec = job->spec;
+	std::vector<uint64_t> &histogram = job->histograms[worker];
+	unsigned long long batch;
+
+	histogram.assign((size_t)spec.rows * spec.cols, 0);
+	spec.histogram = histogram.data();
+
+	while ((batch = job->next++) < job->batches) {
+		spec.samples = (unsigned long)MB_MIN((unsigned long long)SCATTER_BATCH,
+			job->sc->orbits - batch * SCATTER_BATCH);
+		spec.seed = batch;
+		job->sc->scatter(&spec, job->sc->frame.params);
+	}
+}
+
+/* Rows of the image the thread sums up or colours. */
+static void strip_of(const struct scatter_job_s *job, unsigned worker, size_t *first,
+	size_t *last)
+{
+	size_t rows = (job->spec.rows + job->threads - 1) / job->threads;
+
+	*first = MB_MIN((size_t)worker * rows, (size_t)job->spec.rows);
+	*last = MB_MIN(*first + rows, (size_t)job->spec.rows);
+}
+
+static void reduce_lines(void *arg, unsigned worker)
+{
+	struct scatter_job_s *job = (struct scatter_job_s *)arg;
+	size_t cols = job->spec.cols;
+	size_t first;
+	size_t last;
+	size_t i;
+	size_t w;
+
+	strip_of(job, worker, &first, &last);
+	std::fill(job->total.begin() + first * cols, job->total.begin() + last * cols, 0);
+
+	for (w = 0; w < job->histograms.size(); w++) {
+		for (i = first * cols; i < last * cols; i++)
+			job->total[i] += job->histograms[w][i];
+	}
+}
+
+static void tone_lines(void *arg, unsigned worker)
+{
+	struct scatter_job_s *job = (struct scatter_job_s *)arg;
+	size_t cols = job->spec.cols;
+	size_t first;
+	size_t last;
+	size_t i;
+	double v;
+	unsigned char grey;
+
+	strip_of(job, worker, &first, &last);
+
+	for (i = first * cols; i < last * cols; i++) {
+		v = job->reference ? MB_MIN(job->total[i] / job->reference, 1.0) : 0.0;
+		grey = (unsigned char)(255.0 * pow(v, job->sc->gamma) + 0.5);
+		job->img->image[i].r = grey;
+		job->img->image[i].g = grey;
+		job->img->image[i].b = grey;
+	}
+}
+
+/* The count only one sample in CLIP_SHARE exceeds, or the largest one if
+ * that is zero. */
+static double reference_count(const std::vector<uint64_t> &total)
+{
+	std::vector<uint64_t> counts(total);
+	size_t k = counts.size() - 1 - counts.size() / CLIP_SHARE;
+
+	std::nth_element(counts.begin(), counts.begin() + k, counts.end());
+	if (counts[k])
+		return (double)counts[k];
+
+	return (double)*std::max_element(counts.begin() + k, counts.end());
+}
+
+extern "C" int scatter(struct render_pool_s *pool, const struct scatter_s *sc)
+{
+	struct scatter_job_s job;
+	struct bmp_img *img;
+	struct bmp_img *downsampled;
+	size_t smaller_dimension;
+	double step;
+	FILE *f;
+	int ret;
+
+	job.sc = sc;
+	job.threads = render_pool_threads(pool);
+	job.spec.cols = (unsigned)sc->width << sc->supersample_level;
+	job.spec.rows = (unsigned)sc->height << sc->supersample_level;
+	job.spec.iterations = sc->frame.iterations;
+
+	smaller_dimension = MB_MIN(job.spec.cols, job.spec.rows);
+	step = sc->frame.r / smaller_dimension;
+	job.spec.from_x = sc->frame.org.real - (double)(job.spec.cols / 2) * step;
+	job.spec.from_y = sc->frame.org.img - (double)(job.spec.rows / 2) * step;
+	job.spec.step = step;
+	job.spec.histogram = NULL;
+
+	job.next = 0;
+	job.batches = (sc->orbits + SCATTER_BATCH - 1) / SCATTER_BATCH;
+	job.histograms.resize(job.threads);
+	job.total.resize((size_t)job.spec.rows * job.spec.cols);
+
+	printf("Following %llu orbits in %llu batches\n", sc->orbits, job.batches);
+
+	render_pool_run(pool, scatter_batches, &job);
+	render_pool_run(pool, reduce_lines, &job);
+	job.histograms.clear();
+
+	job.reference = reference_count(job.total);
+	printf("Reference count %.0f\n", job.reference);
+
+	img = bmp_new((uint16_t)job.spec.cols, (uint16_t)job.spec.rows);
+	job.img = img;
+	render_pool_run(pool, tone_lines, &job);
+
+	if (!(f = fopen(sc->path, "wb"))) {
+		perror(sc->path);
+		bmp_delete(img);
+		return 1;
+	}
+
+	if (sc->supersample_level) {
+		downsampled = bmp_downsample(img, sc->supersample_level);
+		ret = bmp_write_f(downsampled, f) != BMP_SUCCESS;
+		bmp_delete(downsampled);
+	} else {
+		ret = bmp_write_f(img, f) != BMP_SUCCESS;
+	}
+
+	ret = fclose(f) || ret;
+	bmp_delete(img);
+
+	return ret;
+}
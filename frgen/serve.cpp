@@ -0,0 +1,310 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+
+#include <string>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <sstream>
+
+#if !defined(_WIN32) && !defined(_WIN64)
+#include <signal.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#endif
+
+#include "serve.h"
+#include "netio.h"
+#include "stream.h"
+#include "global.h"
+
+/* Requests read but not yet taken up, oldest first. */
+struct request_queue_s {
+	std::mutex lock;
+	std::condition_variable wake;
+	std::vector<std::string> lines;
+	bool eof;
+};
+
+struct request_s {
+	unsigned long id;
+	unsigned width;
+	unsigned height;
+	std::string x;
+	std::string y;
+	std::string r;
+};
+
+/* True if str is a whole number, as strtod reads them. */
+static bool is_number(const std::string &str, double *d)
+{
+	char *end;
+
+	*d = strtod(str.c_str(), &end);
+
+	return end != str.c_str() && !*end && isfinite(*d);
+}
+
+/* Returns 0 for a request that can be drawn, 1 for one that can't and -1 if
+ * it has not even got an id. */
+static int parse_request(const std::string &line, uint16_t level, struct request_s *req)
+{
+	std::istringstream fields(line);
+	double d;
+
+	if (!(fields >> req->id))
+		return -1;
+
+	if (!(fields >> req->width >> req->height >> req->x >> req->y >> req->r))
+		return 1;
+
+	/* Shifted first, the size could wrap around past the check. */
+	if (!req->width || !req->height
+			|| req->width > (UINT16_MAX >> level) || req->height > (UINT16_MAX >> level))
+		return 1;
+
+	if (!is_number(req->x, &d) || !is_number(req->y, &d))
+		return 1;
+
+	if (!is_number(req->r, &d) || d <= 0.0)
+		return 1;
+
+	return 0;
+}
+
+/* Queues every line of in, and cancels the frame being drawn if the line is
+ * a request that can be drawn in its place. */
+static void read_requests(FILE *in, uint16_t level, struct request_queue_s *queue,
+	struct render_pool_s *pool)
+{
+	struct request_s req;
+	std::string line;
+
+	while (net_read_line(in, line)) {
+		if (!line.empty() && line.back() == '\r')
+			line.pop_back();
+		if (line.find_first_not_of(" \t") == std::string::npos)
+			continue;
+
+		std::lock_guard<std::mutex> guard(queue->lock);
+		queue->lines.push_back(line);
+		if (!parse_request(line, level, &req))
+			render_pool_cancel(pool, 1);
+		queue->wake.notify_one();
+	}
+
+	std::lock_guard<std::mutex> guard(queue->lock);
+	queue->eof = true;
+	queue->wake.notify_one();
+}
+
+/* Same as the command line does for -x, -y and -r. */
+static void bf_from_str(struct big_fixed *f, const std::string &str, size_t frac)
+{
+	if (!bf_init_from_str(f, 1, frac, str.c_str()))
+		return;
+
+	bf_destroy(f);
+	bf_init_d(f, 1, frac, strtod(str.c_str(), NULL));
+}
+
+static int draw_request(struct render_pool_s *pool, const struct server_s *server,
+	const struct request_s *req, FILE *out, struct bmp_img **img, std::vector<unsigned char> &bytes)
+{
+	struct render_frame_s frame = server->frame;
+	struct frame_stream_s s;
+	struct big_fixed org_real;
+	struct big_fixed org_img;
+	struct big_fixed r;
+	uint16_t img_width;
+	uint16_t img_height;
+	size_t frac;
+	int cancelled;
+
+	img_width = (uint16_t)(req->width << server->supersample_level);
+	img_height = (uint16_t)(req->height << server->supersample_level);
+	if (!*img || (*img)->width != img_width || (*img)->height != img_height) {
+		bmp_delete(*img);
+		*img = bmp_new(img_width, img_height);
+	}
+
+	frac = MB_MAX(bf_str_frac_u32s(req->x.c_str()), bf_str_frac_u32s(req->y.c_str()));
+	frac = MB_MAX(frac, bf_str_frac_u32s(req->r.c_str()) + 1) + 2;
+	bf_from_str(&org_real, req->x, frac);
+	bf_from_str(&org_img, req->y, frac);
+	bf_from_str(&r, req->r, frac);
+
+	frame.img = *img;
+	frame.org.real = strtod(req->x.c_str(), NULL);
+	frame.org.img = strtod(req->y.c_str(), NULL);
+	frame.r = strtod(req->r.c_str(), NULL);
+	frame.org_real_bf = &org_real;
+	frame.org_img_bf = &org_img;
+	frame.r_bf = &r;
+
+	cancelled = render_frame(pool, &frame);
+
+	bf_destroy(&org_real);
+	bf_destroy(&org_img);
+	bf_destroy(&r);
+
+	if (cancelled)
+		return fprintf(out, "%lu cancelled\n", req->id) < 0 || fflush(out);
+
+	s.f = out;
+	s.format = STREAM_RGB;
+	s.width = (uint16_t)req->width;
+	s.height = (uint16_t)req->height;
+	s.supersample_level = server->supersample_level;
+	s.fps = 0;
+
+	bytes.resize(stream_frame_bytes(&s));
+	stream_convert(&s, pool, *img, bytes.data());
+
+	if (fprintf(out, "%lu %u %u\n", req->id, req->width, req->height) < 0)
+		return 1;
+
+	return stream_write(&s, bytes.data());
+}
+
+/* Answers the requests of one client until it has no more. Only the newest
+ * request waiting that can be drawn is drawn, the ones before it are
+ * cancelled unseen. */
+static int serve_client(struct render_pool_s *pool, const struct server_s *server,
+	FILE *in, FILE *out)
+{
+	struct request_queue_s queue;
+	std::vector<std::string> lines;
+	std::vector<struct request_s> reqs;
+	std::vector<int> errs;
+	std::vector<unsigned char> bytes;
+	struct bmp_img *img = NULL;
+	bool failed = false;
+	size_t newest;
+	size_t i;
+
+	queue.eof = false;
+	std::thread reader(read_requests, in, server->supersample_level, &queue, pool);
+
+	for (;;) {
+		{
+			std::unique_lock<std::mutex> guard(queue.lock);
+
+			queue.wake.wait(guard, [&] { return queue.eof || !queue.lines.empty(); });
+			if (queue.lines.empty())
+				break;
+
+			lines.swap(queue.lines);
+			queue.lines.clear();
+			render_pool_cancel(pool, 0);
+		}
+
+		reqs.resize(lines.size());
+		errs.resize(lines.size());
+		newest = lines.size();
+		for (i = 0; i < lines.size(); i++) {
+			errs[i] = parse_request(lines[i], server->supersample_level, &reqs[i]);
+			if (!errs[i])
+				newest = i;
+		}
+
+		/* Once the other end stops listening, requests are only read. */
+		for (i = 0; i < lines.size() && !failed; i++) {
+			if (errs[i] < 0) {
+				failed = fputs("? error\n", out) < 0 || fflush(out);
+			} else if (errs[i]) {
+				failed = fprintf(out, "%lu error\n", reqs[i].id) < 0 || fflush(out);
+			} else if (i != newest) {
+				failed = fprintf(out, "%lu cancelled\n", reqs[i].id) < 0 || fflush(out);
+			} else {
+				failed = draw_request(pool, server, &reqs[i], out, &img, bytes) != 0;
+			}
+		}
+	}
+
+	reader.join();
+	bmp_delete(img);
+
+	return failed;
+}
+
+#if defined(_WIN32) || defined(_WIN64)
+static int serve_socket(struct render_pool_s *pool, const struct server_s *server)
+{
+	(void)pool;
+	(void)server;
+	fputs("Unix sockets are not supported on this platform\n", stderr);
+
+	return 1;
+}
+#else
+/* Serves one client at a time, for as long as the socket is up. */
+static int serve_socket(struct render_pool_s *pool, const struct server_s *server)
+{
+	struct sockaddr_un addr;
+	FILE *in;
+	FILE *out;
+	int fd;
+	int client;
+
+	if (strlen(server->socket_path) >= sizeof(addr.sun_path)) {
+		fprintf(stderr, "Socket path %s is too long\n", server->socket_path);
+		return 1;
+	}
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	strcpy(addr.sun_path, server->socket_path);
+	unlink(server->socket_path);
+
+	fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (fd < 0 || bind(fd, (struct sockaddr *)&addr, sizeof(addr)) || listen(fd, 1)) {
+		perror(server->socket_path);
+		if (fd >= 0)
+			close(fd);
+		return 1;
+	}
+
+	printf("Listening on %s\n", server->socket_path);
+	fflush(stdout);
+
+	while ((client = accept(fd, NULL, NULL)) >= 0) {
+		in = fdopen(client, "rb");
+		out = fdopen(dup(client), "wb");
+
+		if (in && out)
+			serve_client(pool, server, in, out);
+
+		if (in)
+			fclose(in);
+		else
+			close(client);
+		if (out)
+			fclose(out);
+	}
+
+	perror("accept");
+	close(fd);
+	unlink(server->socket_path);
+
+	return 1;
+}
+#endif
+
+int serve(struct render_pool_s *pool, const struct server_s *server)
+{
+#if !defined(_WIN32) && !defined(_WIN64)
+	/* A client going away shows up as a failed write. */
+	signal(SIGPIPE, SIG_IGN);
+#endif
+
+	if (server->socket_path)
+		return serve_socket(pool, server);
+
+	return serve_client(pool, server, server->in, server->out);
+}
@@ -0,0 +1,197 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <atomic>
+
+#if defined(_WIN32) || defined(_WIN64)
+#include <io.h>
+#define dup _dup
+#define dup2 _dup2
+#define fdopen _fdopen
+#else
+#include <unistd.h>
+#endif
+
+#include "stream.h"
+
+struct convert_data_s {
+	const struct frame_stream_s *s;
+	const struct bmp_img *img;
+	unsigned char *dest;
+	std::atomic<size_t> next;
+	size_t count;
+};
+
+enum stream_format stream_format_parse(const char *name)
+{
+	if (!strcmp(name, "y4m"))
+		return STREAM_Y4M;
+	if (!strcmp(name, "rgb"))
+		return STREAM_RGB;
+
+	return STREAM_NONE;
+}
+
+FILE * stream_take_stdout(void)
+{
+	FILE *ret;
+	int fd;
+
+	fflush(stdout);
+	fd = dup(fileno(stdout));
+	ret = (fd < 0) ? NULL : fdopen(fd, "wb");
+	dup2(fileno(stderr), fileno(stdout));
+
+	return ret;
+}
+
+int stream_open(struct frame_stream_s *s, const char *path, enum stream_format format,
+	uint16_t width, uint16_t height, uint16_t supersample_level, unsigned fps)
+{
+	if (format == STREAM_Y4M && (width % 2 || height % 2)) {
+		fputs("YUV4MPEG2 frames need an even width and height\n", stderr);
+		return 1;
+	}
+
+	s->f = strcmp(path, "-") ? fopen(path, "wb") : stream_take_stdout();
+
+	if (!s->f) {
+		fprintf(stderr, "Can't open %s for writing!\n", path);
+		return 1;
+	}
+
+	s->format = format;
+	s->width = width;
+	s->height = height;
+	s->supersample_level = supersample_level;
+	s->fps = fps ? fps : 30;
+
+	if (format == STREAM_Y4M) {
+		fprintf(s->f, "YUV4MPEG2 W%u H%u F%u:1 Ip A1:1 C420jpeg\n",
+			(unsigned)width, (unsigned)height, s->fps);
+	}
+
+	return 0;
+}
+
+void stream_close(struct frame_stream_s *s)
+{
+	fclose(s->f);
+}
+
+size_t stream_frame_bytes(const struct frame_stream_s *s)
+{
+	size_t pixels = (size_t)s->width * s->height;
+
+	return (s->format == STREAM_Y4M) ? pixels + pixels / 2 : 3 * pixels;
+}
+
+/* Pixel (x, y) of the stream, counting rows from the top. */
+static struct pixel stream_pixel(const struct frame_stream_s *s, const struct bmp_img *img,
+	size_t x, size_t y)
+{
+	uint16_t size = (uint16_t)(1 << s->supersample_level);
+
+	return bmp_average_area(img, (uint16_t)(x * size), (uint16_t)((s->height - 1 - y) * size),
+		size, size);
+}
+
+static unsigned char luma(struct pixel p)
+{
+	return (unsigned char)(((66 * p.r + 129 * p.g + 25 * p.b + 128) >> 8) + 16);
+}
+
+/* Converts a pair of rows to 4:2:0, which shares one sample of each chroma
+ * plane between 2 x 2 pixels. */
+static void convert_y4m(struct convert_data_s *data, size_t pair)
+{
+	const struct frame_stream_s *s = data->s;
+	unsigned char *y_plane = data->dest;
+	unsigned char *u_plane = y_plane + (size_t)s->width * s->height;
+	unsigned char *v_plane = u_plane + (size_t)s->width * s->height / 4;
+	struct pixel p[4];
+	size_t chroma;
+	size_t col;
+	int r;
+	int g;
+	int b;
+
+	for (col = 0; col < s->width; col += 2) {
+		p[0] = stream_pixel(s, data->img, col, 2 * pair);
+		p[1] = stream_pixel(s, data->img, col + 1, 2 * pair);
+		p[2] = stream_pixel(s, data->img, col, 2 * pair + 1);
+		p[3] = stream_pixel(s, data->img, col + 1, 2 * pair + 1);
+
+		y_plane[2 * pair * s->width + col] = luma(p[0]);
+		y_plane[2 * pair * s->width + col + 1] = luma(p[1]);
+		y_plane[(2 * pair + 1) * s->width + col] = luma(p[2]);
+		y_plane[(2 * pair + 1) * s->width + col + 1] = luma(p[3]);
+
+		r = (p[0].r + p[1].r + p[2].r + p[3].r + 2) / 4;
+		g = (p[0].g + p[1].g + p[2].g + p[3].g + 2) / 4;
+		b = (p[0].b + p[1].b + p[2].b + p[3].b + 2) / 4;
+		chroma = pair * (s->width / 2) + col / 2;
+
+		u_plane[chroma] = (unsigned char)(((-38 * r - 74 * g + 112 * b + 128) >> 8) + 128);
+		v_plane[chroma] = (unsigned char)(((112 * r - 94 * g - 18 * b + 128) >> 8) + 128);
+	}
+}
+
+static void convert_rgb(struct convert_data_s *data, size_t line)
+{
+	const struct frame_stream_s *s = data->s;
+	unsigned char *dest = data->dest + 3 * line * s->width;
+	struct pixel p;
+	size_t col;
+
+	for (col = 0; col < s->width; col++) {
+		p = stream_pixel(s, data->img, col, line);
+		dest[3 * col] = p.r;
+		dest[3 * col + 1] = p.g;
+		dest[3 * col + 2] = p.b;
+	}
+}
+
+static void convert_lines(void *arg, unsigned worker)
+{
+	struct convert_data_s *data = (struct convert_data_s *)arg;
+	size_t unit;
+
+	(void)worker;
+
+	while ((unit = data->next++) < data->count) {
+		if (data->s->format == STREAM_Y4M)
+			convert_y4m(data, unit);
+		else
+			convert_rgb(data, unit);
+	}
+}
+
+void stream_convert(const struct frame_stream_s *s, struct render_pool_s *pool,
+	const struct bmp_img *img, unsigned char *dest)
+{
+	struct convert_data_s data;
+
+	data.s = s;
+	data.img = img;
+	data.dest = dest;
+	data.next = 0;
+	data.count = (s->format == STREAM_Y4M) ? s->height / 2 : s->height;
+
+	render_pool_run(pool, convert_lines, &data);
+}
+
+int stream_write(const struct frame_stream_s *s, const unsigned char *frame)
+{
+	if (s->format == STREAM_Y4M)
+		fputs("FRAME\n", s->f);
+
+	if (fwrite(frame, 1, stream_frame_bytes(s), s->f) != stream_frame_bytes(s)
+			|| fflush(s->f)) {
+		fputs("Can't write to the frame stream\n", stderr);
+		return 1;
+	}
+
+	return 0;
+}
@@ -0,0 +1,86 @@
+#include "interval.h"
+#include "tile.h"
+
+/* Cardiod: q = (x - 1/4)^2 + y^2, inside if q (q + x - 1/4) <= y^2 / 4.
+ * Bulb: inside if (x + 1)^2 + y^2 <= 1/16. */
+static int box_inside_known(struct interval x, struct interval y)
+{
+	struct interval x_shift;
+	struct interval y_sqr;
+	struct interval q;
+	struct interval lhs;
+
+	x_shift = iv_add_d(x, -0.25);
+	y_sqr = iv_sqr(y);
+	q = iv_add(iv_sqr(x_shift), y_sqr);
+	lhs = iv_mul(q, iv_add(q, x_shift));
+
+	if (lhs.hi <= iv_mul_pow2(y_sqr, -2).lo)
+		return 1;
+
+	return iv_add(iv_sqr(iv_add_d(x, 1.0)), y_sqr).hi <= 0.0625;
+}
+
+/* Samples from, from + step, ... Both from and step are themselves rounded
+ * from the exact viewport, and past double precision step vanishes next to
+ * from altogether, so the box is padded by a few ulps of its ends. */
+static struct interval tile_span(double from, double step, unsigned count)
+{
+	double to;
+	double pad;
+
+	to = from + (count - 1) * step;
+	pad = 4.0 * (nextafter(fmax(fabs(from), fabs(to)), INFINITY)
+		- fmax(fabs(from), fabs(to)));
+
+	return iv_widen(from - pad, to + pad);
+}
+
+int tile_classify(double from_x, double from_y, double step, unsigned rows,
+	unsigned cols, unsigned iterations, unsigned *iterations_ret)
+{
+	struct interval cx;
+	struct interval cy;
+	struct interval x;
+	struct interval y;
+	struct interval x_sqr;
+	struct interval y_sqr;
+	struct interval mag;
+	unsigned n;
+
+	if (!rows || !cols)
+		return 0;
+
+	cx = tile_span(from_x, step, cols);
+	cy = tile_span(from_y, step, rows);
+
+	if (box_inside_known(cx, cy)) {
+		*iterations_ret = iterations;
+		return 1;
+	}
+
+	x = cx;
+	y = cy;
+
+	for (n = 0; n < iterations; n++) {
+		x_sqr = iv_sqr(x);
+		y_sqr = iv_sqr(y);
+		mag = iv_add(x_sqr, y_sqr);
+
+		if (mag.lo > 4.0) {
+			*iterations_ret = n;
+			return 1;
+		}
+
+		/* Some samples may have escaped and others not. */
+		if (mag.hi > 4.0)
+			return 0;
+
+		/* y = 2xy + cy, x = x^2 - y^2 + cx */
+		y = iv_add(iv_mul_pow2(iv_mul(x, y), 1), cy);
+		x = iv_add(iv_sub(x_sqr, y_sqr), cx);
+	}
+
+	*iterations_ret = iterations;
+	return 1;
+}
@@ -0,0 +1,533 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#include <string>
+#include <vector>
+#include <list>
+#include <unordered_map>
+#include <unordered_set>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+#if !defined(_WIN32) && !defined(_WIN64)
+#include <signal.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <dirent.h>
+#include <sys/socket.h>
+#endif
+
+#include "tileserve.h"
+#include "netio.h"
+#include "global.h"
+
+/* Tiles deeper than this would need more than a 64 bit tile number. */
+#define MAX_TILE_ZOOM	(52)
+
+/* Longest request header read. */
+#define MAX_REQUEST		(8192)
+
+/* Connections answered at once. Further ones wait to be accepted. */
+#define MAX_CONNECTIONS		(32)
+
+/* First line of the file in a tile directory that tells which render its
+ * tiles are of, the key being the second. */
+#define TILE_DIR_HEADER		"frgen tiles 1"
+#define TILE_DIR_KEY_FILE	"render.key"
+
+typedef std::shared_ptr<const std::vector<unsigned char> > tile_bytes;
+
+struct tile_key_s {
+	unsigned z;
+	unsigned long long x;
+	unsigned long long y;
+
+	bool operator==(const struct tile_key_s &other) const
+	{
+		return z == other.z && x == other.x && y == other.y;
+	}
+};
+
+struct tile_key_hash_s {
+	size_t operator()(const struct tile_key_s &key) const
+	{
+		return std::hash<unsigned long long>()(key.x * 0x9e3779b97f4a7c15ull
+			^ key.y * 0xc2b2ae3d27d4eb4full ^ key.z);
+	}
+};
+
+/* Encoded tiles, the least recently used last, and the tiles being drawn.
+ * A tile asked for while it is being drawn waits for that drawing instead of
+ * starting another. */
+struct tile_cache_s {
+	const struct tile_server_s *server;
+	struct render_pool_s *pool;
+
+	std::mutex lock;
+	std::condition_variable drawn;
+	std::list<struct tile_key_s> lru;
+	std::unordered_map<struct tile_key_s,
+		std::pair<tile_bytes, std::list<struct tile_key_s>::iterator>,
+		struct tile_key_hash_s> tiles;
+	std::unordered_set<struct tile_key_s, struct tile_key_hash_s> pending;
+	size_t bytes;
+
+	/* The pool draws one tile at a time. */
+	std::mutex render_lock;
+
+	/* Connections being answered, each on a thread of its own. */
+	std::mutex connections_lock;
+	std::condition_variable connection_done;
+	unsigned connections;
+};
+
+static const char index_page[] =
+	"<!DOCTYPE html>\n"
+	"<html><head><meta charset=\"utf-8\"><title>frgen</title>\n"
+	"<link rel=\"stylesheet\" href=\"https://unpkg.com/leaflet@1.9.4/dist/leaflet.css\">\n"
+	"<script src=\"https://unpkg.com/leaflet@1.9.4/dist/leaflet.js\"></script>\n"
+	"<style>html, body, #map { margin: 0; height: 100%; background: #000; }</style>\n"
+	"</head><body><div id=\"map\"></div><script>\n"
+	"var map = L.map('map', { crs: L.CRS.Simple, minZoom: 0, maxZoom: 52 });\n"
+	"L.tileLayer('/{z}/{x}/{y}.bmp', { tileSize: 256, noWrap: true, maxZoom: 52,\n"
+	"\tbounds: [[-256, 0], [0, 256]] }).addTo(map);\n"
+	"map.setView([-128, 128], 1);\n"
+	"</script></body></html>\n";
+
+#if !defined(_WIN32) && !defined(_WIN64)
+
+/* Moves a coordinate by the sum of side / 2^k over the bits k of n that are
+ * set, counting from the most significant of z bits, which adds n * side /
+ * 2^z without multiplying. */
+static void bf_add_tiles(struct big_fixed *f, const struct big_fixed *side, unsigned z,
+	unsigned long long n, int sign)
+{
+	struct big_fixed part;
+	unsigned k;
+
+	bf_init(&part, 1, bf_frac_u32s(side));
+	bf_set(&part, side);
+
+	for (k = 1; k <= z; k++) {
+		bf_div_u32_i(&part, 2);
+
+		if (!((n >> (z - k)) & 1))
+			continue;
+
+		if (sign > 0)
+			bf_add_i(f, &part);
+		else
+			bf_sub_i(f, &part);
+	}
+
+	bf_destroy(&part);
+}
+
+/* Draws a tile and encodes it as a BMP. Returns NULL if it cannot. */
+static tile_bytes draw_tile(struct tile_cache_s *cache, const struct tile_key_s *key)
+{
+	const struct tile_server_s *server = cache->server;
+	struct render_frame_s frame = server->frame;
+	struct big_fixed org_real;
+	struct big_fixed org_img;
+	struct big_fixed r;
+	struct big_fixed half;
+	struct bmp_img *img;
+	struct bmp_img *downsampled;
+	std::vector<unsigned char> *bytes;
+	char *buf = NULL;
+	size_t length = 0;
+	size_t frac;
+	uint16_t pixels;
+	unsigned k;
+	FILE *f;
+
+	frac = MB_MAX(bf_frac_u32s(frame.org_real_bf), bf_frac_u32s(frame.org_img_bf));
+	frac = MB_MAX(frac, bf_frac_u32s(frame.r_bf)) + key->z / 32 + 2;
+
+	bf_init(&org_real, 1, frac);
+	bf_init(&org_img, 1, frac);
+	bf_init(&r, 1, frac);
+	bf_init(&half, 1, frac);
+	bf_set(&org_real, frame.org_real_bf);
+	bf_set(&org_img, frame.org_img_bf);
+	bf_set(&r, frame.r_bf);
+
+	/* The centre of tile (x, y) lies (x + 1/2) sides right of the left edge
+	 * of zoom 0 and (y + 1/2) sides below its top edge. */
+	bf_set(&half, &r);
+	bf_div_u32_i(&half, 2);
+	bf_sub_i(&org_real, &half);
+	bf_add_i(&org_img, &half);
+	bf_add_tiles(&org_real, &r, key->z, key->x, 1);
+	bf_add_tiles(&org_img, &r, key->z, key->y, -1);
+
+	for (k = 0; k < key->z; k++) {
+		bf_div_u32_i(&half, 2);
+		bf_div_u32_i(&r, 2);
+	}
+
+	bf_add_i(&org_real, &half);
+	bf_sub_i(&org_img, &half);
+
+	frame.org.real = bf_to_d(&org_real);
+	frame.org.img = bf_to_d(&org_img);
+	frame.r = bf_to_d(&r);
+	frame.org_real_bf = &org_real;
+	frame.org_img_bf = &org_img;
+	frame.r_bf = &r;
+	frame.reuse = NULL;
+	frame.incremental = 0;
+
+	pixels = (uint16_t)(TILE_PIXELS << server->supersample_level);
+	img = bmp_new(pixels, pixels);
+	frame.img = img;
+
+	{
+		std::lock_guard<std::mutex> guard(cache->render_lock);
+
+		render_frame(cache->pool, &frame);
+	}
+
+	downsampled = server->supersample_level
+		? bmp_downsample(img, server->supersample_level)
+		: NULL;
+
+	f = open_memstream(&buf, &length);
+	if (f) {
+		bmp_write_f(downsampled ? downsampled : img, f);
+		fclose(f);
+	}
+
+	bmp_delete(img);
+	bmp_delete(downsampled);
+	bf_destroy(&org_real);
+	bf_destroy(&org_img);
+	bf_destroy(&r);
+	bf_destroy(&half);
+
+	if (!f)
+		return NULL;
+
+	bytes = new std::vector<unsigned char>(buf, buf + length);
+	free(buf);
+
+	return tile_bytes(bytes);
+}
+
+static std::string tile_path(const char *dir, const struct tile_key_s *key, int parts)
+{
+	std::string ret(dir);
+
+	ret += "/" + std::to_string(key->z);
+	if (parts > 1)
+		ret += "/" + std::to_string(key->x);
+	if (parts > 2)
+		ret += "/" + std::to_string(key->y) + ".bmp";
+
+	return ret;
+}
+
+static tile_bytes load_tile(const char *dir, const struct tile_key_s *key)
+{
+	std::vector<unsigned char> *bytes;
+	unsigned char buf[4096];
+	size_t read;
+	FILE *f;
+
+	if (!dir || !(f = fopen(tile_path(dir, key, 3).c_str(), "rb")))
+		return NULL;
+
+	bytes = new std::vector<unsigned char>();
+	while ((read = fread(buf, 1, sizeof(buf), f)))
+		bytes->insert(bytes->end(), buf, buf + read);
+	fclose(f);
+
+	return tile_bytes(bytes);
+}
+
+/* Written to a temporary name first, so that a tile on disk is never half of
+ * one. */
+static void save_tile(const char *dir, const struct tile_key_s *key, const tile_bytes &bytes)
+{
+	std::string path;
+	std::string tmp;
+	FILE *f;
+
+	if (!dir)
+		return;
+
+	mkdir(dir, 0777);
+	mkdir(tile_path(dir, key, 1).c_str(), 0777);
+	mkdir(tile_path(dir, key, 2).c_str(), 0777);
+
+	path = tile_path(dir, key, 3);
+	tmp = path + ".tmp" + std::to_string((unsigned long)getpid());
+	if (!(f = fopen(tmp.c_str(), "wb")))
+		return;
+
+	if (fwrite(bytes->data(), 1, bytes->size(), f) != bytes->size()) {
+		fclose(f);
+		remove(tmp.c_str());
+		return;
+	}
+
+	fclose(f);
+	if (rename(tmp.c_str(), path.c_str()))
+		remove(tmp.c_str());
+}
+
+static bool dir_is_empty(const char *dir)
+{
+	struct dirent *entry;
+	bool empty = true;
+	DIR *d;
+
+	if (!(d = opendir(dir)))
+		return false;
+
+	while (empty && (entry = readdir(d)))
+		empty = !strcmp(entry->d_name, ".") || !strcmp(entry->d_name, "..");
+
+	closedir(d);
+
+	return empty;
+}
+
+/* Makes sure the tiles in dir are of the render described by key, as a
+ * checkpoint does, and marks an empty one as being of it. A directory of
+ * another render, or of files that are not tiles, is left alone. Returns
+ * non-zero if the tiles can't be kept there. */
+static int claim_tile_dir(const char *dir, const char *key)
+{
+	std::string path = std::string(dir) + "/" TILE_DIR_KEY_FILE;
+	std::string header;
+	std::string line;
+	bool written;
+	FILE *f;
+
+	if (mkdir(dir, 0777) && errno != EEXIST) {
+		perror(dir);
+		return 1;
+	}
+
+	if ((f = fopen(path.c_str(), "rb"))) {
+		written = net_read_line(f, header) && header == TILE_DIR_HEADER
+			&& net_read_line(f, line) && line == key;
+		fclose(f);
+
+		if (!written) {
+			fprintf(stderr, "Tile directory %s holds tiles of another render. "
+				"Clear it or pick another\n", dir);
+			return 1;
+		}
+
+		return 0;
+	}
+
+	if (!dir_is_empty(dir)) {
+		fprintf(stderr, "Tile directory %s is not empty and not one of frgen's. "
+			"Clear it or pick another\n", dir);
+		return 1;
+	}
+
+	if (!(f = fopen(path.c_str(), "wb"))) {
+		perror(path.c_str());
+		return 1;
+	}
+
+	written = fprintf(f, TILE_DIR_HEADER "\n%s\n", key) >= 0;
+	if (fclose(f) || !written) {
+		perror(path.c_str());
+		remove(path.c_str());
+		return 1;
+	}
+
+	return 0;
+}
+
+/* Looks a tile up in memory, then on disk, and draws it if neither has it. */
+static tile_bytes get_tile(struct tile_cache_s *cache, const struct tile_key_s *key)
+{
+	std::unique_lock<std::mutex> guard(cache->lock);
+	tile_bytes bytes;
+
+	for (;;) {
+		auto found = cache->tiles.find(*key);
+
+		if (found != cache->tiles.end()) {
+			cache->lru.splice(cache->lru.begin(), cache->lru, found->second.second);
+			return found->second.first;
+		}
+
+		if (!cache->pending.count(*key))
+			break;
+
+		cache->drawn.wait(guard);
+	}
+
+	cache->pending.insert(*key);
+	guard.unlock();
+
+	bytes = load_tile(cache->server->dir, key);
+	if (!bytes) {
+		bytes = draw_tile(cache, key);
+		if (bytes)
+			save_tile(cache->server->dir, key, bytes);
+	}
+
+	guard.lock();
+	cache->pending.erase(*key);
+
+	if (bytes && bytes->size() <= cache->server->cache_bytes) {
+		cache->lru.push_front(*key);
+		cache->tiles[*key] = std::make_pair(bytes, cache->lru.begin());
+		cache->bytes += bytes->size();
+
+		while (cache->bytes > cache->server->cache_bytes) {
+			auto oldest = cache->tiles.find(cache->lru.back());
+
+			cache->bytes -= oldest->second.first->size();
+			cache->tiles.erase(oldest);
+			cache->lru.pop_back();
+		}
+	}
+
+	cache->drawn.notify_all();
+
+	return bytes;
+}
+
+static void reply(int fd, const char *status, const char *type, const void *body,
+	size_t length)
+{
+	char header[256];
+
+	snprintf(header, sizeof(header), "HTTP/1.1 %s\r\nContent-Type: %s\r\n"
+		"Content-Length: %zu\r\nConnection: close\r\n\r\n", status, type, length);
+
+	if (!net_send_all(fd, header, strlen(header)))
+		net_send_all(fd, body, length);
+}
+
+static void reply_text(int fd, const char *status)
+{
+	reply(fd, status, "text/plain", status, strlen(status));
+}
+
+/* Answers one request and closes the connection. */
+static void serve_connection(struct tile_cache_s *cache, int fd)
+{
+	std::string request;
+	struct tile_key_s key;
+	tile_bytes bytes;
+	char buf[1024];
+	char path[256];
+	char method[16];
+	char tail[8];
+	ssize_t got;
+
+	while (request.find("\r\n\r\n") == std::string::npos && request.size() < MAX_REQUEST) {
+		got = recv(fd, buf, sizeof(buf), 0);
+		if (got < 0 && errno == EINTR)
+			continue;
+		if (got <= 0)
+			break;
+
+		request.append(buf, (size_t)got);
+	}
+
+	if (sscanf(request.c_str(), "%15s %255s", method, path) != 2) {
+		reply_text(fd, "400 Bad Request");
+	} else if (strcmp(method, "GET")) {
+		reply_text(fd, "405 Method Not Allowed");
+	} else if (!strcmp(path, "/")) {
+		reply(fd, "200 OK", "text/html", index_page, sizeof(index_page) - 1);
+	} else if (sscanf(path, "/%u/%llu/%llu%7s", &key.z, &key.x, &key.y, tail) != 4
+			|| strcmp(tail, ".bmp") || key.z > MAX_TILE_ZOOM
+			|| key.x >> key.z || key.y >> key.z) {
+		reply_text(fd, "404 Not Found");
+	} else if (!(bytes = get_tile(cache, &key))) {
+		reply_text(fd, "500 Internal Server Error");
+	} else {
+		reply(fd, "200 OK", "image/bmp", bytes->data(), bytes->size());
+	}
+
+	close(fd);
+
+	std::lock_guard<std::mutex> guard(cache->connections_lock);
+	cache->connections--;
+	cache->connection_done.notify_all();
+}
+
+int tile_serve(struct render_pool_s *pool, const struct tile_server_s *server)
+{
+	struct tile_cache_s cache;
+	int fd;
+	int client;
+
+	signal(SIGPIPE, SIG_IGN);
+
+	cache.server = server;
+	cache.pool = pool;
+	cache.bytes = 0;
+	cache.connections = 0;
+
+	if (server->dir && claim_tile_dir(server->dir, server->key))
+		return 1;
+
+	if ((fd = net_listen("Tile server", "127.0.0.1", server->port, 64)) < 0)
+		return 1;
+
+	printf("Serving tiles on http://127.0.0.1:%u/\n", (unsigned)server->port);
+	fflush(stdout);
+
+	/* One thread per connection, up to MAX_CONNECTIONS. Browsers keep only
+	 * a few open at a time, and they only wait for the cache or the pool
+	 * anyway. */
+	for (;;) {
+		{
+			std::unique_lock<std::mutex> guard(cache.connections_lock);
+
+			cache.connection_done.wait(guard,
+				[&] { return cache.connections < MAX_CONNECTIONS; });
+		}
+
+		if ((client = accept(fd, NULL, NULL)) < 0) {
+			if (errno == EINTR)
+				continue;
+			break;
+		}
+
+		std::lock_guard<std::mutex> guard(cache.connections_lock);
+		cache.connections++;
+		std::thread(serve_connection, &cache, client).detach();
+	}
+
+	perror("accept");
+	close(fd);
+
+	/* The threads still answering use the cache. */
+	std::unique_lock<std::mutex> guard(cache.connections_lock);
+	cache.connection_done.wait(guard, [&] { return !cache.connections; });
+
+	return 1;
+}
+
+#else
+
+int tile_serve(struct render_pool_s *pool, const struct tile_server_s *server)
+{
+	(void)pool;
+	(void)server;
+	(void)index_page;
+	fputs("The tile server is not supported on this platform\n", stderr);
+
+	return 1;
+}
+
+#endif
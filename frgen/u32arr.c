@@ -0,0 +1,220 @@
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include "mbitr.h"
+#include "u32arr.h"
+
+/* Below this many uint32_t's schoolbook multiplication is faster. */
+#define KARATSUBA_THRESHOLD	(32)
+
+size_t u32arr_trim(const uint32_t *arr, size_t len)
+{
+	while (len && !arr[len - 1])
+		len--;
+
+	return len;
+}
+
+int u32arr_cmp(const uint32_t *a, size_t a_len, const uint32_t *b, size_t b_len)
+{
+	size_t i;
+
+	a_len = u32arr_trim(a, a_len);
+	b_len = u32arr_trim(b, b_len);
+
+	if (a_len != b_len)
+		return (a_len > b_len) ? 1 : -1;
+
+	foreach_reverse_idx (i, a_len) {
+		if (a[i] != b[i])
+			return (a[i] > b[i]) ? 1 : -1;
+	}
+
+	return 0;
+}
+
+uint32_t u32arr_add(uint32_t *a, size_t a_len, const uint32_t *b, size_t b_len)
+{
+	uint64_t sum = 0;
+	size_t i;
+
+	for (i = 0; i < b_len; i++) {
+		sum += (uint64_t)a[i] + b[i];
+		a[i] = (uint32_t)sum;
+		sum >>= 32;
+	}
+
+	for (; sum && i < a_len; i++) {
+		sum += a[i];
+		a[i] = (uint32_t)sum;
+		sum >>= 32;
+	}
+
+	return (uint32_t)sum;
+}
+
+uint32_t u32arr_sub(uint32_t *a, size_t a_len, const uint32_t *b, size_t b_len)
+{
+	uint64_t diff;
+	uint64_t borrow = 0;
+	size_t i;
+
+	for (i = 0; i < b_len; i++) {
+		diff = (uint64_t)a[i] - b[i] - borrow;
+		a[i] = (uint32_t)diff;
+		borrow = (diff >> 32) & 1;
+	}
+
+	for (; borrow && i < a_len; i++) {
+		diff = (uint64_t)a[i] - borrow;
+		a[i] = (uint32_t)diff;
+		borrow = (diff >> 32) & 1;
+	}
+
+	return (uint32_t)borrow;
+}
+
+uint32_t u32arr_mul_u32(uint32_t *a, size_t len, uint32_t mul, uint32_t add)
+{
+	uint64_t acc;
+	size_t i;
+
+	acc = add;
+	for (i = 0; i < len; i++) {
+		acc += (uint64_t)a[i] * mul;
+		a[i] = (uint32_t)acc;
+		acc >>= 32;
+	}
+
+	return (uint32_t)acc;
+}
+
+uint32_t u32arr_div_u32(uint32_t *a, size_t len, uint32_t div)
+{
+	uint64_t rem = 0;
+	size_t i;
+
+	foreach_reverse_idx (i, len) {
+		rem = (rem << 32) | a[i];
+		a[i] = (uint32_t)(rem / div);
+		rem %= div;
+	}
+
+	return (uint32_t)rem;
+}
+
+static void mul_schoolbook(uint32_t *dest, const uint32_t *a, size_t a_len,
+		const uint32_t *b, size_t b_len)
+{
+	uint64_t acc;
+	size_t i;
+	size_t j;
+
+	memset(dest, 0, (a_len + b_len) * sizeof(dest[0]));
+
+	for (i = 0; i < a_len; i++) {
+		if (!a[i])
+			continue;
+		acc = 0;
+		for (j = 0; j < b_len; j++) {
+			acc += (uint64_t)a[i] * b[j] + dest[i + j];
+			dest[i + j] = (uint32_t)acc;
+			acc >>= 32;
+		}
+		dest[i + b_len] = (uint32_t)acc;
+	}
+}
+
+/* a is at least twice as long as b. Multiplies b with a piece of a of b's
+ * length at a time, so every piece is a balanced product. */
+static void mul_unbalanced(uint32_t *dest, const uint32_t *a, size_t a_len,
+		const uint32_t *b, size_t b_len)
+{
+	uint32_t *prod;
+	size_t offset;
+	size_t len;
+
+	memset(dest, 0, (a_len + b_len) * sizeof(dest[0]));
+	prod = malloc(2 * b_len * sizeof(prod[0]));
+
+	for (offset = 0; offset < a_len; offset += b_len) {
+		len = (a_len - offset < b_len) ? a_len - offset : b_len;
+		u32arr_mul(prod, a + offset, len, b, b_len);
+		u32arr_add(dest + offset, a_len + b_len - offset, prod, len + b_len);
+	}
+
+	free(prod);
+}
+
+/* a = a1 * B^m + a0
+ * b = b1 * B^m + b0
+ *
+ * a * b = a1b1 * B^2m + ((a0 + a1)(b0 + b1) - a0b0 - a1b1) * B^m + a0b0
+ *
+ * Three half length products instead of four. Expects b_len <= a_len <
+ * 2 * b_len, which keeps both halves of b non-empty. */
+static void mul_karatsuba(uint32_t *dest, const uint32_t *a, size_t a_len,
+		const uint32_t *b, size_t b_len)
+{
+	uint32_t *sum_a;
+	uint32_t *sum_b;
+	uint32_t *mid;
+	size_t m;
+	size_t sum_a_len;
+	size_t sum_b_len;
+	size_t mid_len;
+	size_t dest_len;
+
+	m = a_len / 2;
+	sum_a_len = a_len - m + 1;
+	sum_b_len = ((b_len - m > m) ? b_len - m : m) + 1;
+	mid_len = sum_a_len + sum_b_len;
+	dest_len = a_len + b_len;
+
+	sum_a = calloc(sum_a_len + sum_b_len + mid_len, sizeof(sum_a[0]));
+	sum_b = sum_a + sum_a_len;
+	mid = sum_b + sum_b_len;
+
+	u32arr_mul(dest, a, m, b, m);
+	u32arr_mul(dest + 2 * m, a + m, a_len - m, b + m, b_len - m);
+
+	memcpy(sum_a, a + m, (a_len - m) * sizeof(sum_a[0]));
+	u32arr_add(sum_a, sum_a_len, a, m);
+	memcpy(sum_b, b, m * sizeof(sum_b[0]));
+	u32arr_add(sum_b, sum_b_len, b + m, b_len - m);
+
+	u32arr_mul(mid, sum_a, u32arr_trim(sum_a, sum_a_len),
+			sum_b, u32arr_trim(sum_b, sum_b_len));
+	mid_len = u32arr_trim(mid, mid_len);
+	u32arr_sub(mid, mid_len, dest, u32arr_trim(dest, 2 * m));
+	u32arr_sub(mid, mid_len, dest + 2 * m, u32arr_trim(dest + 2 * m, dest_len - 2 * m));
+	mid_len = u32arr_trim(mid, mid_len);
+
+	u32arr_add(dest + m, dest_len - m, mid, mid_len);
+
+	free(sum_a);
+}
+
+void u32arr_mul(uint32_t *dest, const uint32_t *a, size_t a_len,
+		const uint32_t *b, size_t b_len)
+{
+	const uint32_t *tmp;
+	size_t tmp_len;
+
+	if (a_len < b_len) {
+		tmp = a;
+		a = b;
+		b = tmp;
+		tmp_len = a_len;
+		a_len = b_len;
+		b_len = tmp_len;
+	}
+
+	if (b_len < KARATSUBA_THRESHOLD) {
+		mul_schoolbook(dest, a, a_len, b, b_len);
+	} else if (a_len >= 2 * b_len) {
+		mul_unbalanced(dest, a, a_len, b, b_len);
+	} else {
+		mul_karatsuba(dest, a, a_len, b, b_len);
+	}
+}
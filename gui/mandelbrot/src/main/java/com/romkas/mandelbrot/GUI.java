@@ -4,11 +4,15 @@ import java.awt.Color;
 import java.awt.Graphics;
 import java.awt.Image;
 import java.awt.event.*;
-import java.io.File;
+import java.awt.image.BufferedImage;
+import java.io.BufferedInputStream;
+import java.io.DataInputStream;
+import java.io.EOFException;
 import java.io.IOException;
+import java.io.OutputStream;
+import java.nio.charset.StandardCharsets;
 import java.util.function.Consumer;
 
-import javax.imageio.ImageIO;
 import javax.swing.SwingUtilities;
 import javax.swing.event.MouseInputListener;
 
@@ -18,63 +22,100 @@ import javax.swing.event.MouseInputListener;
  */
 public class GUI extends javax.swing.JFrame
 {
-    private static class ImageGeneratorThread extends Thread
+    /**
+     * One frgen --serve process kept running for the whole session. Each
+     * request cancels the ones before it, and only the newest image is
+     * handed on.
+     */
+    private static class RenderServer extends Thread
     {
-        private int width;
-        private int height;
-        private int threads;
-        private int supersample;
-        private DoublePoint center;
-        private double diameter;
-        private String file;
+        private Process process;
+        private OutputStream requests;
+        private DataInputStream replies;
+        private long lastId = 0;
 
         Consumer<Image> onSuccess;
         Runnable onFailure;
 
-        public ImageGeneratorThread(int width, int height, DoublePoint center,
-                int threads, int ss, double diameter, String file,
+        public RenderServer(int threads, int ss,
                 Consumer<Image> onSuccess,
-                Runnable onFailure)
+                Runnable onFailure) throws IOException
         {
-            this.width = width;
-            this.height = height;
-            this.center = new DoublePoint(center.x, center.y);
-            this.diameter = diameter;
-            this.supersample = ss;
-            this.file = file;
-            this.threads = threads;
+            String[] args = new String[] {
+                "frgen", "--serve", "--incremental",
+                    "-t", Integer.toString(threads),
+                    "-s", Integer.toString(ss)
+            };
+
+            this.process = new ProcessBuilder(args)
+                .redirectError(ProcessBuilder.Redirect.INHERIT)
+                .start();
+            this.requests = process.getOutputStream();
+            this.replies = new DataInputStream(
+                    new BufferedInputStream(process.getInputStream()));
 
             this.onSuccess = onSuccess;
             this.onFailure = onFailure;
+            setDaemon(true);
+        }
+
+        public synchronized void request(int width, int height,
+                DoublePoint center, double diameter) throws IOException
+        {
+            lastId++;
+            String line = lastId + " " + width + " " + height + " "
+                + Double.toString(center.x) + " "
+                + Double.toString(center.y) + " "
+                + Double.toString(diameter) + "\n";
+            requests.write(line.getBytes(StandardCharsets.US_ASCII));
+            requests.flush();
+        }
+
+        private synchronized boolean isLatest(long id)
+        {
+            return id == lastId;
+        }
+
+        private String readLine() throws IOException
+        {
+            StringBuilder line = new StringBuilder();
+            int c;
+
+            while ((c = replies.read()) != '\n') {
+                if (c < 0)
+                    throw new EOFException("frgen --serve exited");
+                line.append((char)c);
+            }
+            return line.toString();
         }
 
         public void run()
         {
-            String[] args = new String[] {
-                "mandelbrot",
-                    "-t", Integer.toString(threads),
-                    "-f", file,
-                    "-w", Integer.toString(width),
-                    "-h", Integer.toString(height),
-                    "-x", Double.toString(center.x),
-                    "-y", Double.toString(center.y),
-                    "-r", Double.toString(diameter),
-                    "-s", Integer.toString(supersample)
-            };
             try {
-                Process p = Runtime.getRuntime().exec(args);
                 while (true) {
-                    try {
-                        p.waitFor();
-                        break;
-                    } catch (InterruptedException ex) {
-                        if (!p.isAlive())
-                            break;
+                    String[] reply = readLine().split(" ");
+                    if (reply.length != 3)
+                        continue;
+
+                    int width = Integer.parseInt(reply[1]);
+                    int height = Integer.parseInt(reply[2]);
+                    byte[] rgb = new byte[width * height * 3];
+                    replies.readFully(rgb);
+
+                    if (!isLatest(Long.parseLong(reply[0])))
+                        continue;
+
+                    BufferedImage img = new BufferedImage(width, height,
+                            BufferedImage.TYPE_INT_RGB);
+                    for (int i = 0; i < width * height; i++) {
+                        img.setRGB(i % width, i / width,
+                                (rgb[3 * i] & 0xff) << 16
+                                | (rgb[3 * i + 1] & 0xff) << 8
+                                | (rgb[3 * i + 2] & 0xff));
                     }
+                    onSuccess.accept(img);
                 }
-                Image img = ImageIO.read(new File(file));
-                onSuccess.accept(img);
-            } catch (IOException ex) {
+            } catch (IOException | NumberFormatException ex) {
                 System.err.println(ex.getMessage());
                 onFailure.run();
             }
@@ -89,8 +130,7 @@ public class GUI extends javax.swing.JFrame
     private DoublePoint center = new DoublePoint(0.0, 0.0);
     private double diameter = 1.5;
     private int threadCount = Runtime.getRuntime().availableProcessors();
-    private String bitmapFile = "./__bitmap.bmp";
-    private boolean drawingImage = false;
+    private RenderServer server = null;
 
     // Variables declaration - do not modify//GEN-BEGIN:variables
     private java.awt.Canvas canvas1;
@@ -135,6 +175,15 @@ public class GUI extends javax.swing.JFrame
             }
         });
 
+        canvas1.addKeyListener(new KeyAdapter()
+        {
+            @Override
+            public void keyPressed(KeyEvent evt)
+            {
+                canvasKeyPressed(evt);
+            }
+        });
+
         canvas1.addComponentListener(new ComponentListener()
         {
             @Override
@@ -171,50 +220,103 @@ public class GUI extends javax.swing.JFrame
         drawImage();
     }// </editor-fold>//GEN-END:initComponents
 
-    private void drawImage()
+    private void startServer()
     {
-        if (drawingImage) {
-            return;
-        }
-        drawingImage = true;
-        new ImageGeneratorThread(
-            canvas1.getWidth(), canvas1.getHeight(), new DoublePoint(center.x, center.y),
-            threadCount, supersampleLevel, diameter, bitmapFile,
-            (Image img) ->
-            {
-                SwingUtilities.invokeLater(() ->
+        try {
+            server = new RenderServer(threadCount, supersampleLevel,
+                (Image img) ->
                 {
-                    canvas1.setSize(img.getWidth(null), img.getHeight(null));
-                    Graphics g = canvas1.getGraphics();
-                    g.drawImage(img, 0, 0, null);
-                    drawingImage = false;
-                });
-            },
-            () ->
-            {
-                SwingUtilities.invokeLater(() ->
+                    SwingUtilities.invokeLater(() ->
+                    {
+                        Graphics g = canvas1.getGraphics();
+                        g.drawImage(img, 0, 0, null);
+                    });
+                },
+                () ->
                 {
-                    Graphics g = canvas1.getGraphics();
-                    g.drawString("FUCK", 0, 0);
-                    SwingUtilities.invokeLater(() -> {
-                        System.exit(1);
+                    SwingUtilities.invokeLater(() ->
+                    {
+                        Graphics g = canvas1.getGraphics();
+                        g.drawString("FUCK", 0, 0);
+                        SwingUtilities.invokeLater(() -> {
+                            System.exit(1);
+                        });
                     });
-                });
-            }
-        ).start();
+                }
+            );
+            server.start();
+        } catch (IOException ex) {
+            System.err.println(ex.getMessage());
+            System.exit(1);
+        }
     }
 
-    private void canvasMousePressed(MouseEvent evt)
+    private void drawImage()
     {
-        if (drawingImage) {
+        if (canvas1.getWidth() <= 0 || canvas1.getHeight() <= 0) {
             return;
         }
+        if (server == null) {
+            startServer();
+        }
+        try {
+            server.request(canvas1.getWidth(), canvas1.getHeight(),
+                new DoublePoint(center.x, center.y), diameter);
+        } catch (IOException ex) {
+            System.err.println(ex.getMessage());
+            System.exit(1);
+        }
+    }
+
+    /**
+     * Arrow keys pan by an eighth of the view and + and - zoom by 2, in
+     * whole pixels, so that frgen only draws what was not on screen yet.
+     */
+    private void canvasKeyPressed(KeyEvent evt)
+    {
+        double pixelWidth = diameter
+            / Math.min(canvas1.getHeight(), canvas1.getWidth());
+        int dx = canvas1.getWidth() / 8;
+        int dy = canvas1.getHeight() / 8;
+
+        switch (evt.getKeyCode()) {
+        case KeyEvent.VK_LEFT:
+            center = new DoublePoint(center.x - dx * pixelWidth, center.y);
+            break;
+        case KeyEvent.VK_RIGHT:
+            center = new DoublePoint(center.x + dx * pixelWidth, center.y);
+            break;
+        case KeyEvent.VK_UP:
+            center = new DoublePoint(center.x, center.y + dy * pixelWidth);
+            break;
+        case KeyEvent.VK_DOWN:
+            center = new DoublePoint(center.x, center.y - dy * pixelWidth);
+            break;
+        case KeyEvent.VK_PLUS:
+        case KeyEvent.VK_ADD:
+        case KeyEvent.VK_EQUALS:
+            diameter /= 2;
+            break;
+        case KeyEvent.VK_MINUS:
+        case KeyEvent.VK_SUBTRACT:
+            diameter *= 2;
+            break;
+        default:
+            return;
+        }
+
+        drawImage();
+    }
+
+    private void canvasMousePressed(MouseEvent evt)
+    {
+        canvas1.requestFocusInWindow();
         firstClickPoint = new IntPoint(evt.getX(), evt.getY());
     }
 
     private void canvasMouseReleased(MouseEvent evt)
     {
-        if (drawingImage) {
+        if (firstClickPoint == null) {
             return;
         }
 
@@ -0,0 +1,53 @@
+#ifndef MANDELBROT_ANIMATE_H
+#define MANDELBROT_ANIMATE_H
+
+#include "render.h"
+#include "expmap.h"
+#include "stream.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* A camera path and everything needed to draw it. Zoom z stands for a radius
+ * of 10^-z. */
+struct animation_s {
+	/* File of "<frame> <x> <y> <zoom>" lines, or NULL to zoom from zoom_from
+	 * to zoom_to at (x, y) over frames frames. */
+	const char *keyframes;
+	unsigned long frames;
+	const char *x;
+	const char *y;
+	double zoom_from;
+	double zoom_to;
+
+	/* How much of each stretch between keyframes is spent speeding up and
+	 * slowing down. 0 moves at a constant speed. */
+	double smoothing;
+
+	/* Resample every frame from one exponential map of the centre instead of
+	 * drawing it. The centre must stay put. */
+	int exp_map;
+
+	/* Draw every refresh-th frame in full if frame.reuse is set, never if 0. */
+	unsigned long refresh;
+
+	/* Output file name with a %u in place of the frame number. Ignored if
+	 * frames go to stream instead. */
+	const char *path;
+	const struct frame_stream_s *stream;
+	uint16_t width;
+	uint16_t height;
+	uint16_t supersample_level;
+
+	/* Everything but the viewport and the image. */
+	struct render_frame_s frame;
+};
+
+int animate(struct render_pool_s *pool, const struct animation_s *anim);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* MANDELBROT_ANIMATE_H */
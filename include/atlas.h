@@ -0,0 +1,37 @@
+#ifndef MANDELBROT_ATLAS_H
+#define MANDELBROT_ATLAS_H
+
+#include "render.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Julia sets handed to the sweep function at a time. */
+#define ATLAS_BATCH	(16)
+
+/* A grid of cols x rows Julia sets, one for each constant c on a grid over
+ * the viewport of frame as render_frame would lay its samples out, with
+ * smaller imaginary parts further down. Each set is drawn thumb pixels a
+ * side over a square of side julia_r around 0, laid out as render_frame
+ * would, and coloured with the renderer of frame. Batches of sets are tasks on the pool, and the sweep
+ * function works on all constants of a batch at once. */
+struct atlas_s {
+	const char *path;
+	unsigned cols;
+	unsigned rows;
+	uint16_t thumb;
+	uint16_t supersample_level;
+	double julia_r;
+	sweep_fn sweep;
+	struct render_frame_s frame;
+};
+
+/* Returns non-zero if the atlas is too large or cannot be written. */
+int atlas(struct render_pool_s *pool, const struct atlas_s *at);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* MANDELBROT_ATLAS_H */
@@ -8,29 +8,71 @@
 extern "C" {
 #endif
 
-/* Fixed point unsigned number. */
+/* Signed fixed point number in sign-magnitude form.
+ *
+ * The magnitude is kept in a little-endian big_int of constant length. The
+ * most significant binp uint32_t's hold the integral part and the rest hold
+ * the fraction, so the value is
+ *
+ *	(-1)^neg * i * 2^(-32 * (i.arr.len - binp))
+ *
+ * Unlike big_int, a big_fixed never changes its size. Results that do not fit
+ * are truncated to the format of the number being modified. */
 struct big_fixed {
-	struct big_int i;	/* Underlying integer. */
+	struct big_int i;	/* Magnitude. */
 	size_t binp;		/* Binary point. Number of integral uint32_t's.
 				   Always less than i->arr.len. */
+	int neg;		/* Non-zero if negative. Zero is never negative. */
 };
 
-static inline void bf_init(struct big_fixed *f, size_t integral, size_t frac)
+static inline size_t bf_frac_u32s(const struct big_fixed *f)
 {
-	bi_init(&f->i, integral + frac, 0);
+	return f->i.arr.len - f->binp;
 }
 
-static inline void bf_init_u64(struct big_fixed *f, size_t integral, size_t frac, uint64_t init)
-{
-	f->binp = integral;
-	bi_init_u64(&f->i, init, (int32_t)frac);
-}
+/* Initialises f to zero. */
+void bf_init(struct big_fixed *f, size_t integral, size_t frac);
+void bf_init_u64(struct big_fixed *f, size_t integral, size_t frac, uint64_t init);
+void bf_init_d(struct big_fixed *f, size_t integral, size_t frac, double init);
+
+/* Parses a decimal number of the form [+-]digits[.digits][e[+-]digits].
+ * Returns 0 on success. f is initialised even if parsing fails. Digits past
+ * the precision of f are rounded down. */
+int bf_init_from_str(struct big_fixed *f, size_t integral, size_t frac, const char *str);
+
+/* Number of fractional uint32_t's needed to hold every digit of a decimal
+ * number accepted by bf_init_from_str(). */
+size_t bf_str_frac_u32s(const char *str);
+
+/* Returns f as a decimal string with at most digits fractional digits.
+ * Trailing zeroes are dropped. Zero digits means as many as f can tell
+ * apart. */
+char * bf_tostr(const struct big_fixed *f, size_t digits);
 
+void bf_destroy(struct big_fixed *f);
+
+/* Copies value of f2 into f1 keeping the format of f1. */
+void bf_set(struct big_fixed *f1, const struct big_fixed *f2);
+void bf_set_d(struct big_fixed *f, double val);
+
+double bf_to_d(const struct big_fixed *f);
+int bf_is_zero(const struct big_fixed *f);
+
+void bf_neg_i(struct big_fixed *f);
 void bf_add_i(struct big_fixed *f1, const struct big_fixed *f2);
 void bf_sub_i(struct big_fixed *f1, const struct big_fixed *f2);
 void bf_mul_i(struct big_fixed *f1, const struct big_fixed *f2);
+void bf_mul_u32_i(struct big_fixed *f, uint32_t mul);
+void bf_div_u32_i(struct big_fixed *f, uint32_t div);
+
+/* Writes f as a two's complement number of length u32s of which frac are
+ * fractional into every stride'th element of dest. Bits that do not fit are
+ * dropped. */
+void bf_to_twos_u32(const struct big_fixed *f, uint32_t *dest, size_t u32s,
+		size_t frac, size_t stride);
 
 int bf_cmp(const struct big_fixed *f1, const struct big_fixed *f2);
+int bf_cmp_abs(const struct big_fixed *f1, const struct big_fixed *f2);
 
 #ifdef __cplusplus
 }
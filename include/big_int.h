@@ -10,6 +10,7 @@ extern "C" {
 #endif
 
 #define MB_MAX(_a, _b) (((_a) > (_b)) ? (_a) : (_b))
+#define MB_MIN(_a, _b) (((_a) < (_b)) ? (_a) : (_b))
 
 /* Represents a little-endian unsigned big integer. No such thing as overflow
  * when adding and multiplying. Underflow results in 0.
@@ -40,7 +41,7 @@ static inline struct big_int * bi_new_s(size_t size, uint32_t init, size_t shift
 {
 	struct big_int *ret;
 
-	ret = malloc(sizeof(*ret));
+	ret = (struct big_int *)malloc(sizeof(*ret));
 	bi_init_s(ret, size, init, shift);
 
 	return ret;
@@ -50,7 +51,7 @@ static inline struct big_int * bi_new_u64(size_t size, uint64_t init, size_t shi
 {
 	struct big_int *ret;
 
-	ret = malloc(sizeof(*ret));
+	ret = (struct big_int *)malloc(sizeof(*ret));
 	bi_init_u64_s(ret, size, init, shift);
 
 	return ret;
@@ -60,7 +61,7 @@ static inline struct big_int * bi_new_from_u32arr(size_t size, const uint32_t *i
 {
 	struct big_int *ret;
 
-	ret = malloc(sizeof(*ret));
+	ret = (struct big_int *)malloc(sizeof(*ret));
 	bi_init_from_u32arr(ret, size, init, length);
 
 	return ret;
@@ -70,7 +71,7 @@ static inline struct big_int * bi_new_from_str(size_t size, const char *str, int
 {
 	struct big_int *ret;
 
-	ret = malloc(sizeof(*ret));
+	ret = (struct big_int *)malloc(sizeof(*ret));
 	bi_init_from_str(ret, size, str, radix);
 	if (ret->arr.buf == NULL)
 		return NULL;
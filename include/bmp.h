@@ -78,6 +78,10 @@ static inline void bmp_set_b(struct bmp_img *img, uint16_t x, uint16_t y, unsign
 struct bmp_img * bmp_new(uint16_t width, uint16_t height);
 void bmp_delete(struct bmp_img *img);
 struct bmp_img * bmp_downsample(const struct bmp_img *img, unsigned level);
+
+/* Mean of the width x height pixels from (x, y) on. */
+struct pixel bmp_average_area(const struct bmp_img *img,
+		uint16_t x, uint16_t y, uint16_t width, uint16_t height);
 enum bmp_error bmp_write_f(const struct bmp_img *img, FILE *f);
 const char * bmp_strerror(enum bmp_error error);
 
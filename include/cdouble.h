@@ -30,6 +30,26 @@ static inline struct cdouble cd_add(struct cdouble d1, struct cdouble d2)
 	return ret;
 }
 
+static inline struct cdouble cd_sub(struct cdouble d1, struct cdouble d2)
+{
+	struct cdouble ret;
+
+	ret.real = d1.real - d2.real;
+	ret.img = d1.img - d2.img;
+
+	return ret;
+}
+
+static inline struct cdouble cd_mul_real(struct cdouble d, double val)
+{
+	struct cdouble ret;
+
+	ret.real = d.real * val;
+	ret.img = d.img * val;
+
+	return ret;
+}
+
 static inline struct cdouble cd_add_real(struct cdouble d, double val)
 {
 	struct cdouble ret;
@@ -72,6 +92,19 @@ static inline double cd_magnitude_pow4(struct cdouble d)
 	return cd_magnitude_sqr(cd_sqr(d));
 }
 
+/* d1 / d2 = d1 * conj(d2) / |d2|^2 */
+static inline struct cdouble cd_div(struct cdouble d1, struct cdouble d2)
+{
+	struct cdouble ret;
+	double den;
+
+	den = cd_magnitude_sqr(d2);
+	ret.real = (d1.real * d2.real + d1.img * d2.img) / den;
+	ret.img = (d1.img * d2.real - d1.real * d2.img) / den;
+
+	return ret;
+}
+
 #ifdef __cplusplus
 }
 #endif
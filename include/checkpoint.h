@@ -0,0 +1,51 @@
+#ifndef MANDELBROT_CHECKPOINT_H
+#define MANDELBROT_CHECKPOINT_H
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Log of the tiles of a frame counted so far, appended to as tiles are done
+ * so that a render that dies can pick up where it left off. */
+struct render_checkpoint_s;
+
+/* A tile of the frame, in samples from the bottom left. */
+struct checkpoint_tile_s {
+	size_t line;
+	size_t col;
+	size_t rows;
+	size_t cols;
+};
+
+/* Opens the log at path for the render described by key. With resume, the
+ * tiles already in a log of the same key are read back by checkpoint_read,
+ * otherwise the log starts empty and must not exist yet. Returns NULL if the
+ * log can't be written, is of another render or exists without resume. */
+struct render_checkpoint_s * checkpoint_open(const char *path, const char *key, int resume);
+
+/* Tiles there are to read back, as of checkpoint_open. */
+size_t checkpoint_restored(const struct render_checkpoint_s *ckpt);
+
+/* Reads the next tile of the log. Its counts, and distances if it has them
+ * or NULL, stay valid until the next call. Returns 0 once there are no more,
+ * after which the log is only appended to. */
+int checkpoint_read(struct render_checkpoint_s *ckpt, struct checkpoint_tile_s *tile,
+	const unsigned **iterations, const float **distance);
+
+/* Logs a tile, its counts and its distances if distance is not NULL, all of
+ * them rows * cols long. Any thread may call it. Returns non-zero if the
+ * record can't be written, after which the log keeps the tiles before it and
+ * takes no more. */
+int checkpoint_append(struct render_checkpoint_s *ckpt, const struct checkpoint_tile_s *tile,
+	const unsigned *iterations, const float *distance);
+
+/* Closes the log, and removes it if the render is finished. */
+void checkpoint_close(struct render_checkpoint_s *ckpt, int finished);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* MANDELBROT_CHECKPOINT_H */
@@ -0,0 +1,172 @@
+#ifndef MANDELBROT_DDOUBLE_H
+#define MANDELBROT_DDOUBLE_H
+
+#include <math.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Double-double number. The value is hi + lo where |lo| <= ulp(hi) / 2, which
+ * gives about 106 bits of mantissa with the exponent range of a double.
+ *
+ * Everything is built from error-free transformations that depend on strict
+ * IEEE double rounding. Do not compile users of this with -ffast-math. */
+struct ddouble {
+	double hi;
+	double lo;
+};
+
+/* a + b = s + e exactly. */
+static inline double dd_two_sum(double a, double b, double *e)
+{
+	double s;
+	double bb;
+
+	s = a + b;
+	bb = s - a;
+	*e = (a - (s - bb)) + (b - bb);
+
+	return s;
+}
+
+/* Same as dd_two_sum(), but only valid if |a| >= |b|. */
+static inline double dd_quick_two_sum(double a, double b, double *e)
+{
+	double s;
+
+	s = a + b;
+	*e = b - (s - a);
+
+	return s;
+}
+
+/* a * b = p + e exactly. A fused multiply-add yields the error directly. Where
+ * it is not done in hardware, fma() is a slow library call, so Dekker's
+ * splitting into 26 bit halves is used instead. */
+static inline double dd_two_prod(double a, double b, double *e)
+{
+	double p;
+#ifndef FP_FAST_FMA
+	double t;
+	double a_hi;
+	double a_lo;
+	double b_hi;
+	double b_lo;
+#endif
+
+	p = a * b;
+#ifdef FP_FAST_FMA
+	*e = fma(a, b, -p);
+#else
+	t = 134217729.0 * a;
+	a_hi = t - (t - a);
+	a_lo = a - a_hi;
+	t = 134217729.0 * b;
+	b_hi = t - (t - b);
+	b_lo = b - b_hi;
+	*e = ((a_hi * b_hi - p) + a_hi * b_lo + a_lo * b_hi) + a_lo * b_lo;
+#endif
+
+	return p;
+}
+
+static inline struct ddouble dd_from_d(double d)
+{
+	struct ddouble ret;
+
+	ret.hi = d;
+	ret.lo = 0.0;
+
+	return ret;
+}
+
+static inline double dd_to_d(struct ddouble d)
+{
+	return d.hi + d.lo;
+}
+
+static inline struct ddouble dd_neg(struct ddouble d)
+{
+	d.hi = -d.hi;
+	d.lo = -d.lo;
+
+	return d;
+}
+
+static inline struct ddouble dd_add(struct ddouble a, struct ddouble b)
+{
+	struct ddouble ret;
+	double s;
+	double e;
+	double t;
+	double f;
+
+	s = dd_two_sum(a.hi, b.hi, &e);
+	t = dd_two_sum(a.lo, b.lo, &f);
+	e += t;
+	s = dd_quick_two_sum(s, e, &e);
+	e += f;
+	ret.hi = dd_quick_two_sum(s, e, &ret.lo);
+
+	return ret;
+}
+
+static inline struct ddouble dd_sub(struct ddouble a, struct ddouble b)
+{
+	return dd_add(a, dd_neg(b));
+}
+
+static inline struct ddouble dd_mul(struct ddouble a, struct ddouble b)
+{
+	struct ddouble ret;
+	double p;
+	double e;
+
+	p = dd_two_prod(a.hi, b.hi, &e);
+	e += a.hi * b.lo + a.lo * b.hi;
+	ret.hi = dd_quick_two_sum(p, e, &ret.lo);
+
+	return ret;
+}
+
+static inline struct ddouble dd_mul_d(struct ddouble a, double b)
+{
+	struct ddouble ret;
+	double p;
+	double e;
+
+	p = dd_two_prod(a.hi, b, &e);
+	e += a.lo * b;
+	ret.hi = dd_quick_two_sum(p, e, &ret.lo);
+
+	return ret;
+}
+
+static inline struct ddouble dd_sqr(struct ddouble a)
+{
+	struct ddouble ret;
+	double p;
+	double e;
+
+	p = dd_two_prod(a.hi, a.hi, &e);
+	e += 2.0 * a.hi * a.lo;
+	ret.hi = dd_quick_two_sum(p, e, &ret.lo);
+
+	return ret;
+}
+
+/* Exact as long as nothing overflows or goes subnormal. */
+static inline struct ddouble dd_mul_pow2(struct ddouble a, double pow2)
+{
+	a.hi *= pow2;
+	a.lo *= pow2;
+
+	return a;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* MANDELBROT_DDOUBLE_H */
@@ -0,0 +1,45 @@
+#ifndef MANDELBROT_DECIMAL_H
+#define MANDELBROT_DECIMAL_H
+
+#include <stdlib.h>
+#include <stdint.h>
+#include "mbarray.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Divide and conquer conversion between decimal digit strings and uint32_t
+ * arrays. Strings are split at 9 * 2^j digits, so every level multiplies or
+ * divides by a power of ten that is squared from the one below. Together with
+ * Karatsuba multiplication that makes the conversions subquadratic. Division
+ * is replaced by multiplication with a truncated reciprocal followed by a
+ * small correction.
+ *
+ * Digit strings hold nothing but '0'..'9'. */
+
+/* Parses len digits into a new array of at least one uint32_t. */
+struct mb_array_u32 dec_parse_int(const char *digits, size_t len);
+
+/* Sets the u32s uint32_t fraction in dest to 0.<digits>, rounded down. */
+void dec_parse_frac(uint32_t *dest, size_t u32s, const char *digits, size_t len);
+
+/* Returns a decimal string of n without leading zeroes. */
+char * dec_format_int(const uint32_t *n, size_t len);
+
+/* Returns the first digits decimal digits of the u32s uint32_t fraction
+ * frac. */
+char * dec_format_frac(const uint32_t *frac, size_t u32s, size_t digits);
+
+/* Number of decimal digits needed to tell apart all values of a u32s long
+ * fraction. */
+size_t dec_frac_digits(size_t u32s);
+
+/* Number of uint32_t's of fraction needed to hold digits decimal digits. */
+size_t dec_frac_u32s(size_t digits);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* MANDELBROT_DECIMAL_H */
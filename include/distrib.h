@@ -0,0 +1,56 @@
+#ifndef MANDELBROT_DISTRIB_H
+#define MANDELBROT_DISTRIB_H
+
+#include <stdio.h>
+
+#include "render.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Side of the tiles an image is split into, in pixels. Workers are handed
+ * runs of them along a row, longer the faster the worker. */
+#define DISTRIB_TILE	(128)
+
+/* Draws one image on workers that connect over TCP and writes it to path.
+ * Workers get the arguments of this frgen and draw what it would, so only
+ * listen on an address that nobody but trusted workers can reach. */
+struct coordinator_s {
+	const char *host;
+	unsigned short port;
+	const char *path;
+	uint16_t width;
+	uint16_t height;
+	int argc;
+	char **argv;
+};
+
+int coordinate(const struct coordinator_s *coord);
+
+/* Draws the tiles a coordinator hands out, on the pool. */
+struct worker_s {
+	int fd;
+	FILE *in;
+
+	/* The arguments of the worker followed by those of the job. */
+	int argc;
+	char **argv;
+
+	uint16_t width;
+	uint16_t height;
+	uint16_t supersample_level;
+	struct render_frame_s frame;
+};
+
+/* Connects to the coordinator at address, as host:port, and fills in argc
+ * and argv. */
+int worker_connect(struct worker_s *worker, const char *address, int argc, char **argv);
+int work(struct render_pool_s *pool, const struct worker_s *worker);
+void worker_close(struct worker_s *worker);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* MANDELBROT_DISTRIB_H */
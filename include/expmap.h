@@ -0,0 +1,45 @@
+#ifndef MANDELBROT_EXPMAP_H
+#define MANDELBROT_EXPMAP_H
+
+#include "render.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Exponential map of the neighbourhood of a point: row i holds the samples at
+ * angle -pi + i * dr, column j those at distance e^(log_outer - j * dr) from
+ * it. Every frame of a zoom into the point is a resampling of it. */
+struct expmap_s {
+	struct pixel *strip;
+	size_t rows;
+	size_t cols;
+	double log_outer;
+	double dr;
+
+	/* Natural logarithm of each frame pixel's distance from the centre, in
+	 * pixels, and its angle, both divided by dr. */
+	float *pixel_log;
+	float *pixel_angle;
+	uint16_t width;
+	uint16_t height;
+};
+
+/* Draws the map for width x height frames centred at frame->org with radii
+ * between r_inner and r_outer. Samples are counted by frame->points, in double
+ * precision. Returns non-zero if the iterator takes no points or the
+ * frames go deeper than that. */
+int expmap_init(struct expmap_s *map, struct render_pool_s *pool,
+	const struct render_frame_s *frame, double r_outer, double r_inner,
+	uint16_t width, uint16_t height);
+void expmap_destroy(struct expmap_s *map);
+
+/* Fills img in with the frame of radius r. */
+void expmap_frame(const struct expmap_s *map, struct render_pool_s *pool,
+	struct bmp_img *img, double r);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* MANDELBROT_EXPMAP_H */
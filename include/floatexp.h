@@ -0,0 +1,161 @@
+#ifndef MANDELBROT_FLOATEXP_H
+#define MANDELBROT_FLOATEXP_H
+
+#include <stdint.h>
+#include <string.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Double with a separate 64 bit exponent. The value is m * 2^e where
+ * 1 <= |m| < 2, or m = 0 and e = FE_ZERO_EXP. The exponent of the double
+ * itself is always zero, so it neither overflows nor underflows.
+ *
+ * Normalisation works on the bits of m rather than calling frexp()/ldexp(),
+ * which keeps every function here free of branches and calls so that loops
+ * over arrays of these vectorise. Subnormal results are flushed to zero. */
+struct floatexp {
+	double m;
+	int64_t e;
+};
+
+struct cfloatexp {
+	struct floatexp real;
+	struct floatexp img;
+};
+
+#define FE_ZERO_EXP		(-(INT64_C(1) << 60))
+#define FE_EXP_MASK		(UINT64_C(0x7FF) << 52)
+#define FE_EXP_BIAS		(1023)
+
+static inline uint64_t fe_d_bits(double d)
+{
+	uint64_t ret;
+
+	memcpy(&ret, &d, sizeof(ret));
+
+	return ret;
+}
+
+static inline double fe_bits_d(uint64_t bits)
+{
+	double ret;
+
+	memcpy(&ret, &bits, sizeof(ret));
+
+	return ret;
+}
+
+/* 2^k. Zero below the normal range and infinity above it. */
+static inline double fe_pow2(int64_t k)
+{
+	k = (k < -FE_EXP_BIAS) ? -FE_EXP_BIAS : k;
+	k = (k > FE_EXP_BIAS + 1) ? FE_EXP_BIAS + 1 : k;
+
+	return fe_bits_d((uint64_t)(k + FE_EXP_BIAS) << 52);
+}
+
+/* m * 2^e in normal form. */
+static inline struct floatexp fe_norm(double m, int64_t e)
+{
+	struct floatexp ret;
+	uint64_t bits;
+	int64_t biased;
+
+	bits = fe_d_bits(m);
+	biased = (int64_t)((bits & FE_EXP_MASK) >> 52);
+	bits = (bits & ~FE_EXP_MASK) | ((uint64_t)FE_EXP_BIAS << 52);
+
+	ret.m = biased ? fe_bits_d(bits) : 0.0;
+	ret.e = biased ? e + biased - FE_EXP_BIAS : FE_ZERO_EXP;
+
+	return ret;
+}
+
+static inline struct floatexp fe_from_d(double d)
+{
+	return fe_norm(d, 0);
+}
+
+static inline double fe_to_d(struct floatexp f)
+{
+	return f.m * fe_pow2(f.e);
+}
+
+static inline struct floatexp fe_neg(struct floatexp f)
+{
+	f.m = -f.m;
+
+	return f;
+}
+
+/* Both operands are scaled to the larger exponent, so the smaller one simply
+ * vanishes if it is more than a double's worth of bits below. */
+static inline struct floatexp fe_add(struct floatexp a, struct floatexp b)
+{
+	int64_t e;
+
+	e = (a.e > b.e) ? a.e : b.e;
+
+	return fe_norm(a.m * fe_pow2(a.e - e) + b.m * fe_pow2(b.e - e), e);
+}
+
+static inline struct floatexp fe_sub(struct floatexp a, struct floatexp b)
+{
+	return fe_add(a, fe_neg(b));
+}
+
+static inline struct floatexp fe_mul(struct floatexp a, struct floatexp b)
+{
+	return fe_norm(a.m * b.m, a.e + b.e);
+}
+
+static inline struct floatexp fe_mul_d(struct floatexp a, double d)
+{
+	return fe_mul(a, fe_from_d(d));
+}
+
+static inline struct floatexp fe_mul_pow2(struct floatexp a, int64_t k)
+{
+	a.e += a.m != 0.0 ? k : 0;
+
+	return a;
+}
+
+static inline struct cfloatexp cfe_add(struct cfloatexp a, struct cfloatexp b)
+{
+	struct cfloatexp ret;
+
+	ret.real = fe_add(a.real, b.real);
+	ret.img = fe_add(a.img, b.img);
+
+	return ret;
+}
+
+static inline struct cfloatexp cfe_mul(struct cfloatexp a, struct cfloatexp b)
+{
+	struct cfloatexp ret;
+
+	ret.real = fe_sub(fe_mul(a.real, b.real), fe_mul(a.img, b.img));
+	ret.img = fe_add(fe_mul(a.real, b.img), fe_mul(a.img, b.real));
+
+	return ret;
+}
+
+/* (a + bi)^2 = (a^2 - b^2) + 2abi */
+static inline struct cfloatexp cfe_sqr(struct cfloatexp a)
+{
+	struct cfloatexp ret;
+
+	ret.real = fe_sub(fe_mul(a.real, a.real), fe_mul(a.img, a.img));
+	ret.img = fe_mul_pow2(fe_mul(a.real, a.img), 1);
+
+	return ret;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* MANDELBROT_FLOATEXP_H */
@@ -0,0 +1,24 @@
+#ifndef FRACTALGEN_LOCK_H
+#define FRACTALGEN_LOCK_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* A mutex for plugins that keep state between requests, which hosts make from
+ * many threads at once. C11 threads are missing from some C libraries, so
+ * this wraps the one of C++. */
+struct frg_lock_s;
+
+/* Made once, from frg_module_init, and kept for as long as the plugin is
+ * loaded. */
+struct frg_lock_s * frg_lock_new(void);
+
+void frg_lock(struct frg_lock_s *lock);
+void frg_unlock(struct frg_lock_s *lock);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* FRACTALGEN_LOCK_H */
@@ -17,6 +17,7 @@ union value_u {
 struct value_s {
 	char *name;
 	union value_u val;
+	char *text;	/* Value as it was given. NULL if type is VALUE_NONE. */
 	int type;
 };
 
@@ -28,6 +29,8 @@ struct frg_param_set_s {
 int param_set_get_double(const struct frg_param_set_s *set, const char *name, double *val);
 int param_set_value_exists(const struct frg_param_set_s *set, const char *name);
 double param_set_get_double_d(const struct frg_param_set_s *set, const char *name, double default_val);
+int param_set_get_str(const struct frg_param_set_s *set, const char *name, const char **val);
+const char * param_set_get_str_d(const struct frg_param_set_s *set, const char *name, const char *default_val);
 
 #ifdef __cplusplus
 }
@@ -1,6 +1,7 @@
 #ifndef MANDELBROT_FRACTAL_ITERATOR_H
 #define MANDELBROT_FRACTAL_ITERATOR_H
 
+#include <stdint.h>
 #include <gramas/ptr_array.h>
 
 #include "bmp.h"
@@ -10,6 +11,8 @@
 extern "C" {
 #endif
 
+struct big_fixed;
+
 struct frg_iteration_request_s {
 	unsigned short rows;
 	unsigned short cols;
@@ -17,6 +20,25 @@ struct frg_iteration_request_s {
 	double from_x;
 	double from_y;
 	double step;
+
+	/* Position of the first sample relative to the centre of the viewport,
+	 * in samples. Lets plugins that keep their own, more precise, centre
+	 * find where the request lies. */
+	long col_offset;
+	long row_offset;
+
+	/* Centre of the viewport and distance between samples with all the
+	 * digits they were given in. NULL if the host does not have them.
+	 * Iterators draw around this centre and no other, since the host
+	 * mirrors rows across the real axis by it. */
+	const struct big_fixed *centre_x;
+	const struct big_fixed *centre_y;
+	const struct big_fixed *step_bf;
+
+	/* Distance of each sample from the boundary of the set, in samples.
+	 * Filled by iterators registered with FRG_ITERATOR_DISTANCE and NULL
+	 * for all others. Zero inside the set. */
+	float *distance;
 };
 
 typedef void (*iterate_fn)(
@@ -24,9 +46,21 @@ typedef void (*iterate_fn)(
 	unsigned * restrict iterations,
 	const struct frg_param_set_s *params);
 
+/* The fractal is its own mirror image across the real axis, so the host may
+ * iterate one half of a viewport that straddles it and copy the other. */
+#define FRG_ITERATOR_CONJ_SYMMETRIC	(1u << 0)
+
+/* The iterator fills frg_iteration_request_s.distance. */
+#define FRG_ITERATOR_DISTANCE		(1u << 1)
+
+/* The iterator counts iterations of z -> z^2 + c from z = c for as long as
+ * |z| <= 2, so the host may fill in tiles it can settle on its own. */
+#define FRG_ITERATOR_MANDELBROT		(1u << 2)
+
 struct frg_iterate_func_s {
 	char *name;
 	iterate_fn iterate;
+	unsigned flags;
 };
 
 typedef void (*render_fn)(
@@ -40,9 +74,97 @@ struct frg_render_func_s {
 	render_fn render;
 };
 
+/* Scatter functions add up where the orbits of many points go, rather than
+ * how long each sample takes to escape. */
+struct frg_scatter_request_s {
+	unsigned rows;
+	unsigned cols;
+	unsigned iterations;
+	double from_x;
+	double from_y;
+	double step;
+
+	/* Orbits to follow. The same seed follows the same orbits. */
+	unsigned long samples;
+	unsigned long long seed;
+
+	/* Visits of sample (row, col) are added to histogram[row * cols + col].
+	 * Counts are 64 bits wide, as a hot sample of a long run passes 2^32. */
+	uint64_t *histogram;
+};
+
+typedef void (*scatter_fn)(
+	const struct frg_scatter_request_s *spec,
+	const struct frg_param_set_s *params);
+
+struct frg_scatter_func_s {
+	char *name;
+	scatter_fn scatter;
+};
+
+/* Sweep functions draw the Julia sets of many constants c at once, all on
+ * the same grid of samples, and are registered under the name of the Julia
+ * iterator they match. */
+struct frg_sweep_request_s {
+	unsigned rows;
+	unsigned cols;
+	unsigned iterations;
+	double from_x;
+	double from_y;
+	double step;
+
+	/* Constants of the sets. */
+	size_t count;
+	const double *c_real;
+	const double *c_img;
+
+	/* Counts of set k, laid out as for a frg_iteration_request_s with
+	 * these rows and cols, start at counts[k * rows * cols]. */
+	unsigned *counts;
+};
+
+typedef void (*sweep_fn)(
+	const struct frg_sweep_request_s *spec,
+	const struct frg_param_set_s *params);
+
+struct frg_sweep_func_s {
+	char *name;
+	sweep_fn sweep;
+};
+
+/* Points functions count iterations at any points rather than on a grid, the
+ * same as the iterator they are registered with the name of would count them
+ * on one. */
+struct frg_points_request_s {
+	size_t count;
+	unsigned iterations;
+	const double *real;
+	const double *img;
+
+	/* Iterations of point n go to counts[n]. */
+	unsigned *counts;
+
+	/* Where z was when it escaped or ran out of iterations, or both NULL
+	 * if not wanted. */
+	double *final_real;
+	double *final_img;
+};
+
+typedef void (*points_fn)(
+	const struct frg_points_request_s *spec,
+	const struct frg_param_set_s *params);
+
+struct frg_points_func_s {
+	char *name;
+	points_fn points;
+};
+
 struct frg_render_fn_repo_s {
 	struct ptr_array iterate_funcs;
 	struct ptr_array render_funcs;
+	struct ptr_array scatter_funcs;
+	struct ptr_array sweep_funcs;
+	struct ptr_array points_funcs;
 };
 
 typedef int (*frg_module_init_fn)(struct frg_render_fn_repo_s *itr);
@@ -54,18 +176,43 @@ int frg_load_modules(
 void frg_fn_repo_init(struct frg_render_fn_repo_s *itr);
 void frg_fn_repo_destroy(struct frg_render_fn_repo_s *itr);
 iterate_fn frg_fn_repo_get_iterator(struct frg_render_fn_repo_s *itr, const char *name);
+unsigned frg_fn_repo_get_iterator_flags(struct frg_render_fn_repo_s *itr, const char *name);
 render_fn frg_fn_repo_get_renderer(struct frg_render_fn_repo_s *itr, const char *name);
+scatter_fn frg_fn_repo_get_scatter(struct frg_render_fn_repo_s *itr, const char *name);
+sweep_fn frg_fn_repo_get_sweep(struct frg_render_fn_repo_s *itr, const char *name);
+points_fn frg_fn_repo_get_points(struct frg_render_fn_repo_s *itr, const char *name);
 
 void frg_fn_repo_register_iterator(
 		struct frg_render_fn_repo_s *itr,
 		const char *name,
 		iterate_fn fn);
 
+void frg_fn_repo_register_iterator_flags(
+		struct frg_render_fn_repo_s *itr,
+		const char *name,
+		iterate_fn fn,
+		unsigned flags);
+
 void frg_fn_repo_register_renderer(
 		struct frg_render_fn_repo_s *itr,
 		const char *name,
 		render_fn fn);
 
+void frg_fn_repo_register_scatter(
+		struct frg_render_fn_repo_s *itr,
+		const char *name,
+		scatter_fn fn);
+
+void frg_fn_repo_register_sweep(
+		struct frg_render_fn_repo_s *itr,
+		const char *name,
+		sweep_fn fn);
+
+void frg_fn_repo_register_points(
+		struct frg_render_fn_repo_s *itr,
+		const char *name,
+		points_fn fn);
+
 #ifdef __cplusplus
 }
 #endif
@@ -4,6 +4,7 @@
 #include <stdlib.h>
 #include <stdint.h>
 #include "cdouble.h"
+#include "big_fixed.h"
 
 #ifdef __cplusplus
 extern "C"
@@ -17,8 +18,14 @@ extern struct cdouble origin;
 extern const char *file;
 extern unsigned long attempts;
 extern uint16_t threads;
+extern uint16_t tile_size;
 extern uint16_t supersample_level;
 
+/* Viewport as given on the command line, before rounding to double. */
+extern struct big_fixed origin_real_bf;
+extern struct big_fixed origin_img_bf;
+extern struct big_fixed radius_bf;
+
 static const int fixed_precision = 60;
 
 #ifdef __cplusplus
@@ -0,0 +1,88 @@
+#ifndef MANDELBROT_INTERVAL_H
+#define MANDELBROT_INTERVAL_H
+
+#include <math.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Closed interval [lo, hi] of reals. Every operation widens its result by one
+ * ulp on each side, which covers the rounding of the operation itself, so the
+ * exact result for any choice of operands always lies inside. */
+struct interval {
+	double lo;
+	double hi;
+};
+
+static inline struct interval iv_make(double lo, double hi)
+{
+	struct interval ret;
+
+	ret.lo = lo;
+	ret.hi = hi;
+
+	return ret;
+}
+
+static inline struct interval iv_widen(double lo, double hi)
+{
+	return iv_make(nextafter(lo, -INFINITY), nextafter(hi, INFINITY));
+}
+
+static inline struct interval iv_add(struct interval a, struct interval b)
+{
+	return iv_widen(a.lo + b.lo, a.hi + b.hi);
+}
+
+static inline struct interval iv_sub(struct interval a, struct interval b)
+{
+	return iv_widen(a.lo - b.hi, a.hi - b.lo);
+}
+
+static inline struct interval iv_add_d(struct interval a, double d)
+{
+	return iv_widen(a.lo + d, a.hi + d);
+}
+
+static inline struct interval iv_mul(struct interval a, struct interval b)
+{
+	double p1;
+	double p2;
+	double p3;
+	double p4;
+
+	p1 = a.lo * b.lo;
+	p2 = a.lo * b.hi;
+	p3 = a.hi * b.lo;
+	p4 = a.hi * b.hi;
+
+	return iv_widen(fmin(fmin(p1, p2), fmin(p3, p4)), fmax(fmax(p1, p2), fmax(p3, p4)));
+}
+
+/* Exact, so no widening needed. */
+static inline struct interval iv_mul_pow2(struct interval a, int k)
+{
+	return iv_make(ldexp(a.lo, k), ldexp(a.hi, k));
+}
+
+/* Tighter than iv_mul(a, a): a square is never negative. */
+static inline struct interval iv_sqr(struct interval a)
+{
+	double l;
+	double h;
+
+	l = a.lo * a.lo;
+	h = a.hi * a.hi;
+
+	if (a.lo <= 0.0 && a.hi >= 0.0)
+		return iv_make(0.0, nextafter(fmax(l, h), INFINITY));
+
+	return iv_widen(fmin(l, h), fmax(l, h));
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* MANDELBROT_INTERVAL_H */
@@ -0,0 +1,30 @@
+#ifndef MANDELBROT_NETIO_H
+#define MANDELBROT_NETIO_H
+
+#include <stdio.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+#include <string>
+
+extern "C" {
+#endif
+
+/* Sends all length bytes, carrying on after short sends and signals.
+ * Returns non-zero once the connection fails. */
+int net_send_all(int fd, const void *buf, size_t length);
+
+/* Listens for TCP connections on port of the numeric address host, e.g.
+ * 127.0.0.1 or 0.0.0.0 for every interface. Returns the socket, or -1 after
+ * printing why it failed, prefixed with who. */
+int net_listen(const char *who, const char *host, unsigned short port, int backlog);
+
+#ifdef __cplusplus
+}
+
+/* Reads a line of any length without its newline. Returns false at the end
+ * of in. */
+bool net_read_line(FILE *in, std::string &line);
+#endif
+
+#endif /* MANDELBROT_NETIO_H */
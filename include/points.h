@@ -0,0 +1,37 @@
+#ifndef MANDELBROT_POINTS_H
+#define MANDELBROT_POINTS_H
+
+#include <stdio.h>
+
+#include "render.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Points read, counted and written at a time. */
+#define POINTS_BATCH	(65536)
+
+/* Points handed to a thread at a time. */
+#define POINTS_TASK	(1024)
+
+/* Counts iterations at points read from in, one "x y" pair to a line, and
+ * writes "x y count" lines to out in the same order, followed by where z
+ * ended up if final_z is set. Blank lines and lines starting with '#' are
+ * skipped. Points are counted by frame->points, with the iterations and
+ * parameters of frame. */
+struct points_s {
+	FILE *in;
+	FILE *out;
+	int final_z;
+	struct render_frame_s frame;
+};
+
+/* Returns non-zero on a line that is not a point. */
+int points(struct render_pool_s *pool, const struct points_s *pts);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* MANDELBROT_POINTS_H */
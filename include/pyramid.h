@@ -0,0 +1,32 @@
+#ifndef MANDELBROT_PYRAMID_H
+#define MANDELBROT_PYRAMID_H
+
+#include "render.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Side of a pyramid tile in pixels. */
+#define PYRAMID_TILE	(256)
+
+/* A width x height image of the viewport of frame, written as a Deep Zoom
+ * pyramid: dir/image.dzi and dir/image_files/<level>/<col>_<row>.bmp, with
+ * level 0 one pixel in size and each level twice the one before. */
+struct pyramid_s {
+	const char *dir;
+	unsigned long width;
+	unsigned long height;
+	uint16_t supersample_level;
+
+	/* Viewport of the whole image and everything else but the image. */
+	struct render_frame_s frame;
+};
+
+int pyramid(struct render_pool_s *pool, const struct pyramid_s *pyr);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* MANDELBROT_PYRAMID_H */
@@ -0,0 +1,123 @@
+#ifndef MANDELBROT_RENDER_H
+#define MANDELBROT_RENDER_H
+
+#ifdef __cplusplus
+#define restrict
+#endif
+
+#include "bmp.h"
+#include "cdouble.h"
+#include "big_fixed.h"
+#include "checkpoint.h"
+
+#include "fractalgen/param_set.h"
+#include "fractalgen/plugin.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Worker threads that stay up between frames, along with the buffers they
+ * draw into. */
+struct render_pool_s;
+
+typedef void (*render_job_fn)(void *arg, unsigned worker);
+
+struct render_pool_s * render_pool_new(unsigned threads);
+void render_pool_delete(struct render_pool_s *pool);
+unsigned render_pool_threads(const struct render_pool_s *pool);
+
+/* Calls job(arg, worker) once on every thread of the pool and returns when
+ * all of them are done. */
+void render_pool_run(struct render_pool_s *pool, render_job_fn job, void *arg);
+
+/* Makes render_frame stop at the next tile while set. Any thread may call it,
+ * and it stays set until called again with 0. */
+void render_pool_cancel(struct render_pool_s *pool, int cancel);
+
+/* Lets a frame take iteration counts over from the frame the pool drew
+ * before it. A sample is taken over from the nearest sample of that frame if
+ * the two lie within tolerance pixels of each other and no count among that
+ * sample and its eight neighbours differs from another by more than edge. */
+struct render_reuse_s {
+	double tolerance;
+	unsigned edge;
+
+	/* Samples taken over and samples in all, filled in by render_frame. */
+	size_t reused;
+	size_t samples;
+};
+
+/* Counts each tile only as far as it needs, with iterations as the most any
+ * may take. A probe of one sample in 8 x 8 picks where tiles start, and a
+ * tile goes on four times as far for as long as enough of its samples still
+ * escape in the last half of its budget. What never escapes is inside. */
+#define RENDER_MAX_BUDGETS	(16)
+
+struct render_adaptive_s {
+	/* Filled in by render_frame: the budget the probe settled on, and the
+	 * budgets tiles ended up with, smallest first, with how many tiles had
+	 * each. */
+	unsigned probe;
+	unsigned budgets[RENDER_MAX_BUDGETS];
+	size_t tiles[RENDER_MAX_BUDGETS];
+	unsigned count;
+};
+
+/* One image of the viewport centred at org, radius r along its smaller
+ * dimension. The big_fixed fields carry the same viewport with every digit
+ * it was given in. */
+struct render_frame_s {
+	struct bmp_img *img;
+	struct cdouble org;
+	double r;
+	const struct big_fixed *org_real_bf;
+	const struct big_fixed *org_img_bf;
+	const struct big_fixed *r_bf;
+	unsigned iterations;
+	iterate_fn iterate;
+	unsigned iterate_flags;
+	render_fn render;
+	const struct frg_param_set_s *params;
+
+	/* Counts the iterator at any points, for what is not drawn on a grid.
+	 * NULL if the iterator cannot. */
+	points_fn points;
+
+	/* NULL to draw every sample. */
+	struct render_reuse_s *reuse;
+
+	/* Copy counts over from the frame the pool drew before where its
+	 * samples lie exactly on samples of this one, as they do after a pan by
+	 * whole samples or a zoom by a whole factor, and only count the rest. */
+	int incremental;
+
+	/* Tiles are logged here as they are done, and those it already holds
+	 * are not counted again. NULL for none. Only whole frames use it. The
+	 * frame is cancelled if a tile can't be logged. */
+	struct render_checkpoint_s *checkpoint;
+
+	/* NULL to count every sample as far as iterations. Pixels are coloured
+	 * as if iterations were the largest budget a tile took, or iterations
+	 * itself for render_part so that parts agree. */
+	struct render_adaptive_s *adaptive;
+};
+
+/* Returns non-zero if the frame was cancelled before it was finished. */
+int render_frame(struct render_pool_s *pool, const struct render_frame_s *frame);
+
+/* Draws the w x h pixels at (x, y), from the top left, of a width x height
+ * image of the viewport of frame with 2^level samples a side to a pixel, and
+ * returns them downsampled. Samples lie on the grid of the whole image, and a
+ * part that starts on a tile of it, counting from the bottom left, comes out
+ * the same as in the whole unless the whole mirrors rows across the real
+ * axis. frame->img is not used. */
+struct bmp_img * render_part(struct render_pool_s *pool, const struct render_frame_s *frame,
+	unsigned long width, unsigned long height, unsigned level,
+	unsigned long x, unsigned long y, unsigned long w, unsigned long h);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* MANDELBROT_RENDER_H */
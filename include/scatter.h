@@ -0,0 +1,39 @@
+#ifndef MANDELBROT_SCATTER_H
+#define MANDELBROT_SCATTER_H
+
+#include "render.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Orbits a scatter function is handed at a time. */
+#define SCATTER_BATCH	(16384)
+
+/* An image of how often orbits visit each sample of the viewport of frame,
+ * drawn with a scatter function such as the Buddhabrot. Every thread adds
+ * batches of orbits up in a histogram of its own, the histograms are summed
+ * once all are done, and counts are turned into grey levels in proportion
+ * to (count / reference)^gamma, the reference being the count that only one
+ * sample in a thousand exceeds. Batches are seeded by their number, so the
+ * image does not depend on the number of threads. */
+struct scatter_s {
+	const char *path;
+	uint16_t width;
+	uint16_t height;
+	uint16_t supersample_level;
+	unsigned long long orbits;
+	double gamma;
+	scatter_fn scatter;
+
+	/* Viewport, iterations and plugin parameters. */
+	struct render_frame_s frame;
+};
+
+int scatter(struct render_pool_s *pool, const struct scatter_s *sc);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* MANDELBROT_SCATTER_H */
@@ -0,0 +1,38 @@
+#ifndef MANDELBROT_SERVE_H
+#define MANDELBROT_SERVE_H
+
+#include <stdio.h>
+
+#include "render.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Renders viewports on request, one line each:
+ *
+ *	<id> <width> <height> <x> <y> <r>
+ *
+ * and answers each one with a line "<id> <width> <height>" followed by
+ * width * height * 3 bytes of RGB, top row first, or with "<id> cancelled" if
+ * a newer request came in before it was done, or "<id> error" if it could not
+ * be drawn. */
+struct server_s {
+	/* Unix socket to listen on, or NULL to read requests from in and
+	 * answer them on out. */
+	const char *socket_path;
+	FILE *in;
+	FILE *out;
+	uint16_t supersample_level;
+
+	/* Everything but the viewport and the image. */
+	struct render_frame_s frame;
+};
+
+int serve(struct render_pool_s *pool, const struct server_s *server);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* MANDELBROT_SERVE_H */
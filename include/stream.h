@@ -0,0 +1,57 @@
+#ifndef MANDELBROT_STREAM_H
+#define MANDELBROT_STREAM_H
+
+#include <stdio.h>
+
+#include "bmp.h"
+#include "render.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+enum stream_format {
+	STREAM_NONE,
+	/* YUV4MPEG2, 4:2:0 with BT.601 colours in studio range. */
+	STREAM_Y4M,
+	/* Bare 8-bit RGB, top row first. */
+	STREAM_RGB
+};
+
+/* Frames written one after the other to a file, a pipe or stdout, for an
+ * encoder to pick up as they come. */
+struct frame_stream_s {
+	FILE *f;
+	enum stream_format format;
+	uint16_t width;
+	uint16_t height;
+	uint16_t supersample_level;
+	unsigned fps;
+};
+
+enum stream_format stream_format_parse(const char *name);
+
+/* Returns a file that writes to what stdout was, and points stdout at stderr
+ * so that nothing else ends up among the data. */
+FILE * stream_take_stdout(void);
+
+/* Opens path for frames of width x height pixels, drawn at 2^level times
+ * that. Path "-" is stdout, and everything else the program prints goes to
+ * stderr from then on. */
+int stream_open(struct frame_stream_s *s, const char *path, enum stream_format format,
+	uint16_t width, uint16_t height, uint16_t supersample_level, unsigned fps);
+void stream_close(struct frame_stream_s *s);
+
+size_t stream_frame_bytes(const struct frame_stream_s *s);
+
+/* Downsamples img and converts it to the format of the stream on the threads
+ * of pool. */
+void stream_convert(const struct frame_stream_s *s, struct render_pool_s *pool,
+	const struct bmp_img *img, unsigned char *dest);
+int stream_write(const struct frame_stream_s *s, const unsigned char *frame);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* MANDELBROT_STREAM_H */
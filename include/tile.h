@@ -0,0 +1,20 @@
+#ifndef MANDELBROT_TILE_H
+#define MANDELBROT_TILE_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Tries to settle a whole tile of samples of z -> z^2 + c without touching a
+ * single one of them. Sample (i, j) lies at (from_x + j * step, from_y + i *
+ * step). Returns non-zero and stores the iteration count all samples share
+ * in *iterations_ret if the tile provably lies inside the main cardiod or the
+ * period-2 bulb, or provably escapes at the same iteration everywhere. */
+int tile_classify(double from_x, double from_y, double step, unsigned rows,
+	unsigned cols, unsigned iterations, unsigned *iterations_ret);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* MANDELBROT_TILE_H */
@@ -0,0 +1,42 @@
+#ifndef MANDELBROT_TILESERVE_H
+#define MANDELBROT_TILESERVE_H
+
+#include <stddef.h>
+
+#include "render.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Side of a tile in pixels. */
+#define TILE_PIXELS		(256)
+
+/* Serves tiles of a slippy map over HTTP on localhost, at /<z>/<x>/<y>.bmp.
+ * Zoom z splits the viewport of frame into 2^z x 2^z tiles, with tile (0, 0)
+ * at the top left. Tiles are drawn when first asked for and kept in memory,
+ * and on disk if dir is set. */
+struct tile_server_s {
+	unsigned short port;
+
+	/* Bytes of encoded tiles kept in memory. */
+	size_t cache_bytes;
+
+	/* Directory to keep tiles in as <z>/<x>/<y>.bmp, or NULL. The tiles
+	 * there are served only to a server of the same key, the arguments that
+	 * decide what the tiles show. */
+	const char *dir;
+	const char *key;
+	uint16_t supersample_level;
+
+	/* Viewport of zoom 0 and everything else but the image. */
+	struct render_frame_s frame;
+};
+
+int tile_serve(struct render_pool_s *pool, const struct tile_server_s *server);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* MANDELBROT_TILESERVE_H */
@@ -0,0 +1,42 @@
+#ifndef MANDELBROT_U32ARR_H
+#define MANDELBROT_U32ARR_H
+
+#include <stdlib.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Arithmetic on little-endian arrays of uint32_t. All lengths are counted in
+ * uint32_t's. Nothing here allocates the destination, so the caller decides
+ * how big the result may get. */
+
+/* Returns length of arr without most significant zeroes. */
+size_t u32arr_trim(const uint32_t *arr, size_t len);
+
+int u32arr_cmp(const uint32_t *a, size_t a_len, const uint32_t *b, size_t b_len);
+
+/* a += b. Expects a_len >= b_len. Returns carry out of a. */
+uint32_t u32arr_add(uint32_t *a, size_t a_len, const uint32_t *b, size_t b_len);
+
+/* a -= b. Expects a_len >= b_len. Returns borrow out of a. */
+uint32_t u32arr_sub(uint32_t *a, size_t a_len, const uint32_t *b, size_t b_len);
+
+/* a = a * mul + add. Returns carry out of a. */
+uint32_t u32arr_mul_u32(uint32_t *a, size_t len, uint32_t mul, uint32_t add);
+
+/* a /= div. Returns remainder. */
+uint32_t u32arr_div_u32(uint32_t *a, size_t len, uint32_t div);
+
+/* dest = a * b. dest must have room for a_len + b_len uint32_t's and must not
+ * overlap either operand. Switches to Karatsuba multiplication once both
+ * operands are long enough for it to pay off. */
+void u32arr_mul(uint32_t *dest, const uint32_t *a, size_t a_len,
+		const uint32_t *b, size_t b_len);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* MANDELBROT_U32ARR_H */
@@ -0,0 +1,22 @@
+#include <mutex>
+
+#include "fractalgen/lock.h"
+
+struct frg_lock_s {
+	std::mutex mutex;
+};
+
+extern "C" struct frg_lock_s * frg_lock_new(void)
+{
+	return new frg_lock_s;
+}
+
+extern "C" void frg_lock(struct frg_lock_s *lock)
+{
+	lock->mutex.lock();
+}
+
+extern "C" void frg_unlock(struct frg_lock_s *lock)
+{
+	lock->mutex.unlock();
+}
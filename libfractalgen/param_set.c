@@ -37,3 +37,29 @@ double param_set_get_double_d(const struct frg_param_set_s *set, const char *nam
 
 	return ret;
 }
+
+int param_set_get_str(const struct frg_param_set_s *set, const char *name, const char **val)
+{
+	int i;
+
+	for (i = 0; i < set->length; i++) {
+		if (strcmp(name, set->values[i].name) == 0) {
+			if (!set->values[i].text)
+				return 1;
+			*val = set->values[i].text;
+			return 0;
+		}
+	}
+
+	return 1;
+}
+
+const char * param_set_get_str_d(const struct frg_param_set_s *set, const char *name, const char *default_val)
+{
+	const char *ret;
+
+	ret = default_val;
+	param_set_get_str(set, name, &ret);
+
+	return ret;
+}
@@ -7,6 +7,9 @@ void frg_fn_repo_init(struct frg_render_fn_repo_s *itr)
 {
 	ptr_arr_init(&itr->iterate_funcs, 16);
 	ptr_arr_init(&itr->render_funcs, 16);
+	ptr_arr_init(&itr->scatter_funcs, 16);
+	ptr_arr_init(&itr->sweep_funcs, 16);
+	ptr_arr_init(&itr->points_funcs, 16);
 }
 
 void frg_fn_repo_destroy(struct frg_render_fn_repo_s *itr)
@@ -14,6 +17,9 @@ void frg_fn_repo_destroy(struct frg_render_fn_repo_s *itr)
 	size_t i;
 	struct frg_render_func_s *render_func;
 	struct frg_iterate_func_s *iterate_func;
+	struct frg_scatter_func_s *scatter_func;
+	struct frg_sweep_func_s *sweep_func;
+	struct frg_points_func_s *points_func;
 
 	for (i = 0; i < itr->iterate_funcs.used; i++) {
 		iterate_func = itr->iterate_funcs.arr[i];
@@ -30,6 +36,30 @@ void frg_fn_repo_destroy(struct frg_render_fn_repo_s *itr)
 	}
 
 	ptr_arr_delete(&itr->render_funcs);
+
+	for (i = 0; i < itr->scatter_funcs.used; i++) {
+		scatter_func = itr->scatter_funcs.arr[i];
+		free(scatter_func->name);
+		free(scatter_func);
+	}
+
+	ptr_arr_delete(&itr->scatter_funcs);
+
+	for (i = 0; i < itr->sweep_funcs.used; i++) {
+		sweep_func = itr->sweep_funcs.arr[i];
+		free(sweep_func->name);
+		free(sweep_func);
+	}
+
+	ptr_arr_delete(&itr->sweep_funcs);
+
+	for (i = 0; i < itr->points_funcs.used; i++) {
+		points_func = itr->points_funcs.arr[i];
+		free(points_func->name);
+		free(points_func);
+	}
+
+	ptr_arr_delete(&itr->points_funcs);
 }
 
 iterate_fn frg_fn_repo_get_iterator(struct frg_render_fn_repo_s *itr, const char *name)
@@ -48,6 +78,22 @@ iterate_fn frg_fn_repo_get_iterator(struct frg_render_fn_repo_s *itr, const char
 	return NULL;
 }
 
+unsigned frg_fn_repo_get_iterator_flags(struct frg_render_fn_repo_s *itr, const char *name)
+{
+	size_t i;
+	struct frg_iterate_func_s *fn;
+
+	for (i = 0; i < itr->iterate_funcs.used; i++) {
+		fn = itr->iterate_funcs.arr[i];
+
+		if (strcmp(fn->name, name) == 0) {
+			return fn->flags;
+		}
+	}
+
+	return 0;
+}
+
 render_fn frg_fn_repo_get_renderer(struct frg_render_fn_repo_s *itr, const char *name)
 {
 	size_t i;
@@ -64,6 +110,54 @@ render_fn frg_fn_repo_get_renderer(struct frg_render_fn_repo_s *itr, const char
 	return NULL;
 }
 
+scatter_fn frg_fn_repo_get_scatter(struct frg_render_fn_repo_s *itr, const char *name)
+{
+	size_t i;
+	struct frg_scatter_func_s *fn;
+
+	for (i = 0; i < itr->scatter_funcs.used; i++) {
+		fn = itr->scatter_funcs.arr[i];
+
+		if (strcmp(fn->name, name) == 0) {
+			return fn->scatter;
+		}
+	}
+
+	return NULL;
+}
+
+sweep_fn frg_fn_repo_get_sweep(struct frg_render_fn_repo_s *itr, const char *name)
+{
+	size_t i;
+	struct frg_sweep_func_s *fn;
+
+	for (i = 0; i < itr->sweep_funcs.used; i++) {
+		fn = itr->sweep_funcs.arr[i];
+
+		if (strcmp(fn->name, name) == 0) {
+			return fn->sweep;
+		}
+	}
+
+	return NULL;
+}
+
+points_fn frg_fn_repo_get_points(struct frg_render_fn_repo_s *itr, const char *name)
+{
+	size_t i;
+	struct frg_points_func_s *fn;
+
+	for (i = 0; i < itr->points_funcs.used; i++) {
+		fn = itr->points_funcs.arr[i];
+
+		if (strcmp(fn->name, name) == 0) {
+			return fn->points;
+		}
+	}
+
+	return NULL;
+}
+
 static char * string_copy(const char *str)
 {
 	char *ret;
@@ -81,12 +175,22 @@ void frg_fn_repo_register_iterator(
 		struct frg_render_fn_repo_s *itr,
 		const char *name,
 		iterate_fn fn)
+{
+	frg_fn_repo_register_iterator_flags(itr, name, fn, 0);
+}
+
+void frg_fn_repo_register_iterator_flags(
+		struct frg_render_fn_repo_s *itr,
+		const char *name,
+		iterate_fn fn,
+		unsigned flags)
 {
 	struct frg_iterate_func_s *itr_func;
 
 	itr_func = malloc(sizeof(*itr_func));
 	itr_func->name = string_copy(name);
 	itr_func->iterate = fn;
+	itr_func->flags = flags;
 
 	ptr_arr_add(&itr->iterate_funcs, itr_func);
 }
@@ -103,3 +207,42 @@ void frg_fn_repo_register_renderer(
 
 	ptr_arr_add(&itr->render_funcs, render_func);
 }
+
+void frg_fn_repo_register_scatter(
+		struct frg_render_fn_repo_s *itr,
+		const char *name, scatter_fn fn)
+{
+	struct frg_scatter_func_s *scatter_func;
+
+	scatter_func = malloc(sizeof(*scatter_func));
+	scatter_func->name = string_copy(name);
+	scatter_func->scatter = fn;
+
+	ptr_arr_add(&itr->scatter_funcs, scatter_func);
+}
+
+void frg_fn_repo_register_sweep(
+		struct frg_render_fn_repo_s *itr,
+		const char *name, sweep_fn fn)
+{
+	struct frg_sweep_func_s *sweep_func;
+
+	sweep_func = malloc(sizeof(*sweep_func));
+	sweep_func->name = string_copy(name);
+	sweep_func->sweep = fn;
+
+	ptr_arr_add(&itr->sweep_funcs, sweep_func);
+}
+
+void frg_fn_repo_register_points(
+		struct frg_render_fn_repo_s *itr,
+		const char *name, points_fn fn)
+{
+	struct frg_points_func_s *points_func;
+
+	points_func = malloc(sizeof(*points_func));
+	points_func->name = string_copy(name);
+	points_func->points = fn;
+
+	ptr_arr_add(&itr->points_funcs, points_func);
+}
@@ -0,0 +1,254 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+
+#include "fractalgen/plugin.h"
+#include "fractalgen/param_set.h"
+
+#include "debug.h"
+
+/* The Buddhabrot counts how often the orbits of points c under z -> z^2 + c,
+ * from z = 0, pass through each sample, taking only orbits that escape. The
+ * anti-Buddhabrot takes only those that do not. Orbits are mirrored across
+ * the real axis, as the set is.
+ *
+ * Points c are picked uniformly from the square of side 4 around 0, or with
+ * -Dmetropolis=1 by a Metropolis-Hastings walk that favours points in
+ * proportion to how many points of their orbit land in the viewport. That
+ * pays off when zoomed in, where few uniform points ever reach it. Each step
+ * of the walk then counts one point of its orbit picked at random, so that
+ * every point of every orbit still counts the same in expectation. The walk
+ * starts afresh for every batch, from wherever a uniform try first lands, so
+ * its first steps are taken without counting until it has settled. */
+
+/* Share of steps of the walk that jump anywhere instead of nearby. */
+#define JUMP_SHARE		(0.2)
+
+/* Uniform tries to find a first point for the walk. */
+#define WALK_START_TRIES	(1000000)
+
+/* Steps the walk takes before it counts, on top of the samples it is asked
+ * for. */
+#define BURN_IN_STEPS		(1024)
+
+static uint64_t rng_next(uint64_t *state)
+{
+	uint64_t z;
+
+	/* splitmix64 */
+	z = (*state += 0x9e3779b97f4a7c15ull);
+	z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+	z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+
+	return z ^ (z >> 31);
+}
+
+/* Uniform in [0, 1). */
+static double rng_uniform(uint64_t *state)
+{
+	return (double)(rng_next(state) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+/* Sample nearest to z, or -1 if it is outside the viewport. */
+static long sample_index(const struct frg_scatter_request_s *spec, double zr, double zi)
+{
+	double col = floor((zr - spec->from_x) / spec->step + 0.5);
+	double row = floor((zi - spec->from_y) / spec->step + 0.5);
+
+	if (col < 0.0 || row < 0.0 || col >= spec->cols || row >= spec->rows)
+		return -1;
+
+	return (long)row * spec->cols + (long)col;
+}
+
+/* Main cardioid and period-2 bulb, as in the escape-time iterators. */
+static int is_interior(double x, double y)
+{
+	double a;
+	double b;
+
+	b = (x - 0.25) * (x - 0.25) + y * y;
+	a = x - 0.25 + 2.0 * b;
+
+	return a * a <= b || (x + 1.0) * (x + 1.0) + y * y <= 0.0625;
+}
+
+/* Non-zero if the orbit of c is of the kind counted. */
+static int orbit_counts(const struct frg_scatter_request_s *spec, double cr, double ci, int anti)
+{
+	double zr = 0.0;
+	double zi = 0.0;
+	double t;
+	unsigned n;
+
+	if (is_interior(cr, ci))
+		return anti;
+
+	for (n = 0; n < spec->iterations; n++) {
+		t = zr * zr - zi * zi + cr;
+		zi = 2.0 * zr * zi + ci;
+		zr = t;
+
+		if (zr * zr + zi * zi > 4.0)
+			return !anti;
+	}
+
+	return anti;
+}
+
+/* Follows the orbit of c again and either counts every point of it in the
+ * viewport, or only counts how many there are and picks one at random. */
+static unsigned orbit_visit(const struct frg_scatter_request_s *spec, double cr, double ci,
+	int record, uint64_t *rng, long *pick)
+{
+	double zr = 0.0;
+	double zi = 0.0;
+	double t;
+	unsigned visits = 0;
+	unsigned n;
+	long idx;
+
+	for (n = 0; n < spec->iterations; n++) {
+		t = zr * zr - zi * zi + cr;
+		zi = 2.0 * zr * zi + ci;
+		zr = t;
+
+		if (zr * zr + zi * zi > 4.0)
+			break;
+
+		if ((idx = sample_index(spec, zr, zi)) < 0)
+			continue;
+
+		visits++;
+
+		if (record)
+			spec->histogram[idx]++;
+		else if (rng_uniform(rng) * visits < 1.0)
+			*pick = idx;
+	}
+
+	return visits;
+}
+
+static void count_mirrored(const struct frg_scatter_request_s *spec, long idx)
+{
+	long row = idx / spec->cols;
+	long col = idx % spec->cols;
+	double zi = -(spec->from_y + row * spec->step);
+	long mirror = sample_index(spec, spec->from_x + col * spec->step, zi);
+
+	spec->histogram[idx]++;
+	if (mirror >= 0)
+		spec->histogram[mirror]++;
+}
+
+static void scatter_uniform(const struct frg_scatter_request_s *spec, int anti, uint64_t *rng)
+{
+	unsigned long i;
+	double cr;
+	double ci;
+
+	for (i = 0; i < spec->samples; i++) {
+		cr = 4.0 * rng_uniform(rng) - 2.0;
+		ci = 2.0 * rng_uniform(rng);
+
+		if (!orbit_counts(spec, cr, ci, anti))
+			continue;
+
+		orbit_visit(spec, cr, ci, 1, rng, NULL);
+		orbit_visit(spec, cr, -ci, 1, rng, NULL);
+	}
+}
+
+/* Points in the viewport of the orbit of c if it is of the kind counted, else
+ * zero, along with one of them picked at random. */
+static unsigned walk_weight(const struct frg_scatter_request_s *spec, double cr, double ci,
+	int anti, uint64_t *rng, long *pick)
+{
+	if (cr * cr + ci * ci > 4.0 || !orbit_counts(spec, cr, ci, anti))
+		return 0;
+
+	return orbit_visit(spec, cr, ci, 0, rng, pick);
+}
+
+static void scatter_metropolis(const struct frg_scatter_request_s *spec, int anti, uint64_t *rng,
+	double mutation)
+{
+	unsigned long steps = spec->samples + BURN_IN_STEPS;
+	unsigned long i;
+	unsigned weight = 0;
+	unsigned next_weight;
+	long pick = -1;
+	long next_pick = -1;
+	double cr = 0.0;
+	double ci = 0.0;
+	double next_cr;
+	double next_ci;
+
+	for (i = 0; i < WALK_START_TRIES && !weight; i++) {
+		cr = 4.0 * rng_uniform(rng) - 2.0;
+		ci = 4.0 * rng_uniform(rng) - 2.0;
+		weight = walk_weight(spec, cr, ci, anti, rng, &pick);
+	}
+
+	if (!weight)
+		return;
+
+	/* Both kinds of step are as likely one way as the other, so a step is
+	 * taken with probability next_weight / weight. */
+	for (i = 0; i < steps; i++) {
+		if (rng_uniform(rng) < JUMP_SHARE) {
+			next_cr = 4.0 * rng_uniform(rng) - 2.0;
+			next_ci = 4.0 * rng_uniform(rng) - 2.0;
+		} else {
+			next_cr = cr + mutation * (2.0 * rng_uniform(rng) - 1.0);
+			next_ci = ci + mutation * (2.0 * rng_uniform(rng) - 1.0);
+		}
+
+		next_weight = walk_weight(spec, next_cr, next_ci, anti, rng, &next_pick);
+
+		if (next_weight && rng_uniform(rng) * weight < next_weight) {
+			cr = next_cr;
+			ci = next_ci;
+			weight = next_weight;
+			pick = next_pick;
+		}
+
+		if (i >= BURN_IN_STEPS)
+			count_mirrored(spec, pick);
+	}
+}
+
+static void scatter(const struct frg_scatter_request_s *spec, const struct frg_param_set_s *params,
+	int anti)
+{
+	uint64_t rng = spec->seed;
+	double mutation;
+
+	if (param_set_get_double_d(params, "metropolis", 0.0) != 0.0) {
+		mutation = param_set_get_double_d(params, "mutation",
+			0.25 * spec->step * (spec->rows > spec->cols ? spec->rows : spec->cols));
+		scatter_metropolis(spec, anti, &rng, mutation);
+	} else {
+		scatter_uniform(spec, anti, &rng);
+	}
+}
+
+static void scatter_buddhabrot(const struct frg_scatter_request_s *spec,
+	const struct frg_param_set_s *params)
+{
+	scatter(spec, params, 0);
+}
+
+static void scatter_anti_buddhabrot(const struct frg_scatter_request_s *spec,
+	const struct frg_param_set_s *params)
+{
+	scatter(spec, params, 1);
+}
+
+extern void frg_module_init(struct frg_render_fn_repo_s *itr)
+{
+	frg_fn_repo_register_scatter(itr, "buddhabrot", scatter_buddhabrot);
+	frg_fn_repo_register_scatter(itr, "anti-buddhabrot", scatter_anti_buddhabrot);
+}
@@ -0,0 +1,612 @@
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#define restrict
+
+#include "fractalgen/memmove.h"
+#include "fractalgen/plugin.h"
+#include "fractalgen/param_set.h"
+
+#include "debug.h"
+
+/* Escape-time iterators of z -> f(z)^Power + c, one template instantiated for
+ * each of them, so that every choice below is made at compile time and the
+ * loops carry nothing but arithmetic. */
+
+#if defined(__GNUC__) && defined(_ISOC11_SOURCE)
+	#define ASSUME_ALIGNED(__ptr, __a)	\
+		do { __ptr = (decltype(__ptr))__builtin_assume_aligned((__ptr), (__a)); } while (0)
+
+	static inline void * frg_aligned_malloc(const size_t size, const size_t alignment)
+	{
+		return aligned_alloc(alignment, size);
+	}
+#else	/* Cannot use aligned buffers */
+	#define ASSUME_ALIGNED(__ptr, __a) do {} while (0)
+	#define frg_aligned_malloc(__sz, __a) malloc(__sz)
+#endif
+
+#define BUFFER_ALIGNMENT	(64)
+
+/* Points iterated together. Must divide the samples of a block. */
+#define LANES			(16)
+
+/* Iterations between checks whether any of LANES points is still inside. */
+#define ESCAPE_CHECK_INTERVAL	(16)
+
+#define SQUARE(__x) ((__x) * (__x))
+
+/* What f does to z before it is raised to Power. */
+enum escape_variant {
+	/* f(z) = z */
+	VARIANT_PLAIN,
+
+	/* f(z) = |re z| + |im z| i */
+	VARIANT_BURNING_SHIP,
+
+	/* f(z) = conj(z) */
+	VARIANT_TRICORN
+};
+
+/* Iterates z -> f(z)^Power + c from z = c, the sample, or with Julia from
+ * z = the sample with c given by parameters creal and cimg. */
+template <typename T, unsigned Power, enum escape_variant Variant, bool Julia>
+struct escape_kernel {
+	/* Julia sets are drawn in larger blocks, so that whole blocks can be
+	 * copied from their mirror image. */
+	static const size_t block_rows = Julia ? 16 : 4;
+	static const size_t block_cols = Julia ? 16 : 4;
+	static const size_t block_length = block_rows * block_cols;
+
+	/* Where the set is known inside without iterating. */
+	static const bool has_interior = !Julia && Power == 2 && Variant == VARIANT_PLAIN;
+
+	/* Julia sets that are their own image under z -> -z. */
+	static const bool has_mirror = Julia && (Power % 2 == 0 || Variant == VARIANT_BURNING_SHIP);
+
+	struct block_s {
+		T real[block_length];
+		T img[block_length];
+		unsigned iterations[block_length];
+	};
+};
+
+/* Julia sets of even powers are symmetric under z -> -z. A sample grid
+ * centred at c with spacing step maps onto itself under that rotation if
+ * 2c / step is a whole number. Sample (i, j) of a request is then the mirror
+ * of (rows_sum - i, cols_sum - j). */
+struct julia_mirror_s {
+	long rows_sum;
+	long cols_sum;
+	int usable;
+};
+
+static long mirror_sum(double from, double step, long offset, int *usable)
+{
+	double twice_centre;
+	double rounded;
+
+	twice_centre = 2.0 * (from - offset * step) / step;
+	rounded = floor(twice_centre + 0.5);
+	*usable &= fabs(twice_centre - rounded) < 1e-3;
+
+	/* -(2c / step) - 2 * offset */
+	return -(long)rounded - 2 * offset;
+}
+
+static void mirror_init(struct julia_mirror_s *m, const struct frg_iteration_request_s *spec,
+	bool has_mirror)
+{
+	m->usable = has_mirror;
+	m->rows_sum = mirror_sum(spec->from_y, spec->step, spec->row_offset, &m->usable);
+	m->cols_sum = mirror_sum(spec->from_x, spec->step, spec->col_offset, &m->usable);
+}
+
+/* Non-zero if sample (i, j) has its mirror earlier in the request. */
+static int mirror_is_copy(const struct julia_mirror_s *m, long i, long j, long rows, long cols)
+{
+	long mi;
+	long mj;
+
+	mi = m->rows_sum - i;
+	mj = m->cols_sum - j;
+
+	if (!m->usable || mi < 0 || mi >= rows || mj < 0 || mj >= cols)
+		return 0;
+
+	return mi < i || (mi == i && mj < j);
+}
+
+static int mirror_block_is_copy(const struct julia_mirror_s *m, size_t block_row,
+	size_t block_col, size_t block_rows, size_t block_cols, size_t rows, size_t cols)
+{
+	size_t i;
+	size_t j;
+
+	for (i = block_row * block_rows; i < (block_row + 1) * block_rows && i < rows; i++) {
+		for (j = block_col * block_cols; j < (block_col + 1) * block_cols && j < cols; j++) {
+			if (!mirror_is_copy(m, (long)i, (long)j, (long)rows, (long)cols))
+				return 0;
+		}
+	}
+
+	return 1;
+}
+
+static void mirror_copy(const struct julia_mirror_s *m, unsigned * restrict iterations,
+	size_t rows, size_t cols)
+{
+	size_t i;
+	size_t j;
+
+	if (!m->usable)
+		return;
+
+	for (i = 0; i < rows; i++) {
+		for (j = 0; j < cols; j++) {
+			if (mirror_is_copy(m, (long)i, (long)j, (long)rows, (long)cols)) {
+				iterations[i * cols + j] = iterations[(m->rows_sum - i) * cols
+					+ (m->cols_sum - j)];
+			}
+		}
+	}
+}
+
+/* Lays the samples of a block out from (from_x, from_y), row by row. */
+template <typename K, typename T>
+static void block_meshgrid(typename K::block_s *block, T from_x, T from_y, T step)
+{
+	size_t i;
+	size_t j;
+
+	for (i = 0; i < K::block_rows; i++) {
+		for (j = 0; j < K::block_cols; j++) {
+			block->real[i * K::block_cols + j] = step * j + from_x;
+			block->img[i * K::block_cols + j] = step * i + from_y;
+		}
+	}
+}
+
+/* Whether a point lies inside the main cardiod or the period-2 bulb, which
+ * never escape.
+ *
+ * Main cardiod:
+ *
+ * p = sqrt((x - 1/4)^2 + y^2)
+ * x <= p - 2p^2 + 1/4
+ *
+ * Square roots are a pain to compute:
+ *
+ * x <= sqrt((x - 1/4)^2 + y^2) - 2((x - 1/4)^2 + y^2) + 1/4
+ * x - 1/4 + 2((x - 1/4)^2 + y^2) <= sqrt((x - 1/4)^2 + y^2)
+ * (x - 1/4 + 2((x - 1/4)^2 + y^2))^2 <= (x - 1/4)^2 + y^2
+ *
+ * a = (x - 1/4 + 2((x - 1/4)^2 + y^2))^2
+ * b = (x - 1/4)^2 + y^2
+ *
+ * Period-2 bulb, the disc of radius 1/4 around -1:
+ *
+ * (x + 1)^2 + y^2 <= 1/16
+ */
+template <typename T>
+static inline bool is_interior(T x, T y)
+{
+	T a;
+	T b;
+
+	b = SQUARE(x - T(0.25)) + SQUARE(y);
+	a = x - T(0.25) + T(2) * b;
+	a *= a;
+
+	return a <= b || SQUARE(x + T(1)) + SQUARE(y) <= T(0.0625);
+}
+
+/* Sets active[l] to zero for points that never escape, and to one for the
+ * points that still need iterating. */
+template <typename T>
+static void interior_mask(const T *real, const T *img, unsigned *active)
+{
+	size_t l;
+
+	for (l = 0; l < LANES; l++)
+		active[l] = !is_interior(real[l], img[l]);
+}
+
+/* One step of z -> f(z)^Power + c, given |re z|^2 and |im z|^2. */
+template <typename T, unsigned Power, enum escape_variant Variant>
+static inline void step(T &real, T &img, T real_sqr, T img_sqr, T c_real, T c_img)
+{
+	T a = real;
+	T b = img;
+	T r;
+	T i;
+	T t;
+	unsigned k;
+
+	if (Variant == VARIANT_BURNING_SHIP) {
+		a = fabs(a);
+		b = fabs(b);
+	} else if (Variant == VARIANT_TRICORN) {
+		b = -b;
+	}
+
+	if (Power == 2) {
+		img = T(2) * a * b + c_img;
+		real = real_sqr - img_sqr + c_real;
+		return;
+	}
+
+	r = a;
+	i = b;
+	for (k = 1; k < Power; k++) {
+		t = r * a - i * b;
+		i = r * b + i * a;
+		r = t;
+	}
+
+	real = r + c_real;
+	img = i + c_img;
+}
+
+/* Counts iterations until a point first leaves the circle of radius 2.
+ * LANES points are iterated at a time from local copies, which the compiler
+ * keeps in vector registers. The inner loop carries no branches, and a group
+ * of points is abandoned once all of them have escaped. */
+template <typename K, typename T, unsigned Power, enum escape_variant Variant, bool Julia>
+static void iterate_block(typename K::block_s *block, unsigned iterations, T c_real, T c_img)
+{
+	T real[LANES];
+	T img[LANES];
+	T cr[LANES];
+	T ci[LANES];
+	unsigned active[LANES];
+	unsigned count[LANES];
+	unsigned any_active;
+	size_t i;
+	size_t j;
+	size_t k;
+	size_t l;
+	T real_sqr;
+	T img_sqr;
+
+	ASSUME_ALIGNED(block, BUFFER_ALIGNMENT);
+
+	for (j = 0; j < K::block_length; j += LANES) {
+		memcpy(real, block->real + j, sizeof(real));
+		memcpy(img, block->img + j, sizeof(img));
+
+		for (l = 0; l < LANES; l++) {
+			cr[l] = Julia ? c_real : real[l];
+			ci[l] = Julia ? c_img : img[l];
+			active[l] = 1;
+		}
+
+		if (K::has_interior)
+			interior_mask(real, img, active);
+
+		for (l = 0; l < LANES; l++)
+			count[l] = active[l] ? 0 : iterations;
+
+		for (i = 0; i < iterations; i += ESCAPE_CHECK_INTERVAL) {
+			any_active = 0;
+			for (l = 0; l < LANES; l++)
+				any_active |= active[l];
+			if (!any_active)
+				break;
+
+			for (k = 0; k < ESCAPE_CHECK_INTERVAL && i + k < iterations; k++) {
+				for (l = 0; l < LANES; l++) {
+					real_sqr = real[l] * real[l];
+					img_sqr = img[l] * img[l];
+					active[l] &= real_sqr + img_sqr <= T(4);
+					count[l] += active[l];
+					step<T, Power, Variant>(real[l], img[l], real_sqr, img_sqr,
+						cr[l], ci[l]);
+				}
+			}
+		}
+
+		memcpy(block->iterations + j, count, sizeof(count));
+	}
+}
+
+template <typename T, unsigned Power, enum escape_variant Variant, bool Julia>
+static void iterate(
+	const struct frg_iteration_request_s *spec,
+	unsigned * restrict iterations,
+	const struct frg_param_set_s *params)
+{
+	typedef escape_kernel<T, Power, Variant, Julia> K;
+	typedef typename K::block_s block_s;
+
+	struct pack_matrix_blocks_args_s pack_args;
+	struct julia_mirror_s mirror;
+	block_s *blocks;
+	block_s *blk;
+	size_t block_rows;
+	size_t block_cols;
+	size_t i;
+	size_t j;
+	T c_real = 0;
+	T c_img = 0;
+
+	if (Julia) {
+		c_real = (T)param_set_get_double_d(params, "creal", 1.0);
+		c_img = (T)param_set_get_double_d(params, "cimg", 1.0);
+	}
+
+	block_rows = spec->rows / K::block_rows + ((spec->rows % K::block_rows) ? 1 : 0);
+	block_cols = spec->cols / K::block_cols + ((spec->cols % K::block_cols) ? 1 : 0);
+	blocks = (block_s *)frg_aligned_malloc(block_rows * block_cols * sizeof(blocks[0]),
+		BUFFER_ALIGNMENT);
+
+	mirror_init(&mirror, spec, K::has_mirror);
+
+	for (i = 0; i < block_rows; i++) {
+		for (j = 0; j < block_cols; j++) {
+			blk = &blocks[i * block_cols + j];
+			block_meshgrid<K, T>(blk,
+				spec->from_x + j * spec->step * K::block_cols,
+				spec->from_y + i * spec->step * K::block_rows,
+				spec->step);
+
+			if (!mirror_block_is_copy(&mirror, i, j, K::block_rows, K::block_cols,
+					spec->rows, spec->cols)) {
+				iterate_block<K, T, Power, Variant, Julia>(blk, spec->iterations,
+					c_real, c_img);
+			}
+		}
+	}
+
+	pack_args.dest = (char *)iterations;
+	pack_args.dest_rows = spec->rows;
+	pack_args.dest_cols = spec->cols * sizeof(unsigned);
+
+	pack_args.src = (const char *)blocks->iterations;
+	pack_args.src_rows = block_rows;
+	pack_args.src_cols = block_cols;
+	pack_args.src_block_rows = K::block_rows;
+	pack_args.src_block_cols = K::block_cols * sizeof(unsigned);
+	pack_args.src_stride = sizeof(blocks[0]);
+
+	frg_pack_matrix_blocks(&pack_args);
+
+	mirror_copy(&mirror, iterations, spec->rows, spec->cols);
+
+	free(blocks);
+}
+
+/* Iterates a stream of points that each carry their own z and c, LANES at a
+ * time. A lane takes the next point as soon as its own escapes or reaches
+ * iterations, so that lanes never idle for the slowest of a group, and z
+ * stays where that happened. Source loads point n into a lane, or settles it
+ * on its own and returns false, and stores what became of it. */
+template <typename T, unsigned Power, enum escape_variant Variant, typename Source>
+static void iterate_stream(Source &src, size_t total, unsigned iterations)
+{
+	const size_t idle = (size_t)-1;
+	T real[LANES];
+	T img[LANES];
+	T cr[LANES];
+	T ci[LANES];
+	unsigned active[LANES];
+	unsigned count[LANES];
+	size_t point[LANES];
+	size_t next = 0;
+	size_t busy;
+	size_t k;
+	size_t l;
+	T real_sqr;
+	T img_sqr;
+	T r;
+	T i;
+
+	for (l = 0; l < LANES; l++) {
+		real[l] = img[l] = cr[l] = ci[l] = 0;
+		active[l] = 0;
+		count[l] = 0;
+		point[l] = idle;
+	}
+
+	for (;;) {
+		busy = 0;
+		for (l = 0; l < LANES; l++) {
+			if (point[l] != idle && active[l]) {
+				busy++;
+				continue;
+			}
+
+			if (point[l] != idle) {
+				src.store(point[l], count[l], real[l], img[l]);
+				point[l] = idle;
+			}
+
+			while (next < total && !src.load(next, real[l], img[l], cr[l], ci[l]))
+				next++;
+
+			if (next == total)
+				continue;
+
+			point[l] = next++;
+			active[l] = 1;
+			count[l] = 0;
+			busy++;
+		}
+
+		if (!busy)
+			break;
+
+		for (k = 0; k < ESCAPE_CHECK_INTERVAL; k++) {
+			for (l = 0; l < LANES; l++) {
+				real_sqr = real[l] * real[l];
+				img_sqr = img[l] * img[l];
+				active[l] &= (real_sqr + img_sqr <= T(4)) & (count[l] < iterations);
+				count[l] += active[l];
+
+				r = real[l];
+				i = img[l];
+				step<T, Power, Variant>(r, i, real_sqr, img_sqr, cr[l], ci[l]);
+				real[l] = active[l] ? r : real[l];
+				img[l] = active[l] ? i : img[l];
+			}
+		}
+	}
+}
+
+/* Samples of the sets of a sweep, set after set. A grid centred at 0 only
+ * holds the first half of each set if it is its own image under z -> -z. */
+struct sweep_source_s {
+	const struct frg_sweep_request_s *spec;
+	size_t samples;
+	size_t per_set;
+
+	template <typename T>
+	bool load(size_t n, T &real, T &img, T &c_real, T &c_img) const
+	{
+		size_t set = n / per_set;
+		size_t s = n % per_set;
+
+		real = (T)(spec->step * (s % spec->cols) + spec->from_x);
+		img = (T)(spec->step * (s / spec->cols) + spec->from_y);
+		c_real = (T)spec->c_real[set];
+		c_img = (T)spec->c_img[set];
+
+		return true;
+	}
+
+	template <typename T>
+	void store(size_t n, unsigned count, T, T) const
+	{
+		spec->counts[n / per_set * samples + n % per_set] = count;
+	}
+};
+
+template <typename T, unsigned Power, enum escape_variant Variant>
+static void sweep(const struct frg_sweep_request_s *spec, const struct frg_param_set_s *params)
+{
+	typedef escape_kernel<T, Power, Variant, true> K;
+
+	struct sweep_source_s src;
+	size_t set;
+	size_t s;
+
+	(void)params;
+
+	src.spec = spec;
+	src.samples = (size_t)spec->rows * spec->cols;
+	src.per_set = src.samples;
+
+	if (K::has_mirror
+			&& fabs(2.0 * spec->from_x / spec->step + (spec->cols - 1.0)) < 1e-3
+			&& fabs(2.0 * spec->from_y / spec->step + (spec->rows - 1.0)) < 1e-3)
+		src.per_set = (src.samples + 1) / 2;
+
+	iterate_stream<T, Power, Variant>(src, spec->count * src.per_set, spec->iterations);
+
+	if (src.per_set == src.samples)
+		return;
+
+	for (set = 0; set < spec->count; set++) {
+		for (s = src.per_set; s < src.samples; s++) {
+			spec->counts[set * src.samples + s] =
+				spec->counts[set * src.samples + src.samples - 1 - s];
+		}
+	}
+}
+
+/* Points of a points request, as z and c for the Mandelbrot set and its kin
+ * or as z for Julia sets. */
+template <typename T, bool Julia, bool Interior>
+struct points_source_s {
+	const struct frg_points_request_s *spec;
+	T c_real;
+	T c_img;
+
+	bool load(size_t n, T &real, T &img, T &cr, T &ci) const
+	{
+		real = (T)spec->real[n];
+		img = (T)spec->img[n];
+		cr = Julia ? c_real : real;
+		ci = Julia ? c_img : img;
+
+		if (Interior && !spec->final_real && is_interior(real, img)) {
+			spec->counts[n] = spec->iterations;
+			return false;
+		}
+
+		return true;
+	}
+
+	void store(size_t n, unsigned count, T real, T img) const
+	{
+		spec->counts[n] = count;
+
+		if (spec->final_real) {
+			spec->final_real[n] = real;
+			spec->final_img[n] = img;
+		}
+	}
+};
+
+template <typename T, unsigned Power, enum escape_variant Variant, bool Julia>
+static void points(const struct frg_points_request_s *spec, const struct frg_param_set_s *params)
+{
+	typedef escape_kernel<T, Power, Variant, Julia> K;
+
+	struct points_source_s<T, Julia, K::has_interior> src;
+
+	src.spec = spec;
+	src.c_real = 0;
+	src.c_img = 0;
+
+	if (Julia) {
+		src.c_real = (T)param_set_get_double_d(params, "creal", 1.0);
+		src.c_img = (T)param_set_get_double_d(params, "cimg", 1.0);
+	}
+
+	iterate_stream<T, Power, Variant>(src, spec->count, spec->iterations);
+}
+
+extern "C" void frg_module_init(struct frg_render_fn_repo_s *itr)
+{
+	frg_fn_repo_register_iterator_flags(itr, "mandelbrot-double",
+		iterate<double, 2, VARIANT_PLAIN, false>,
+		FRG_ITERATOR_CONJ_SYMMETRIC | FRG_ITERATOR_MANDELBROT);
+	frg_fn_repo_register_iterator_flags(itr, "mandelbrot-float",
+		iterate<float, 2, VARIANT_PLAIN, false>,
+		FRG_ITERATOR_CONJ_SYMMETRIC | FRG_ITERATOR_MANDELBROT);
+	frg_fn_repo_register_iterator_flags(itr, "multibrot3-double",
+		iterate<double, 3, VARIANT_PLAIN, false>, FRG_ITERATOR_CONJ_SYMMETRIC);
+	frg_fn_repo_register_iterator_flags(itr, "multibrot4-double",
+		iterate<double, 4, VARIANT_PLAIN, false>, FRG_ITERATOR_CONJ_SYMMETRIC);
+	frg_fn_repo_register_iterator_flags(itr, "tricorn-double",
+		iterate<double, 2, VARIANT_TRICORN, false>, FRG_ITERATOR_CONJ_SYMMETRIC);
+	frg_fn_repo_register_iterator(itr, "burning-ship-double",
+		iterate<double, 2, VARIANT_BURNING_SHIP, false>);
+
+	frg_fn_repo_register_iterator(itr, "julia-float", iterate<float, 2, VARIANT_PLAIN, true>);
+	frg_fn_repo_register_iterator(itr, "julia-double", iterate<double, 2, VARIANT_PLAIN, true>);
+	frg_fn_repo_register_iterator(itr, "julia3-double", iterate<double, 3, VARIANT_PLAIN, true>);
+	frg_fn_repo_register_iterator(itr, "burning-ship-julia-double",
+		iterate<double, 2, VARIANT_BURNING_SHIP, true>);
+
+	frg_fn_repo_register_points(itr, "mandelbrot-double", points<double, 2, VARIANT_PLAIN, false>);
+	frg_fn_repo_register_points(itr, "mandelbrot-float", points<float, 2, VARIANT_PLAIN, false>);
+	frg_fn_repo_register_points(itr, "multibrot3-double", points<double, 3, VARIANT_PLAIN, false>);
+	frg_fn_repo_register_points(itr, "multibrot4-double", points<double, 4, VARIANT_PLAIN, false>);
+	frg_fn_repo_register_points(itr, "tricorn-double", points<double, 2, VARIANT_TRICORN, false>);
+	frg_fn_repo_register_points(itr, "burning-ship-double",
+		points<double, 2, VARIANT_BURNING_SHIP, false>);
+	frg_fn_repo_register_points(itr, "julia-float", points<float, 2, VARIANT_PLAIN, true>);
+	frg_fn_repo_register_points(itr, "julia-double", points<double, 2, VARIANT_PLAIN, true>);
+	frg_fn_repo_register_points(itr, "julia3-double", points<double, 3, VARIANT_PLAIN, true>);
+	frg_fn_repo_register_points(itr, "burning-ship-julia-double",
+		points<double, 2, VARIANT_BURNING_SHIP, true>);
+
+	frg_fn_repo_register_sweep(itr, "julia-float", sweep<float, 2, VARIANT_PLAIN>);
+	frg_fn_repo_register_sweep(itr, "julia-double", sweep<double, 2, VARIANT_PLAIN>);
+	frg_fn_repo_register_sweep(itr, "julia3-double", sweep<double, 3, VARIANT_PLAIN>);
+	frg_fn_repo_register_sweep(itr, "burning-ship-julia-double",
+		sweep<double, 2, VARIANT_BURNING_SHIP>);
+}
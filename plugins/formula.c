@@ -0,0 +1,815 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <ctype.h>
+#include <math.h>
+
+#include "fractalgen/plugin.h"
+#include "fractalgen/lock.h"
+#include "fractalgen/param_set.h"
+
+#include "debug.h"
+
+/* Iterates a formula given as a parameter, e.g. -Dformula="z = z^3 + c", in
+ * double precision.
+ *
+ * The formula is compiled into code for a small register machine. Every
+ * register holds LANES complex numbers, one per sample, so each instruction
+ * is a loop over a group of samples that the compiler turns into vector
+ * instructions, and the cost of dispatching it is shared among them.
+ * Registers 0 and 1 hold z and c, temporaries count up from 2 and constants
+ * down from the top.
+ *
+ * Samples count iterations for as long as |z| <= bailout, tested before each
+ * step, as the hand-written iterators do. Lanes that have escaped go on being
+ * stepped but no longer count. */
+
+#define LANES			(16)
+
+/* Iterations between checks whether any of LANES samples is still inside. */
+#define ESCAPE_CHECK_INTERVAL	(16)
+
+#define MAX_REGS		(32)
+#define MAX_CODE		(128)
+
+/* Whole powers up to this are multiplied out, others go through exp and
+ * log. */
+#define MAX_POWER		(64)
+
+#define REG_Z			(0)
+#define REG_C			(1)
+#define REG_TEMP		(2)
+
+enum formula_op {
+	OP_MOV,
+	OP_ADD,
+	OP_SUB,
+	OP_MUL,
+	OP_DIV,
+	OP_NEG,
+	OP_SQR,
+	OP_CONJ,
+	OP_FOLD,
+	OP_ABS,
+	OP_RE,
+	OP_IM,
+	OP_EXP,
+	OP_LOG,
+	OP_SIN,
+	OP_COS
+};
+
+struct insn_s {
+	unsigned char op;
+	unsigned char dst;
+	unsigned char a;
+	unsigned char b;
+};
+
+struct program_s {
+	struct insn_s code[MAX_CODE];
+	unsigned length;
+
+	/* Constants live in registers MAX_REGS - consts up to MAX_REGS. */
+	double const_re[MAX_REGS];
+	double const_im[MAX_REGS];
+	unsigned consts;
+};
+
+struct lanes_s {
+	double re[MAX_REGS][LANES];
+	double im[MAX_REGS][LANES];
+};
+
+/* A value while compiling: a register, or a constant not yet given one. */
+struct operand_s {
+	int reg;
+	int is_const;
+	double re;
+	double im;
+};
+
+struct parser_s {
+	const char *text;
+	const char *p;
+	struct program_s *prog;
+	unsigned temps;
+	const char *error;
+	const char *error_at;
+};
+
+static inline void c_mov(double ar, double ai, double br, double bi, double *r, double *i)
+{
+	(void)br;
+	(void)bi;
+	*r = ar;
+	*i = ai;
+}
+
+static inline void c_add(double ar, double ai, double br, double bi, double *r, double *i)
+{
+	*r = ar + br;
+	*i = ai + bi;
+}
+
+static inline void c_sub(double ar, double ai, double br, double bi, double *r, double *i)
+{
+	*r = ar - br;
+	*i = ai - bi;
+}
+
+static inline void c_mul(double ar, double ai, double br, double bi, double *r, double *i)
+{
+	*r = ar * br - ai * bi;
+	*i = ar * bi + ai * br;
+}
+
+static inline void c_div(double ar, double ai, double br, double bi, double *r, double *i)
+{
+	double d = br * br + bi * bi;
+
+	*r = (ar * br + ai * bi) / d;
+	*i = (ai * br - ar * bi) / d;
+}
+
+static inline void c_neg(double ar, double ai, double br, double bi, double *r, double *i)
+{
+	(void)br;
+	(void)bi;
+	*r = -ar;
+	*i = -ai;
+}
+
+static inline void c_sqr(double ar, double ai, double br, double bi, double *r, double *i)
+{
+	(void)br;
+	(void)bi;
+	*r = ar * ar - ai * ai;
+	*i = 2.0 * ar * ai;
+}
+
+static inline void c_conj(double ar, double ai, double br, double bi, double *r, double *i)
+{
+	(void)br;
+	(void)bi;
+	*r = ar;
+	*i = -ai;
+}
+
+/* |re| + |im| i, as the burning ship takes before squaring. */
+static inline void c_fold(double ar, double ai, double br, double bi, double *r, double *i)
+{
+	(void)br;
+	(void)bi;
+	*r = fabs(ar);
+	*i = fabs(ai);
+}
+
+static inline void c_abs(double ar, double ai, double br, double bi, double *r, double *i)
+{
+	(void)br;
+	(void)bi;
+	*r = sqrt(ar * ar + ai * ai);
+	*i = 0.0;
+}
+
+static inline void c_re(double ar, double ai, double br, double bi, double *r, double *i)
+{
+	(void)ai;
+	(void)br;
+	(void)bi;
+	*r = ar;
+	*i = 0.0;
+}
+
+static inline void c_im(double ar, double ai, double br, double bi, double *r, double *i)
+{
+	(void)ar;
+	(void)br;
+	(void)bi;
+	*r = ai;
+	*i = 0.0;
+}
+
+static inline void c_exp(double ar, double ai, double br, double bi, double *r, double *i)
+{
+	double m = exp(ar);
+
+	(void)br;
+	(void)bi;
+	*r = m * cos(ai);
+	*i = m * sin(ai);
+}
+
+static inline void c_log(double ar, double ai, double br, double bi, double *r, double *i)
+{
+	(void)br;
+	(void)bi;
+	*r = 0.5 * log(ar * ar + ai * ai);
+	*i = atan2(ai, ar);
+}
+
+static inline void c_sin(double ar, double ai, double br, double bi, double *r, double *i)
+{
+	(void)br;
+	(void)bi;
+	*r = sin(ar) * cosh(ai);
+	*i = cos(ar) * sinh(ai);
+}
+
+static inline void c_cos(double ar, double ai, double br, double bi, double *r, double *i)
+{
+	(void)br;
+	(void)bi;
+	*r = cos(ar) * cosh(ai);
+	*i = -sin(ar) * sinh(ai);
+}
+
+/* Results go to locals first, so that the loop vectorises even where the
+ * destination is one of the operands. */
+#define LANE_LOOP(__fn)								\
+	do {									\
+		for (l = 0; l < LANES; l++)					\
+			__fn(ar[l], ai[l], br[l], bi[l], &tr[l], &ti[l]);	\
+		memcpy(r->re[in->dst], tr, sizeof(tr));				\
+		memcpy(r->im[in->dst], ti, sizeof(ti));				\
+	} while (0)
+
+static void run(const struct program_s *prog, struct lanes_s *r)
+{
+	const struct insn_s *in;
+	const double *ar;
+	const double *ai;
+	const double *br;
+	const double *bi;
+	double tr[LANES];
+	double ti[LANES];
+	size_t l;
+
+	for (in = prog->code; in < prog->code + prog->length; in++) {
+		ar = r->re[in->a];
+		ai = r->im[in->a];
+		br = r->re[in->b];
+		bi = r->im[in->b];
+
+		switch (in->op) {
+		case OP_MOV:	LANE_LOOP(c_mov); break;
+		case OP_ADD:	LANE_LOOP(c_add); break;
+		case OP_SUB:	LANE_LOOP(c_sub); break;
+		case OP_MUL:	LANE_LOOP(c_mul); break;
+		case OP_DIV:	LANE_LOOP(c_div); break;
+		case OP_NEG:	LANE_LOOP(c_neg); break;
+		case OP_SQR:	LANE_LOOP(c_sqr); break;
+		case OP_CONJ:	LANE_LOOP(c_conj); break;
+		case OP_FOLD:	LANE_LOOP(c_fold); break;
+		case OP_ABS:	LANE_LOOP(c_abs); break;
+		case OP_RE:	LANE_LOOP(c_re); break;
+		case OP_IM:	LANE_LOOP(c_im); break;
+		case OP_EXP:	LANE_LOOP(c_exp); break;
+		case OP_LOG:	LANE_LOOP(c_log); break;
+		case OP_SIN:	LANE_LOOP(c_sin); break;
+		case OP_COS:	LANE_LOOP(c_cos); break;
+		}
+	}
+}
+
+/* The same operation on one pair of constants, to fold them while
+ * compiling. */
+static void fold_const(enum formula_op op, const struct operand_s *a, const struct operand_s *b,
+	struct operand_s *ret)
+{
+	double *r = &ret->re;
+	double *i = &ret->im;
+
+	ret->reg = -1;
+	ret->is_const = 1;
+
+	switch (op) {
+	case OP_MOV:	c_mov(a->re, a->im, b->re, b->im, r, i); break;
+	case OP_ADD:	c_add(a->re, a->im, b->re, b->im, r, i); break;
+	case OP_SUB:	c_sub(a->re, a->im, b->re, b->im, r, i); break;
+	case OP_MUL:	c_mul(a->re, a->im, b->re, b->im, r, i); break;
+	case OP_DIV:	c_div(a->re, a->im, b->re, b->im, r, i); break;
+	case OP_NEG:	c_neg(a->re, a->im, b->re, b->im, r, i); break;
+	case OP_SQR:	c_sqr(a->re, a->im, b->re, b->im, r, i); break;
+	case OP_CONJ:	c_conj(a->re, a->im, b->re, b->im, r, i); break;
+	case OP_FOLD:	c_fold(a->re, a->im, b->re, b->im, r, i); break;
+	case OP_ABS:	c_abs(a->re, a->im, b->re, b->im, r, i); break;
+	case OP_RE:	c_re(a->re, a->im, b->re, b->im, r, i); break;
+	case OP_IM:	c_im(a->re, a->im, b->re, b->im, r, i); break;
+	case OP_EXP:	c_exp(a->re, a->im, b->re, b->im, r, i); break;
+	case OP_LOG:	c_log(a->re, a->im, b->re, b->im, r, i); break;
+	case OP_SIN:	c_sin(a->re, a->im, b->re, b->im, r, i); break;
+	case OP_COS:	c_cos(a->re, a->im, b->re, b->im, r, i); break;
+	}
+}
+
+static struct operand_s constant(double re, double im)
+{
+	struct operand_s ret;
+
+	ret.reg = -1;
+	ret.is_const = 1;
+	ret.re = re;
+	ret.im = im;
+
+	return ret;
+}
+
+static struct operand_s reg(int r)
+{
+	struct operand_s ret;
+
+	ret.reg = r;
+	ret.is_const = 0;
+	ret.re = 0.0;
+	ret.im = 0.0;
+
+	return ret;
+}
+
+static void fail(struct parser_s *p, const char *error)
+{
+	if (!p->error) {
+		p->error = error;
+		p->error_at = p->p;
+	}
+}
+
+static int is_temp(const struct parser_s *p, int r)
+{
+	return r >= REG_TEMP && r < (int)(MAX_REGS - p->prog->consts);
+}
+
+/* Puts a constant in a register of its own, or one it already has. */
+static int const_reg(struct parser_s *p, const struct operand_s *a)
+{
+	struct program_s *prog = p->prog;
+	unsigned k;
+
+	for (k = 0; k < prog->consts; k++) {
+		if (prog->const_re[k] == a->re && prog->const_im[k] == a->im)
+			return MAX_REGS - 1 - k;
+	}
+
+	if (REG_TEMP + p->temps >= MAX_REGS - prog->consts - 1) {
+		fail(p, "formula too long");
+		return REG_Z;
+	}
+
+	prog->const_re[prog->consts] = a->re;
+	prog->const_im[prog->consts] = a->im;
+
+	return MAX_REGS - 1 - prog->consts++;
+}
+
+/* Appends op on a and b, which for unary operations is a again. Temporaries
+ * are handed out like a stack, so those of the operands are free again once
+ * the operation has read them, apart from keep, which is read again later. */
+static struct operand_s emit(struct parser_s *p, enum formula_op op, struct operand_s a,
+	struct operand_s b, const struct operand_s *keep)
+{
+	struct program_s *prog = p->prog;
+	struct insn_s *in;
+	struct operand_s ret;
+	unsigned top = p->temps;
+
+	if (a.is_const && b.is_const) {
+		fold_const(op, &a, &b, &ret);
+		return ret;
+	}
+
+	if (a.is_const)
+		a.reg = const_reg(p, &a);
+	if (b.is_const)
+		b.reg = const_reg(p, &b);
+
+	if (is_temp(p, a.reg) && (!keep || keep->reg != a.reg) && (unsigned)(a.reg - REG_TEMP) < top)
+		top = a.reg - REG_TEMP;
+	if (is_temp(p, b.reg) && (!keep || keep->reg != b.reg) && (unsigned)(b.reg - REG_TEMP) < top)
+		top = b.reg - REG_TEMP;
+
+	if (prog->length == MAX_CODE || REG_TEMP + top >= MAX_REGS - prog->consts) {
+		fail(p, "formula too long");
+		return reg(REG_Z);
+	}
+
+	in = &prog->code[prog->length++];
+	in->op = (unsigned char)op;
+	in->dst = (unsigned char)(REG_TEMP + top);
+	in->a = (unsigned char)a.reg;
+	in->b = (unsigned char)b.reg;
+	p->temps = top + 1;
+
+	return reg(in->dst);
+}
+
+static struct operand_s unary(struct parser_s *p, enum formula_op op, struct operand_s a)
+{
+	return emit(p, op, a, a, NULL);
+}
+
+/* Square and multiply, from the highest bit down. */
+static struct operand_s whole_power(struct parser_s *p, struct operand_s base, long n)
+{
+	struct operand_s ret;
+	unsigned long m = (unsigned long)labs(n);
+	int bit;
+
+	if (!m)
+		return constant(1.0, 0.0);
+
+	for (bit = 0; m >> (bit + 1); bit++)
+		;
+
+	ret = base;
+	while (bit--) {
+		ret = emit(p, OP_SQR, ret, ret, &base);
+		if (m & (1ul << bit))
+			ret = emit(p, OP_MUL, ret, base, &base);
+	}
+
+	if (n < 0)
+		ret = emit(p, OP_DIV, constant(1.0, 0.0), ret, NULL);
+
+	return ret;
+}
+
+static struct operand_s power(struct parser_s *p, struct operand_s base, struct operand_s e)
+{
+	if (e.is_const && e.im == 0.0 && e.re == floor(e.re) && fabs(e.re) <= MAX_POWER)
+		return whole_power(p, base, (long)e.re);
+
+	/* base^e = exp(e log(base)) */
+	return unary(p, OP_EXP, emit(p, OP_MUL, e, unary(p, OP_LOG, base), NULL));
+}
+
+static void skip_space(struct parser_s *p)
+{
+	while (isspace((unsigned char)*p->p))
+		p->p++;
+}
+
+static int accept(struct parser_s *p, char c)
+{
+	skip_space(p);
+
+	if (*p->p != c)
+		return 0;
+
+	p->p++;
+	return 1;
+}
+
+static struct operand_s parse_sum(struct parser_s *p);
+static struct operand_s parse_unary(struct parser_s *p);
+
+static const struct {
+	const char *name;
+	enum formula_op op;
+} functions[] = {
+	{ "sqr", OP_SQR },
+	{ "conj", OP_CONJ },
+	{ "fold", OP_FOLD },
+	{ "abs", OP_ABS },
+	{ "re", OP_RE },
+	{ "im", OP_IM },
+	{ "exp", OP_EXP },
+	{ "log", OP_LOG },
+	{ "sin", OP_SIN },
+	{ "cos", OP_COS },
+};
+
+static struct operand_s parse_primary(struct parser_s *p)
+{
+	struct operand_s ret;
+	const char *start;
+	char *end;
+	size_t length;
+	size_t k;
+	double d;
+
+	skip_space(p);
+	start = p->p;
+
+	if (accept(p, '(')) {
+		ret = parse_sum(p);
+		if (!accept(p, ')'))
+			fail(p, "expected ')'");
+		return ret;
+	}
+
+	if (isdigit((unsigned char)*p->p) || *p->p == '.') {
+		d = strtod(p->p, &end);
+		if (end == p->p) {
+			fail(p, "bad number");
+			return reg(REG_Z);
+		}
+
+		p->p = end;
+		if (*p->p == 'i' && !isalnum((unsigned char)p->p[1])) {
+			p->p++;
+			return constant(0.0, d);
+		}
+
+		return constant(d, 0.0);
+	}
+
+	while (isalnum((unsigned char)*p->p))
+		p->p++;
+	length = (size_t)(p->p - start);
+
+	if (length == 1 && *start == 'z')
+		return reg(REG_Z);
+	if (length == 1 && *start == 'c')
+		return reg(REG_C);
+	if (length == 1 && *start == 'i')
+		return constant(0.0, 1.0);
+
+	for (k = 0; k < sizeof(functions) / sizeof(functions[0]); k++) {
+		if (strlen(functions[k].name) != length || strncmp(functions[k].name, start, length))
+			continue;
+
+		if (!accept(p, '(')) {
+			fail(p, "expected '('");
+			return reg(REG_Z);
+		}
+
+		ret = parse_sum(p);
+		if (!accept(p, ')'))
+			fail(p, "expected ')'");
+
+		return unary(p, functions[k].op, ret);
+	}
+
+	p->p = start;
+	fail(p, length ? "unknown name" : "expected a value");
+
+	return reg(REG_Z);
+}
+
+/* Right associative and above unary minus, so -z^2^3 is -(z^(2^3)). */
+static struct operand_s parse_power(struct parser_s *p)
+{
+	struct operand_s base = parse_primary(p);
+
+	if (!accept(p, '^'))
+		return base;
+
+	return power(p, base, parse_unary(p));
+}
+
+static struct operand_s parse_unary(struct parser_s *p)
+{
+	if (accept(p, '-'))
+		return unary(p, OP_NEG, parse_unary(p));
+	if (accept(p, '+'))
+		return parse_unary(p);
+
+	return parse_power(p);
+}
+
+static struct operand_s parse_product(struct parser_s *p)
+{
+	struct operand_s ret = parse_unary(p);
+
+	while (!p->error) {
+		if (accept(p, '*'))
+			ret = emit(p, OP_MUL, ret, parse_unary(p), NULL);
+		else if (accept(p, '/'))
+			ret = emit(p, OP_DIV, ret, parse_unary(p), NULL);
+		else
+			break;
+	}
+
+	return ret;
+}
+
+static struct operand_s parse_sum(struct parser_s *p)
+{
+	struct operand_s ret = parse_product(p);
+
+	while (!p->error) {
+		if (accept(p, '+'))
+			ret = emit(p, OP_ADD, ret, parse_product(p), NULL);
+		else if (accept(p, '-'))
+			ret = emit(p, OP_SUB, ret, parse_product(p), NULL);
+		else
+			break;
+	}
+
+	return ret;
+}
+
+/* Compiles text, optionally led by "z =", into code that leaves its value in
+ * z. Returns why it can't, and sets column to where from 1 or to 0 if it is
+ * not one place, or returns NULL. */
+static const char * translate(struct program_s *prog, const char *text, int *column)
+{
+	struct parser_s p;
+	struct operand_s ret;
+
+	memset(prog, 0, sizeof(*prog));
+	p.text = text;
+	p.p = text;
+	p.prog = prog;
+	p.temps = 0;
+	p.error = NULL;
+	p.error_at = NULL;
+
+	skip_space(&p);
+	if (p.p[0] == 'z') {
+		p.p++;
+		if (!accept(&p, '='))
+			p.p = text;
+	}
+
+	ret = parse_sum(&p);
+	skip_space(&p);
+	if (*p.p)
+		fail(&p, "expected an operator");
+
+	if (p.error) {
+		*column = (int)(p.error_at - text) + 1;
+		return p.error;
+	}
+
+	/* The last instruction computes the whole formula. It reads all it needs
+	 * before it writes, so it may as well write z itself. */
+	if (!ret.is_const && ret.reg != REG_Z && prog->length
+			&& prog->code[prog->length - 1].dst == ret.reg) {
+		prog->code[prog->length - 1].dst = REG_Z;
+	} else {
+		if (ret.is_const)
+			ret = reg(const_reg(&p, &ret));
+		ret = emit(&p, OP_MOV, ret, ret, NULL);
+		if (p.error) {
+			*column = 0;
+			return p.error;
+		}
+		prog->code[prog->length - 1].dst = REG_Z;
+	}
+
+	return NULL;
+}
+
+/* Compiles text as translate does. Returns non-zero and explains why on
+ * stderr if it can't. */
+static int compile(struct program_s *prog, const char *name, const char *text)
+{
+	const char *error;
+	int column;
+
+	if (!(error = translate(prog, text, &column)))
+		return 0;
+
+	if (column)
+		fprintf(stderr, "formula: %s at column %d of %s \"%s\"\n", error, column, name, text);
+	else
+		fprintf(stderr, "formula: %s in %s \"%s\"\n", error, name, text);
+
+	return 1;
+}
+
+struct formula_s {
+	char *step_text;
+	char *init_text;
+	struct program_s step;
+	struct program_s init;
+	int broken;
+};
+
+/* Hosts ask for many requests with the same parameters. The last formula is
+ * kept, so it is compiled, and any error reported, only once. */
+static struct frg_lock_s *formula_lock;
+static struct formula_s formula_cached;
+
+static char * copy_text(const char *text)
+{
+	size_t length = strlen(text) + 1;
+
+	return memcpy(malloc(length), text, length);
+}
+
+static int formula_get(struct formula_s *f, const char *step_text, const char *init_text)
+{
+	struct formula_s *cached = &formula_cached;
+
+	frg_lock(formula_lock);
+
+	if (!cached->step_text || strcmp(cached->step_text, step_text)
+			|| strcmp(cached->init_text, init_text)) {
+		free(cached->step_text);
+		free(cached->init_text);
+		cached->step_text = copy_text(step_text);
+		cached->init_text = copy_text(init_text);
+		cached->broken = compile(&cached->step, "formula", step_text)
+			|| compile(&cached->init, "z0", init_text);
+		dbg_printf("Formula of %u instructions, z0 of %u\n", cached->step.length,
+			cached->init.length);
+	}
+
+	*f = *cached;
+
+	frg_unlock(formula_lock);
+
+	return f->broken;
+}
+
+static void load_consts(const struct program_s *prog, struct lanes_s *r)
+{
+	unsigned k;
+	size_t l;
+
+	for (k = 0; k < prog->consts; k++) {
+		for (l = 0; l < LANES; l++) {
+			r->re[MAX_REGS - 1 - k][l] = prog->const_re[k];
+			r->im[MAX_REGS - 1 - k][l] = prog->const_im[k];
+		}
+	}
+}
+
+static void iterate_lanes(const struct formula_s *f, struct lanes_s *r, unsigned *count,
+	unsigned iterations, double bailout_sqr)
+{
+	unsigned active[LANES];
+	unsigned any_active;
+	const double *zr = r->re[REG_Z];
+	const double *zi = r->im[REG_Z];
+	unsigned i;
+	unsigned k;
+	size_t l;
+
+	memset(r->re[REG_Z], 0, sizeof(r->re[REG_Z]));
+	memset(r->im[REG_Z], 0, sizeof(r->im[REG_Z]));
+	load_consts(&f->init, r);
+	run(&f->init, r);
+	load_consts(&f->step, r);
+
+	for (l = 0; l < LANES; l++) {
+		active[l] = 1;
+		count[l] = 0;
+	}
+
+	for (i = 0; i < iterations; i += ESCAPE_CHECK_INTERVAL) {
+		for (k = 0; k < ESCAPE_CHECK_INTERVAL && i + k < iterations; k++) {
+			for (l = 0; l < LANES; l++) {
+				active[l] &= zr[l] * zr[l] + zi[l] * zi[l] <= bailout_sqr;
+				count[l] += active[l];
+			}
+
+			run(&f->step, r);
+		}
+
+		any_active = 0;
+		for (l = 0; l < LANES; l++)
+			any_active |= active[l];
+		if (!any_active)
+			break;
+	}
+}
+
+static void iterate(
+	const struct frg_iteration_request_s *spec,
+	unsigned * restrict iterations,
+	const struct frg_param_set_s *params)
+{
+	struct formula_s f;
+	struct lanes_s r;
+	unsigned count[LANES];
+	double bailout;
+	size_t row;
+	size_t col;
+	size_t src_col;
+	size_t l;
+
+	if (formula_get(&f, param_set_get_str_d(params, "formula", "z^2 + c"),
+			param_set_get_str_d(params, "z0", "c"))) {
+		memset(iterations, 0, (size_t)spec->rows * spec->cols * sizeof(*iterations));
+		return;
+	}
+
+	bailout = param_set_get_double_d(params, "bailout", 2.0);
+
+	for (row = 0; row < spec->rows; row++) {
+		for (col = 0; col < spec->cols; col += LANES) {
+			for (l = 0; l < LANES; l++) {
+				src_col = (col + l < spec->cols) ? col + l : (size_t)spec->cols - 1;
+				r.re[REG_C][l] = spec->from_x + spec->step * src_col;
+				r.im[REG_C][l] = spec->from_y + spec->step * row;
+			}
+
+			iterate_lanes(&f, &r, count, spec->iterations, bailout * bailout);
+
+			for (l = 0; l < LANES && col + l < spec->cols; l++)
+				iterations[row * spec->cols + col + l] = count[l];
+		}
+	}
+}
+
+extern void frg_module_init(struct frg_render_fn_repo_s *itr)
+{
+	formula_lock = frg_lock_new();
+
+	frg_fn_repo_register_iterator(itr, "formula", iterate);
+}
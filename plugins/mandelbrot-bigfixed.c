@@ -0,0 +1,462 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+
+#include "fractalgen/plugin.h"
+#include "fractalgen/param_set.h"
+#include "big_fixed.h"
+
+#include "debug.h"
+
+/* Brute force arbitrary precision iteration. Slow, but does not glitch, so it
+ * doubles as a reference for faster iterators.
+ *
+ * Numbers are fixed point two's complement with a single integral uint32_t,
+ * which is plenty since nothing above 8 is ever computed before a point is
+ * known to escape. LANES pixels are iterated at once and their numbers are
+ * stored limb-major: uint32_t k of pixels 0..LANES-1 is contiguous, so every
+ * inner loop below is an operation across pixels and vectorises. */
+
+#define LANES	(8)
+
+#define LIMB(__arr, __k)	((__arr) + (__k) * LANES)
+
+struct bf_block_s {
+	size_t u32s;		/* Length of a number. Last one is integral. */
+	uint32_t *cx;
+	uint32_t *cy;
+	uint32_t *x;
+	uint32_t *y;
+	uint32_t *abs_x;
+	uint32_t *abs_y;
+	uint32_t *x_sqr;
+	uint32_t *y_sqr;
+	uint32_t *xy;
+	uint32_t *tmp;
+	uint64_t *acc;		/* u32s + 2 columns of partial products. */
+	uint32_t neg_x[LANES];
+	uint32_t neg_y[LANES];
+	uint32_t active[LANES];
+	unsigned iterations[LANES];
+};
+
+static void block_init(struct bf_block_s *b, size_t u32s)
+{
+	uint32_t *buf;
+	size_t len;
+
+	len = u32s * LANES;
+	buf = malloc(10 * len * sizeof(buf[0]));
+
+	b->u32s = u32s;
+	b->cx = buf;
+	b->cy = b->cx + len;
+	b->x = b->cy + len;
+	b->y = b->x + len;
+	b->abs_x = b->y + len;
+	b->abs_y = b->abs_x + len;
+	b->x_sqr = b->abs_y + len;
+	b->y_sqr = b->x_sqr + len;
+	b->xy = b->y_sqr + len;
+	b->tmp = b->xy + len;
+	b->acc = malloc((u32s + 2) * LANES * sizeof(b->acc[0]));
+}
+
+static void block_free(struct bf_block_s *b)
+{
+	free(b->cx);
+	free(b->acc);
+}
+
+static void lanes_add(uint32_t * restrict dest, const uint32_t * restrict a,
+	const uint32_t * restrict b, size_t u32s)
+{
+	uint64_t carry[LANES] = { 0 };
+	size_t k;
+	size_t l;
+
+	for (k = 0; k < u32s; k++) {
+		for (l = 0; l < LANES; l++) {
+			carry[l] += (uint64_t)LIMB(a, k)[l] + LIMB(b, k)[l];
+			LIMB(dest, k)[l] = (uint32_t)carry[l];
+			carry[l] >>= 32;
+		}
+	}
+}
+
+static void lanes_sub(uint32_t * restrict dest, const uint32_t * restrict a,
+	const uint32_t * restrict b, size_t u32s)
+{
+	uint64_t diff[LANES];
+	uint64_t borrow[LANES] = { 0 };
+	size_t k;
+	size_t l;
+
+	for (k = 0; k < u32s; k++) {
+		for (l = 0; l < LANES; l++) {
+			diff[l] = (uint64_t)LIMB(a, k)[l] - LIMB(b, k)[l] - borrow[l];
+			LIMB(dest, k)[l] = (uint32_t)diff[l];
+			borrow[l] = (diff[l] >> 32) & 1;
+		}
+	}
+}
+
+/* Negates lanes flagged in neg. */
+static void lanes_cond_neg(uint32_t * restrict dest, const uint32_t * restrict src,
+	const uint32_t * restrict neg, size_t u32s)
+{
+	uint64_t carry[LANES];
+	uint32_t mask[LANES];
+	size_t k;
+	size_t l;
+
+	for (l = 0; l < LANES; l++) {
+		mask[l] = -neg[l];
+		carry[l] = neg[l];
+	}
+
+	for (k = 0; k < u32s; k++) {
+		for (l = 0; l < LANES; l++) {
+			carry[l] += LIMB(src, k)[l] ^ mask[l];
+			LIMB(dest, k)[l] = (uint32_t)carry[l];
+			carry[l] >>= 32;
+		}
+	}
+}
+
+static void lanes_abs(uint32_t * restrict dest, uint32_t * restrict neg,
+	const uint32_t * restrict src, size_t u32s)
+{
+	size_t l;
+
+	for (l = 0; l < LANES; l++)
+		neg[l] = LIMB(src, u32s - 1)[l] >> 31;
+
+	lanes_cond_neg(dest, src, neg, u32s);
+}
+
+/* Partial products are accumulated per column as 32 bit halves, so a 64 bit
+ * column cannot overflow and carries only need propagating once at the end.
+ * Columns that would be truncated away anyway are skipped, save for one that
+ * catches most of their carry. The result is at most a few units of the last
+ * place off. */
+static void acc_clear(uint64_t *acc, size_t u32s)
+{
+	memset(acc, 0, (u32s + 2) * LANES * sizeof(acc[0]));
+}
+
+static inline void acc_add(uint64_t * restrict acc, const uint32_t * restrict a,
+	const uint32_t * restrict b, size_t col, unsigned shift)
+{
+	uint64_t prod;
+	size_t l;
+
+	for (l = 0; l < LANES; l++) {
+		prod = (uint64_t)a[l] * b[l];
+		LIMB(acc, col)[l] += (prod & 0xFFFFFFFFULL) << shift;
+		LIMB(acc, col + 1)[l] += (prod >> 32) << shift;
+	}
+}
+
+static void acc_finish(uint32_t * restrict dest, uint64_t * restrict acc, size_t u32s)
+{
+	size_t k;
+	size_t l;
+
+	for (k = 0; k + 1 < u32s + 2; k++) {
+		for (l = 0; l < LANES; l++) {
+			LIMB(acc, k + 1)[l] += LIMB(acc, k)[l] >> 32;
+		}
+	}
+
+	for (k = 0; k < u32s; k++) {
+		for (l = 0; l < LANES; l++) {
+			LIMB(dest, k)[l] = (uint32_t)LIMB(acc, k + 1)[l];
+		}
+	}
+}
+
+/* Product of two non-negative numbers. Column c of the product ends up in
+ * acc[c - (u32s - 2)]. */
+static void lanes_mul(uint32_t * restrict dest, const uint32_t * restrict a,
+	const uint32_t * restrict b, uint64_t * restrict acc, size_t u32s)
+{
+	size_t lo;
+	size_t i;
+	size_t j;
+
+	lo = u32s - 2;
+	acc_clear(acc, u32s);
+
+	for (i = 0; i < u32s; i++) {
+		for (j = (lo > i) ? lo - i : 0; j < u32s; j++) {
+			acc_add(acc, LIMB(a, i), LIMB(b, j), i + j - lo, 0);
+		}
+	}
+
+	acc_finish(dest, acc, u32s);
+}
+
+static void lanes_sqr(uint32_t * restrict dest, const uint32_t * restrict a,
+	uint64_t * restrict acc, size_t u32s)
+{
+	size_t lo;
+	size_t i;
+	size_t j;
+
+	lo = u32s - 2;
+	acc_clear(acc, u32s);
+
+	for (i = 0; i < u32s; i++) {
+		if (2 * i >= lo)
+			acc_add(acc, LIMB(a, i), LIMB(a, i), 2 * i - lo, 0);
+		j = (lo > 2 * i + 1) ? lo - i : i + 1;
+		for (; j < u32s; j++) {
+			acc_add(acc, LIMB(a, i), LIMB(a, j), i + j - lo, 1);
+		}
+	}
+
+	acc_finish(dest, acc, u32s);
+}
+
+static void lanes_shl1(uint32_t * restrict dest, const uint32_t * restrict src, size_t u32s)
+{
+	size_t k;
+	size_t l;
+
+	for (k = u32s; k-- > 1;) {
+		for (l = 0; l < LANES; l++) {
+			LIMB(dest, k)[l] = (LIMB(src, k)[l] << 1) | (LIMB(src, k - 1)[l] >> 31);
+		}
+	}
+
+	for (l = 0; l < LANES; l++)
+		dest[l] = src[l] << 1;
+}
+
+/* |z|^2 <= 4 for every lane. Both squares are non-negative. */
+static void lanes_inside(uint32_t * restrict inside, const uint32_t * restrict mag_sqr,
+	size_t u32s)
+{
+	uint32_t frac[LANES] = { 0 };
+	uint32_t integral;
+	size_t k;
+	size_t l;
+
+	for (k = 0; k + 1 < u32s; k++) {
+		for (l = 0; l < LANES; l++) {
+			frac[l] |= LIMB(mag_sqr, k)[l];
+		}
+	}
+
+	for (l = 0; l < LANES; l++) {
+		integral = LIMB(mag_sqr, u32s - 1)[l];
+		inside[l] = integral < 4 || (integral == 4 && !frac[l]);
+	}
+}
+
+static void iterate_block(struct bf_block_s *b, unsigned itr_count)
+{
+	uint32_t inside[LANES];
+	uint32_t neg_xy[LANES];
+	uint32_t any_active;
+	unsigned i;
+	size_t n;
+	size_t l;
+
+	n = b->u32s;
+
+	memcpy(b->x, b->cx, n * LANES * sizeof(b->x[0]));
+	memcpy(b->y, b->cy, n * LANES * sizeof(b->y[0]));
+
+	for (l = 0; l < LANES; l++) {
+		b->iterations[l] = 0;
+		b->active[l] = 1;
+	}
+
+	for (i = 0; i < itr_count; i++) {
+		lanes_abs(b->abs_x, b->neg_x, b->x, n);
+		lanes_abs(b->abs_y, b->neg_y, b->y, n);
+		lanes_sqr(b->x_sqr, b->abs_x, b->acc, n);
+		lanes_sqr(b->y_sqr, b->abs_y, b->acc, n);
+
+		lanes_add(b->tmp, b->x_sqr, b->y_sqr, n);
+		lanes_inside(inside, b->tmp, n);
+
+		any_active = 0;
+		for (l = 0; l < LANES; l++) {
+			b->active[l] &= inside[l];
+			b->iterations[l] += b->active[l];
+			any_active |= b->active[l];
+		}
+
+		if (!any_active)
+			break;
+
+		/* y = 2xy + cy */
+		lanes_mul(b->xy, b->abs_x, b->abs_y, b->acc, n);
+		lanes_shl1(b->tmp, b->xy, n);
+		for (l = 0; l < LANES; l++)
+			neg_xy[l] = b->neg_x[l] ^ b->neg_y[l];
+		lanes_cond_neg(b->xy, b->tmp, neg_xy, n);
+		lanes_add(b->y, b->xy, b->cy, n);
+
+		/* x = x^2 - y^2 + cx */
+		lanes_sub(b->tmp, b->x_sqr, b->y_sqr, n);
+		lanes_add(b->x, b->tmp, b->cx, n);
+	}
+}
+
+/* Coordinate of the first sample and distance between samples. */
+struct bf_grid_s {
+	struct big_fixed from_x;
+	struct big_fixed from_y;
+	struct big_fixed step;
+	size_t frac;
+};
+
+static size_t default_frac_u32s(double step)
+{
+	double bits;
+
+	bits = -log2(step) + 64.0;
+	if (bits < 64.0)
+		bits = 64.0;
+
+	return (size_t)ceil(bits / 32.0);
+}
+
+/* Sets f to centre + offset * step, with the host's centre if it has one and
+ * the request's doubles if not. */
+static void grid_origin(struct big_fixed *f, const struct big_fixed *centre_bf,
+	double centre_d, long offset, const struct big_fixed *step)
+{
+	struct big_fixed delta;
+	size_t frac;
+
+	frac = bf_frac_u32s(step);
+
+	bf_init_d(f, 1, frac, centre_d);
+	if (centre_bf)
+		bf_set(f, centre_bf);
+
+	bf_init_u64(&delta, 2, frac, (uint64_t)labs(offset));
+	if (offset < 0)
+		bf_neg_i(&delta);
+	bf_mul_i(&delta, step);
+	bf_add_i(f, &delta);
+	bf_destroy(&delta);
+}
+
+static void grid_init(struct bf_grid_s *g, const struct frg_iteration_request_s *spec,
+	const struct frg_param_set_s *params)
+{
+	double bits;
+
+	bits = param_set_get_double_d(params, "bf-precision", 0.0);
+	if (bits >= 1.0)
+		g->frac = (size_t)ceil(bits / 32.0);
+	else if (spec->step_bf)
+		g->frac = bf_frac_u32s(spec->step_bf);
+	else
+		g->frac = default_frac_u32s(spec->step);
+
+	bf_init_d(&g->step, 1, g->frac, spec->step);
+	if (spec->step_bf)
+		bf_set(&g->step, spec->step_bf);
+
+	grid_origin(&g->from_x, spec->centre_x, spec->from_x - spec->col_offset * spec->step,
+		spec->col_offset, &g->step);
+	grid_origin(&g->from_y, spec->centre_y, spec->from_y - spec->row_offset * spec->step,
+		spec->row_offset, &g->step);
+}
+
+static void grid_destroy(struct bf_grid_s *g)
+{
+	bf_destroy(&g->from_x);
+	bf_destroy(&g->from_y);
+	bf_destroy(&g->step);
+}
+
+/* Two's complement limbs of the real coordinate of every column. */
+static uint32_t * grid_columns(const struct bf_grid_s *g, size_t cols, size_t u32s)
+{
+	struct big_fixed x;
+	uint32_t *ret;
+	size_t i;
+
+	ret = malloc(cols * u32s * sizeof(ret[0]));
+	bf_init(&x, 1, g->frac);
+	bf_set(&x, &g->from_x);
+
+	for (i = 0; i < cols; i++) {
+		bf_to_twos_u32(&x, ret + i * u32s, u32s, g->frac, 1);
+		bf_add_i(&x, &g->step);
+	}
+
+	bf_destroy(&x);
+
+	return ret;
+}
+
+static void iterate_mandelbrot(
+	const struct frg_iteration_request_s *spec,
+	unsigned * restrict iterations,
+	const struct frg_param_set_s *params)
+{
+	struct bf_grid_s grid;
+	struct bf_block_s block;
+	struct big_fixed y;
+	uint32_t *columns;
+	size_t u32s;
+	size_t row;
+	size_t col;
+	size_t k;
+	size_t l;
+	size_t src_col;
+
+	grid_init(&grid, spec, params);
+	u32s = grid.frac + 1;
+
+	dbg_printf("Iterating with %zu fractional uint32_t's\n", grid.frac);
+
+	block_init(&block, u32s);
+	columns = grid_columns(&grid, spec->cols, u32s);
+	bf_init(&y, 1, grid.frac);
+	bf_set(&y, &grid.from_y);
+
+	for (row = 0; row < spec->rows; row++) {
+		bf_to_twos_u32(&y, block.cy, u32s, grid.frac, LANES);
+		for (k = 0; k < u32s; k++) {
+			for (l = 1; l < LANES; l++)
+				LIMB(block.cy, k)[l] = LIMB(block.cy, k)[0];
+		}
+
+		for (col = 0; col < spec->cols; col += LANES) {
+			for (l = 0; l < LANES; l++) {
+				src_col = (col + l < spec->cols) ? col + l : (size_t)spec->cols - 1;
+				for (k = 0; k < u32s; k++)
+					LIMB(block.cx, k)[l] = columns[src_col * u32s + k];
+			}
+
+			iterate_block(&block, spec->iterations);
+
+			for (l = 0; l < LANES && col + l < spec->cols; l++)
+				iterations[row * spec->cols + col + l] = block.iterations[l];
+		}
+
+		bf_add_i(&y, &grid.step);
+	}
+
+	bf_destroy(&y);
+	free(columns);
+	block_free(&block);
+	grid_destroy(&grid);
+}
+
+extern void frg_module_init(struct frg_render_fn_repo_s *itr)
+{
+	frg_fn_repo_register_iterator_flags(itr, "mandelbrot-bigfixed", iterate_mandelbrot,
+		FRG_ITERATOR_CONJ_SYMMETRIC | FRG_ITERATOR_MANDELBROT);
+}
@@ -0,0 +1,300 @@
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "fractalgen/plugin.h"
+#include "fractalgen/param_set.h"
+
+#include "cdouble.h"
+
+/* The exterior estimate is only right in the limit, so escaped points are
+ * followed out to this radius, or for this many more iterations. */
+#define DE_ESCAPE_RADIUS	(1024.0)
+#define DE_EXTRA_ITERATIONS	(64)
+
+/* Longest cycle looked for inside the set. */
+#define MAX_PERIOD			(4096)
+#define NEWTON_STEPS		(16)
+
+/* Samples are visited on a grid this coarse first and then on ever finer
+ * ones, so that the discs found early rule out much of what comes later. */
+#define COARSEST_STRIDE		(16)
+
+#define DE_MIN(__a, __b)	(((__a) < (__b)) ? (__a) : (__b))
+#define DE_MAX(__a, __b)	(((__a) > (__b)) ? (__a) : (__b))
+
+struct de_request_s {
+	const struct frg_iteration_request_s *spec;
+	unsigned *iterations;
+	float *distance;
+	unsigned char *done;
+	int prune_exterior;
+};
+
+/* Iterates z -> z^2 + c from z = c along with dz/dc. Returns the number of
+ * iterations spent inside the circle of radius 2. */
+static unsigned iterate_point(struct cdouble c, unsigned max, struct cdouble *z_ret,
+	struct cdouble *dz_ret)
+{
+	struct cdouble z;
+	struct cdouble dz;
+	unsigned n;
+
+	z = c;
+	dz.real = 1.0;
+	dz.img = 0.0;
+
+	for (n = 0; n < max && cd_magnitude_sqr(z) <= 4.0; n++) {
+		dz = cd_add_real(cd_mul_real(cd_mul(z, dz), 2.0), 1.0);
+		z = cd_add(cd_sqr(z), c);
+	}
+
+	*z_ret = z;
+	*dz_ret = dz;
+
+	return n;
+}
+
+/* 2 |z| ln|z| / |dz/dc|. The true distance lies between a quarter of this and
+ * all of it. */
+static double exterior_distance(struct cdouble c, struct cdouble z, struct cdouble dz)
+{
+	double abs_z;
+	unsigned n;
+
+	for (n = 0; n < DE_EXTRA_ITERATIONS
+			&& cd_magnitude_sqr(z) < DE_ESCAPE_RADIUS * DE_ESCAPE_RADIUS; n++) {
+		dz = cd_add_real(cd_mul_real(cd_mul(z, dz), 2.0), 1.0);
+		z = cd_add(cd_sqr(z), c);
+	}
+
+	abs_z = sqrt(cd_magnitude_sqr(z));
+
+	return 2.0 * abs_z * log(abs_z) / sqrt(cd_magnitude_sqr(dz));
+}
+
+/* The period p whose iterate comes closest to returning to z. */
+static unsigned guess_period(struct cdouble c, struct cdouble z, unsigned max_period)
+{
+	struct cdouble w;
+	double best;
+	double dist;
+	unsigned best_p;
+	unsigned p;
+
+	w = z;
+	best = INFINITY;
+	best_p = 0;
+
+	for (p = 1; p <= max_period; p++) {
+		w = cd_add(cd_sqr(w), c);
+		dist = cd_magnitude_sqr(cd_sub(w, z));
+
+		if (dist < best) {
+			best = dist;
+			best_p = p;
+		}
+	}
+
+	return best_p;
+}
+
+/* Interior distance estimate of a point whose orbit has settled on an
+ * attracting cycle. With z0 a point of the cycle of period p and all
+ * derivatives of f^p taken at z0:
+ *
+ * b = (1 - |dz|^2) / |dcdz + dzdz * dc / (1 - dz)|
+ *
+ * The true distance lies between b / 4 and b. Returns a negative number if no
+ * attracting cycle turns up. */
+static double interior_distance(struct cdouble c, struct cdouble z, unsigned max_period)
+{
+	struct cdouble dz;
+	struct cdouble dc;
+	struct cdouble dzdz;
+	struct cdouble dcdz;
+	struct cdouble w;
+	struct cdouble step;
+	struct cdouble one;
+	unsigned period;
+	unsigned i;
+	unsigned k;
+
+	one.real = 1.0;
+	one.img = 0.0;
+
+	period = guess_period(c, z, max_period);
+	if (!period)
+		return -1.0;
+
+	/* Newton on f^p(z) - z = 0 to land exactly on the cycle. */
+	for (k = 0; k < NEWTON_STEPS; k++) {
+		w = z;
+		dz = one;
+
+		for (i = 0; i < period; i++) {
+			dz = cd_mul_real(cd_mul(w, dz), 2.0);
+			w = cd_add(cd_sqr(w), c);
+		}
+
+		step = cd_div(cd_sub(w, z), cd_sub(dz, one));
+		z = cd_sub(z, step);
+
+		if (cd_magnitude_sqr(step) < 1e-28 * (1.0 + cd_magnitude_sqr(z)))
+			break;
+	}
+
+	/* The cycle repeats after any multiple of its period as well, but the
+	 * estimate only holds for the period itself. */
+	for (k = 1; k < period; k++) {
+		if (period % k)
+			continue;
+
+		w = z;
+		for (i = 0; i < k; i++)
+			w = cd_add(cd_sqr(w), c);
+
+		if (cd_magnitude_sqr(cd_sub(w, z)) < 1e-20 * (1.0 + cd_magnitude_sqr(z))) {
+			period = k;
+			break;
+		}
+	}
+
+	w = z;
+	dz = one;
+	dc.real = dc.img = 0.0;
+	dzdz = dc;
+	dcdz = dc;
+
+	for (i = 0; i < period; i++) {
+		dcdz = cd_mul_real(cd_add(cd_mul(dc, dz), cd_mul(w, dcdz)), 2.0);
+		dzdz = cd_mul_real(cd_add(cd_mul(dz, dz), cd_mul(w, dzdz)), 2.0);
+		dc = cd_add_real(cd_mul_real(cd_mul(w, dc), 2.0), 1.0);
+		dz = cd_mul_real(cd_mul(w, dz), 2.0);
+		w = cd_add(cd_sqr(w), c);
+	}
+
+	if (!(cd_magnitude_sqr(dz) < 1.0) || cd_magnitude_sqr(cd_sub(w, z)) > 1e-20)
+		return -1.0;
+
+	return (1.0 - cd_magnitude_sqr(dz))
+		/ sqrt(cd_magnitude_sqr(cd_add(dcdz, cd_div(cd_mul(dzdz, dc), cd_sub(one, dz)))));
+}
+
+/* Settles every sample not yet done within radius samples of (row, col).
+ * Interior samples get the full iteration count; exterior ones borrow the
+ * count of the centre. */
+static void mark_disc(struct de_request_s *req, long row, long col, double radius,
+	unsigned iterations, double distance)
+{
+	const struct frg_iteration_request_s *spec = req->spec;
+	long i;
+	long j;
+	long from;
+	long to;
+	long reach;
+	double span;
+	size_t idx;
+
+	if (radius < 1.0)
+		return;
+
+	reach = (long)DE_MIN(radius, (double)(spec->rows + spec->cols));
+
+	for (i = DE_MAX(row - reach, 0); i <= row + reach && i < spec->rows; i++) {
+		span = radius * radius - (double)(i - row) * (i - row);
+		if (span < 0.0)
+			continue;
+
+		span = sqrt(span);
+		from = DE_MAX(col - (long)span, 0);
+		to = DE_MIN(col + (long)span, (long)spec->cols - 1);
+
+		for (j = from; j <= to; j++) {
+			idx = (size_t)i * spec->cols + j;
+			if (req->done[idx])
+				continue;
+
+			req->done[idx] = 1;
+			req->iterations[idx] = iterations;
+			req->distance[idx] = distance ? (float)(distance
+				- sqrt((double)(i - row) * (i - row) + (double)(j - col) * (j - col))) : 0.0f;
+		}
+	}
+}
+
+static void compute_sample(struct de_request_s *req, long row, long col)
+{
+	const struct frg_iteration_request_s *spec = req->spec;
+	struct cdouble c;
+	struct cdouble z;
+	struct cdouble dz;
+	double dist;
+	unsigned n;
+	size_t idx;
+
+	c.real = spec->from_x + col * spec->step;
+	c.img = spec->from_y + row * spec->step;
+	idx = (size_t)row * spec->cols + col;
+
+	n = iterate_point(c, spec->iterations, &z, &dz);
+	req->iterations[idx] = n;
+	req->done[idx] = 1;
+
+	if (n < spec->iterations) {
+		dist = exterior_distance(c, z, dz) / spec->step;
+		req->distance[idx] = (float)dist;
+
+		if (req->prune_exterior)
+			mark_disc(req, row, col, dist / 4.0, n, dist);
+	} else {
+		req->distance[idx] = 0.0f;
+		dist = interior_distance(c, z, DE_MIN(spec->iterations, MAX_PERIOD));
+
+		if (dist > 0.0)
+			mark_disc(req, row, col, dist / spec->step / 4.0, spec->iterations, 0.0);
+	}
+}
+
+static void iterate_mandelbrot(
+	const struct frg_iteration_request_s *spec,
+	unsigned * restrict iterations,
+	const struct frg_param_set_s *params)
+{
+	struct de_request_s req;
+	float *own_distance = NULL;
+	size_t length;
+	long stride;
+	long i;
+	long j;
+
+	length = (size_t)spec->rows * spec->cols;
+
+	req.spec = spec;
+	req.iterations = iterations;
+	req.distance = spec->distance;
+	req.done = calloc(length, 1);
+	req.prune_exterior = param_set_get_double_d(params, "prune-exterior", 0.0) != 0.0;
+
+	if (!req.distance)
+		req.distance = own_distance = malloc(length * sizeof(*own_distance));
+
+	for (stride = COARSEST_STRIDE; stride; stride /= 2) {
+		for (i = 0; i < spec->rows; i += stride) {
+			for (j = 0; j < spec->cols; j += stride) {
+				if (!req.done[(size_t)i * spec->cols + j])
+					compute_sample(&req, i, j);
+			}
+		}
+	}
+
+	free(req.done);
+	free(own_distance);
+}
+
+extern void frg_module_init(struct frg_render_fn_repo_s *itr)
+{
+	frg_fn_repo_register_iterator_flags(itr, "mandelbrot-distance", iterate_mandelbrot,
+		FRG_ITERATOR_CONJ_SYMMETRIC | FRG_ITERATOR_DISTANCE
+		| FRG_ITERATOR_MANDELBROT);
+}
@@ -0,0 +1,456 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+
+#include "fractalgen/plugin.h"
+#include "fractalgen/lock.h"
+#include "big_fixed.h"
+#include "floatexp.h"
+
+#include "debug.h"
+
+/* Perturbation iteration for zooms of any depth.
+ *
+ * One reference orbit R is iterated at full precision from the centre of the
+ * viewport and rounded to doubles, which is fine since |R| <= 2. Every pixel
+ * only tracks its distance d from the reference:
+ *
+ *	z = R[n] + d
+ *	d' = 2 * R[n] * d + d^2 + dc
+ *
+ * Past 1e-308 d no longer fits a double, so blocks start out with d in
+ * floatexp and drop to plain doubles as soon as every d in the block is big
+ * enough. The reference starts with R[0] = 0, so a pixel whose distance grows
+ * larger than its value is rebased onto the start of the reference orbit
+ * (d = z, n = 0). That also carries pixels past the point where the
+ * reference escapes. */
+
+#define LANES	(8)
+
+/* Exponent above which d and d^2 are safe in a double. */
+#define DOUBLE_MIN_EXP	(-480)
+
+struct ref_orbit_s {
+	double *real;
+	double *img;
+	size_t len;
+
+	/* What the orbit was computed for. */
+	struct big_fixed cx;
+	struct big_fixed cy;
+	unsigned iterations;
+
+	/* Requests using the orbit, plus one while it is cached. */
+	unsigned users;
+};
+
+/* Hosts split a viewport into many requests around the same centre. The
+ * last orbit is kept so that only the first of them pays for it. */
+static struct frg_lock_s *ref_lock;
+static struct ref_orbit_s *ref_cached;
+
+struct pt_block_s {
+	/* Distance from the reference in floatexp. */
+	double dr_m[LANES];
+	int64_t dr_e[LANES];
+	double di_m[LANES];
+	int64_t di_e[LANES];
+	double dcr_m[LANES];
+	int64_t dcr_e[LANES];
+	double dci_m[LANES];
+	int64_t dci_e[LANES];
+
+	/* The same in doubles. */
+	double dr[LANES];
+	double di[LANES];
+	double dcr[LANES];
+	double dci[LANES];
+
+	size_t n[LANES];
+	unsigned active[LANES];
+	unsigned iterations[LANES];
+};
+
+static struct floatexp fe_from_bf(const struct big_fixed *f)
+{
+	long idx;
+	double m = 0.0;
+	int k;
+
+	for (idx = (long)f->i.arr.len - 1; idx >= 0 && !f->i.arr.buf[idx]; idx--)
+		;
+
+	if (idx < 0)
+		return fe_from_d(0.0);
+
+	for (k = 0; k < 3 && idx - k >= 0; k++)
+		m += ldexp((double)f->i.arr.buf[idx - k], -32 * k);
+
+	return fe_norm(f->neg ? -m : m, 32 * (idx - (long)bf_frac_u32s(f)));
+}
+
+/* R[0] = 0, R[k + 1] = R[k]^2 + C. Stops after the first point that escapes or
+ * once there is one point for every iteration. */
+static void ref_orbit_init(struct ref_orbit_s *ref, const struct big_fixed *cx,
+	const struct big_fixed *cy, size_t frac, unsigned iterations)
+{
+	struct big_fixed x;
+	struct big_fixed y;
+	struct big_fixed x_sqr;
+	struct big_fixed y_sqr;
+	size_t cap;
+	double xd;
+	double yd;
+
+	cap = (size_t)iterations + 2;
+	ref->real = malloc(cap * sizeof(ref->real[0]));
+	ref->img = malloc(cap * sizeof(ref->img[0]));
+	ref->real[0] = 0.0;
+	ref->img[0] = 0.0;
+	ref->len = 1;
+	ref->iterations = iterations;
+	ref->users = 0;
+
+	bf_init(&ref->cx, 1, frac);
+	bf_init(&ref->cy, 1, frac);
+	bf_set(&ref->cx, cx);
+	bf_set(&ref->cy, cy);
+
+	bf_init(&x, 2, frac);
+	bf_init(&y, 2, frac);
+	bf_init(&x_sqr, 2, frac);
+	bf_init(&y_sqr, 2, frac);
+	bf_set(&x, cx);
+	bf_set(&y, cy);
+
+	while (ref->len < cap) {
+		xd = bf_to_d(&x);
+		yd = bf_to_d(&y);
+		ref->real[ref->len] = xd;
+		ref->img[ref->len] = yd;
+		ref->len++;
+
+		if (xd * xd + yd * yd > 4.0)
+			break;
+
+		/* y = 2xy + cy, x = x^2 - y^2 + cx */
+		bf_set(&x_sqr, &x);
+		bf_mul_i(&x_sqr, &x);
+		bf_set(&y_sqr, &y);
+		bf_mul_i(&y_sqr, &y);
+		bf_mul_i(&y, &x);
+		bf_add_i(&y, &y);
+		bf_add_i(&y, cy);
+		bf_set(&x, &x_sqr);
+		bf_sub_i(&x, &y_sqr);
+		bf_add_i(&x, cx);
+	}
+
+	bf_destroy(&x);
+	bf_destroy(&y);
+	bf_destroy(&x_sqr);
+	bf_destroy(&y_sqr);
+}
+
+static void ref_orbit_free(struct ref_orbit_s *ref)
+{
+	free(ref->real);
+	free(ref->img);
+	bf_destroy(&ref->cx);
+	bf_destroy(&ref->cy);
+	free(ref);
+}
+
+static int ref_orbit_matches(const struct ref_orbit_s *ref, const struct big_fixed *cx,
+	const struct big_fixed *cy, size_t frac, unsigned iterations)
+{
+	return ref->iterations >= iterations && bf_frac_u32s(&ref->cx) == frac
+		&& !bf_cmp(&ref->cx, cx) && !bf_cmp(&ref->cy, cy);
+}
+
+/* The cached orbit if it fits, else a new one which then replaces it. An
+ * orbit counted further than asked for fits too. Each call is to be paired
+ * with ref_orbit_put(). */
+static struct ref_orbit_s * ref_orbit_get(const struct big_fixed *cx,
+	const struct big_fixed *cy, size_t frac, unsigned iterations)
+{
+	struct ref_orbit_s *ref;
+
+	frg_lock(ref_lock);
+
+	if (!ref_cached || !ref_orbit_matches(ref_cached, cx, cy, frac, iterations)) {
+		ref = malloc(sizeof(*ref));
+		ref_orbit_init(ref, cx, cy, frac, iterations);
+		dbg_printf("Reference orbit of length %zu\n", ref->len);
+
+		if (ref_cached && !--ref_cached->users)
+			ref_orbit_free(ref_cached);
+
+		ref->users = 1;
+		ref_cached = ref;
+	}
+
+	ref = ref_cached;
+	ref->users++;
+
+	frg_unlock(ref_lock);
+
+	return ref;
+}
+
+static void ref_orbit_put(struct ref_orbit_s *ref)
+{
+	frg_lock(ref_lock);
+
+	if (!--ref->users)
+		ref_orbit_free(ref);
+
+	frg_unlock(ref_lock);
+}
+
+static int lanes_fit_double(const struct pt_block_s *b)
+{
+	int ret = 1;
+	size_t l;
+
+	for (l = 0; l < LANES; l++) {
+		ret &= b->dr_m[l] == 0.0 || b->dr_e[l] > DOUBLE_MIN_EXP;
+		ret &= b->di_m[l] == 0.0 || b->di_e[l] > DOUBLE_MIN_EXP;
+	}
+
+	return ret;
+}
+
+static unsigned lanes_any_active(const struct pt_block_s *b)
+{
+	unsigned ret = 0;
+	size_t l;
+
+	for (l = 0; l < LANES; l++)
+		ret |= b->active[l];
+
+	return ret;
+}
+
+/* All lanes share n while in floatexp. Their distances are far too small to
+ * ever call for a rebase, and when the reference escapes they escape along
+ * with it. Returns number of iterations done. */
+static unsigned iterate_lanes_fe(struct pt_block_s *b, const struct ref_orbit_s *ref,
+	unsigned itr_count)
+{
+	struct floatexp dr;
+	struct floatexp di;
+	struct floatexp dcr;
+	struct floatexp dci;
+	struct floatexp t;
+	struct floatexp s;
+	double zr;
+	double zi;
+	double rr;
+	double ri;
+	unsigned inside;
+	unsigned i;
+	size_t n;
+	size_t l;
+
+	n = b->n[0];
+
+	for (i = 0; i < itr_count && n + 1 < ref->len
+			&& lanes_any_active(b) && !lanes_fit_double(b); i++) {
+		rr = ref->real[n];
+		ri = ref->img[n];
+
+		for (l = 0; l < LANES; l++) {
+			dr.m = b->dr_m[l];
+			dr.e = b->dr_e[l];
+			di.m = b->di_m[l];
+			di.e = b->di_e[l];
+			dcr.m = b->dcr_m[l];
+			dcr.e = b->dcr_e[l];
+			dci.m = b->dci_m[l];
+			dci.e = b->dci_e[l];
+
+			zr = rr + fe_to_d(dr);
+			zi = ri + fe_to_d(di);
+			inside = zr * zr + zi * zi <= 4.0;
+			b->iterations[l] += inside & b->active[l];
+			b->active[l] &= inside;
+
+			/* d' = 2Rd + d^2 + dc */
+			t = fe_sub(fe_mul_d(dr, rr), fe_mul_d(di, ri));
+			s = fe_sub(fe_mul(dr, dr), fe_mul(di, di));
+			t = fe_add(fe_add(fe_mul_pow2(t, 1), s), dcr);
+			b->dr_m[l] = t.m;
+			b->dr_e[l] = t.e;
+
+			t = fe_add(fe_mul_d(di, rr), fe_mul_d(dr, ri));
+			s = fe_mul(dr, di);
+			t = fe_add(fe_mul_pow2(fe_add(t, s), 1), dci);
+			b->di_m[l] = t.m;
+			b->di_e[l] = t.e;
+		}
+
+		n++;
+	}
+
+	for (l = 0; l < LANES; l++)
+		b->n[l] = n;
+
+	return i;
+}
+
+/* Switches the block over to doubles. A block that ran off the end of the
+ * reference is rebased right away. Its points have escaped by then, so the
+ * precision lost doing so does not matter. */
+static void lanes_to_double(struct pt_block_s *b, const struct ref_orbit_s *ref)
+{
+	struct floatexp f;
+	unsigned rebase;
+	size_t l;
+
+	for (l = 0; l < LANES; l++) {
+		f.m = b->dr_m[l];
+		f.e = b->dr_e[l];
+		b->dr[l] = fe_to_d(f);
+		f.m = b->di_m[l];
+		f.e = b->di_e[l];
+		b->di[l] = fe_to_d(f);
+		f.m = b->dcr_m[l];
+		f.e = b->dcr_e[l];
+		b->dcr[l] = fe_to_d(f);
+		f.m = b->dci_m[l];
+		f.e = b->dci_e[l];
+		b->dci[l] = fe_to_d(f);
+
+		rebase = b->n[l] + 1 >= ref->len;
+		b->dr[l] += rebase ? ref->real[b->n[l]] : 0.0;
+		b->di[l] += rebase ? ref->img[b->n[l]] : 0.0;
+		b->n[l] = rebase ? 0 : b->n[l];
+	}
+}
+
+static void iterate_lanes_d(struct pt_block_s *b, const struct ref_orbit_s *ref,
+	unsigned itr_count)
+{
+	double rr;
+	double ri;
+	double zr;
+	double zi;
+	double dr;
+	double di;
+	unsigned inside;
+	unsigned rebase;
+	unsigned i;
+	size_t l;
+
+	for (i = 0; i < itr_count && lanes_any_active(b); i++) {
+		for (l = 0; l < LANES; l++) {
+			rr = ref->real[b->n[l]];
+			ri = ref->img[b->n[l]];
+			dr = b->dr[l];
+			di = b->di[l];
+
+			zr = rr + dr;
+			zi = ri + di;
+			inside = zr * zr + zi * zi <= 4.0;
+			b->iterations[l] += inside & b->active[l];
+			b->active[l] &= inside;
+
+			/* d' = 2Rd + d^2 + dc */
+			b->dr[l] = 2.0 * (rr * dr - ri * di) + (dr * dr - di * di) + b->dcr[l];
+			b->di[l] = 2.0 * (rr * di + ri * dr) + 2.0 * dr * di + b->dci[l];
+			b->n[l]++;
+
+			rr = ref->real[b->n[l]];
+			ri = ref->img[b->n[l]];
+			zr = rr + b->dr[l];
+			zi = ri + b->di[l];
+			rebase = zr * zr + zi * zi < b->dr[l] * b->dr[l] + b->di[l] * b->di[l]
+				|| b->n[l] + 1 >= ref->len;
+			b->dr[l] = rebase ? zr : b->dr[l];
+			b->di[l] = rebase ? zi : b->di[l];
+			b->n[l] = rebase ? 0 : b->n[l];
+		}
+	}
+}
+
+static size_t default_frac_u32s(double step)
+{
+	double bits;
+
+	bits = -log2(step) + 64.0;
+	if (bits < 64.0)
+		bits = 64.0;
+
+	return (size_t)ceil(bits / 32.0);
+}
+
+static void iterate_mandelbrot(
+	const struct frg_iteration_request_s *spec,
+	unsigned * restrict iterations,
+	const struct frg_param_set_s *params)
+{
+	struct ref_orbit_s *ref;
+	struct pt_block_s block;
+	struct big_fixed cx;
+	struct big_fixed cy;
+	struct floatexp step;
+	struct floatexp dc;
+	size_t frac;
+	size_t row;
+	size_t col;
+	size_t src_col;
+	size_t l;
+	unsigned done;
+
+	(void)params;
+
+	frac = spec->step_bf ? bf_frac_u32s(spec->step_bf) : default_frac_u32s(spec->step);
+	step = spec->step_bf ? fe_from_bf(spec->step_bf) : fe_from_d(spec->step);
+
+	bf_init_d(&cx, 1, frac, spec->from_x - spec->col_offset * spec->step);
+	bf_init_d(&cy, 1, frac, spec->from_y - spec->row_offset * spec->step);
+	if (spec->centre_x)
+		bf_set(&cx, spec->centre_x);
+	if (spec->centre_y)
+		bf_set(&cy, spec->centre_y);
+
+	ref = ref_orbit_get(&cx, &cy, frac, spec->iterations);
+
+	for (row = 0; row < spec->rows; row++) {
+		for (col = 0; col < spec->cols; col += LANES) {
+			for (l = 0; l < LANES; l++) {
+				src_col = (col + l < spec->cols) ? col + l : (size_t)spec->cols - 1;
+				dc = fe_mul_d(step, (double)(spec->col_offset + (long)src_col));
+				block.dcr_m[l] = block.dr_m[l] = dc.m;
+				block.dcr_e[l] = block.dr_e[l] = dc.e;
+				dc = fe_mul_d(step, (double)(spec->row_offset + (long)row));
+				block.dci_m[l] = block.di_m[l] = dc.m;
+				block.dci_e[l] = block.di_e[l] = dc.e;
+				block.n[l] = 1;
+				block.active[l] = 1;
+				block.iterations[l] = 0;
+			}
+
+			done = iterate_lanes_fe(&block, ref, spec->iterations);
+			lanes_to_double(&block, ref);
+			iterate_lanes_d(&block, ref, spec->iterations - done);
+
+			for (l = 0; l < LANES && col + l < spec->cols; l++)
+				iterations[row * spec->cols + col + l] = block.iterations[l];
+		}
+	}
+
+	ref_orbit_put(ref);
+	bf_destroy(&cx);
+	bf_destroy(&cy);
+}
+
+extern void frg_module_init(struct frg_render_fn_repo_s *itr)
+{
+	ref_lock = frg_lock_new();
+
+	frg_fn_repo_register_iterator_flags(itr, "mandelbrot-perturbation", iterate_mandelbrot,
+		FRG_ITERATOR_CONJ_SYMMETRIC | FRG_ITERATOR_MANDELBROT);
+}
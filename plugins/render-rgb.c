@@ -221,11 +221,14 @@ static void draw_pixels(
 	float hue_from;
 	float hue_to;
 	float hue_pow;
+	float de_width;
+	float shade;
 
 	pallette_length = (unsigned)param_set_get_double_d(set, "pallette-length", spec->iterations);
 	hue_from = (float)param_set_get_double_d(set, "hue-from", 0.0);
 	hue_to = (float)param_set_get_double_d(set, "hue-to", 1.0);
 	hue_pow = (float)param_set_get_double_d(set, "hue-pow", 1.0);
+	de_width = (float)param_set_get_double_d(set, "de-width", 1.0);
 
 	dbg_printf("Drawing pixels with pallette of size %u with hue from %f to %f\n",
 		pallette_length, hue_from, hue_to);
@@ -248,6 +251,15 @@ static void draw_pixels(
 				img[index].r = pallette_red(&pallette, itr);
 				img[index].g = pallette_green(&pallette, itr);
 				img[index].b = pallette_blue(&pallette, itr);
+
+				/* Fade towards black closer than de-width samples to the
+				 * boundary, which draws filaments too thin to sample. */
+				if (spec->distance && spec->distance[index] < de_width) {
+					shade = spec->distance[index] / de_width;
+					img[index].r = (unsigned char)(img[index].r * shade);
+					img[index].g = (unsigned char)(img[index].g * shade);
+					img[index].b = (unsigned char)(img[index].b * shade);
+				}
 			}
 		}
 	}
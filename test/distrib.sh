@@ -0,0 +1,56 @@
+#!/bin/sh
+# Draws one image on a coordinator and three workers on localhost, kills one
+# of the workers while it holds tiles, and checks that the image still comes
+# out the same as from a single frgen.
+#
+# distrib.sh <frgen> <plugin directory>
+
+FRGEN="$1"
+FRACTALGEN_PLUGIN_PATTERN="$2/*.so"
+export FRACTALGEN_PLUGIN_PATTERN
+
+DIR=$(mktemp -d)
+PORT=$((20000 + $$ % 20000))
+VIEW="-w 1024 -h 768 -x -0.7435 -y 0.1314 -r 0.002 -a 100000"
+
+cleanup() {
+	kill $W1 $W2 $W3 $C 2>/dev/null
+	rm -rf "$DIR"
+}
+trap cleanup EXIT
+
+fail() {
+	echo "$1"
+	cat "$DIR/coord.log"
+	exit 1
+}
+
+"$FRGEN" --coordinate $PORT $VIEW -f "$DIR/distrib.bmp" > "$DIR/coord.log" 2>&1 & C=$!
+
+i=0
+until grep -q "Waiting for workers" "$DIR/coord.log"; do
+	i=$((i + 1))
+	[ $i -lt 100 ] || fail "Coordinator did not come up"
+	sleep 0.1
+done
+
+"$FRGEN" --worker 127.0.0.1:$PORT -t 1 > /dev/null 2>&1 & W1=$!
+"$FRGEN" --worker 127.0.0.1:$PORT -t 1 > /dev/null 2>&1 & W2=$!
+"$FRGEN" --worker 127.0.0.1:$PORT -t 1 > /dev/null 2>&1 & W3=$!
+
+i=0
+until grep -q "^Tile 2 /" "$DIR/coord.log"; do
+	i=$((i + 1))
+	[ $i -lt 300 ] || fail "No tiles came back"
+	sleep 0.1
+done
+
+kill -9 $W1
+
+wait $C || fail "Coordinator failed"
+grep -q "^Lost worker" "$DIR/coord.log" || fail "Coordinator did not notice the lost worker"
+
+"$FRGEN" $VIEW -f "$DIR/single.bmp" > /dev/null 2>&1 || fail "Single frgen failed"
+cmp -s "$DIR/distrib.bmp" "$DIR/single.bmp" || fail "Images differ"
+
+echo "$(grep -c '^Tile' "$DIR/coord.log") runs back, $(grep '^Lost worker' "$DIR/coord.log")"
@@ -0,0 +1,42 @@
+#!/bin/sh
+# Sends the render server requests it can't draw, around one it can, and
+# checks that each gets its answer and the server lives to send the image.
+#
+# serve.sh <frgen> <plugin directory>
+
+FRGEN="$1"
+FRACTALGEN_PLUGIN_PATTERN="$2/*.so"
+export FRACTALGEN_PLUGIN_PATTERN
+
+DIR=$(mktemp -d)
+
+cleanup() {
+	rm -rf "$DIR"
+}
+trap cleanup EXIT
+
+fail() {
+	echo "$1"
+	cat "$DIR/answers"
+	exit 1
+}
+
+# 1073741824 << 2 wraps around to 0 in 32 bits.
+printf '%s\n' \
+	"1 1073741824 16 -0.5 0 1.5" \
+	"2 16 16 abc 0 1" \
+	"3 16 16 -0.5 0 0" \
+	"4 16 16 -0.5 0 1.5" \
+	"bad" \
+	| "$FRGEN" --serve -s 2 -a 100 > "$DIR/out" 2> /dev/null || fail "Server failed"
+
+# The image is 16 * 16 * 3 bytes after its header line.
+head -n 4 "$DIR/out" > "$DIR/answers"
+printf '%s\n' "1 error" "2 error" "3 error" "4 16 16" | cmp -s - "$DIR/answers" \
+	|| fail "Wrong answers"
+
+[ "$(wc -c < "$DIR/out")" -eq $(( $(wc -c < "$DIR/answers") + 16 * 16 * 3 + 8 )) ] \
+	|| fail "Image not followed by ? error"
+[ "$(tail -c 8 "$DIR/out")" = "? error" ] || fail "No ? error for the last line"
+
+echo "Answered $(wc -l < "$DIR/answers") requests and a bad line"
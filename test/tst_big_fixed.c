@@ -0,0 +1,132 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include "big_fixed.h"
+
+static int check_d(const char *what, const struct big_fixed *f, double expected)
+{
+	double val;
+
+	val = bf_to_d(f);
+	if (fabs(val - expected) > 1e-15) {
+		printf("! %s: %.17g != %.17g\n", what, val, expected);
+		return 1;
+	}
+
+	printf("%s: %.17g\n", what, val);
+	return 0;
+}
+
+static int test_arithmetic(double a, double b)
+{
+	struct big_fixed f1;
+	struct big_fixed f2;
+	int ret = 0;
+
+	bf_init_d(&f1, 1, 4, a);
+	bf_init_d(&f2, 1, 4, b);
+	bf_add_i(&f1, &f2);
+	ret |= check_d("add", &f1, a + b);
+
+	bf_set_d(&f1, a);
+	bf_sub_i(&f1, &f2);
+	ret |= check_d("sub", &f1, a - b);
+
+	bf_set_d(&f1, a);
+	bf_mul_i(&f1, &f2);
+	ret |= check_d("mul", &f1, a * b);
+
+	if (bf_cmp(&f1, &f2) != ((a * b > b) - (a * b < b))) {
+		printf("! cmp %g %g\n", a * b, b);
+		ret = 1;
+	}
+
+	bf_set_d(&f1, a);
+	bf_mul_u32_i(&f1, 1000);
+	bf_div_u32_i(&f1, 8);
+	ret |= check_d("mul_u32", &f1, a * 125.0);
+
+	bf_destroy(&f1);
+	bf_destroy(&f2);
+
+	return ret;
+}
+
+static int test_parse(const char *str, double expected)
+{
+	struct big_fixed f;
+	int ret;
+
+	if (bf_init_from_str(&f, 1, 4, str)) {
+		printf("! Failed to parse %s\n", str);
+		bf_destroy(&f);
+		return 1;
+	}
+
+	ret = check_d(str, &f, expected);
+	bf_destroy(&f);
+
+	return ret;
+}
+
+static int test_tostr(const char *str, size_t digits, const char *expected)
+{
+	struct big_fixed f;
+	char *res;
+	int ret;
+
+	bf_init_from_str(&f, 1, 4, str);
+	res = bf_tostr(&f, digits);
+	ret = strcmp(res, expected) != 0;
+	printf("%s%s -> %s\n", ret ? "! " : "", str, res);
+	free(res);
+	bf_destroy(&f);
+
+	return ret;
+}
+
+/* -1.5 in two's complement with one fractional uint32_t. */
+static int test_twos(void)
+{
+	static const uint32_t expected[] = { 0x80000000, 0xFFFFFFFE };
+	struct big_fixed f;
+	uint32_t res[2];
+	int ret;
+
+	bf_init_d(&f, 1, 1, -1.5);
+	bf_to_twos_u32(&f, res, 2, 1, 1);
+	ret = res[0] != expected[0] || res[1] != expected[1];
+	if (ret)
+		printf("! -1.5 == %08X %08X\n", res[1], res[0]);
+	bf_destroy(&f);
+
+	return ret;
+}
+
+int main(void)
+{
+	int ret = 0;
+
+	ret |= test_arithmetic(1.25, 0.5);
+	ret |= test_arithmetic(-1.25, 0.5);
+	ret |= test_arithmetic(0.5, -1.75);
+	ret |= test_arithmetic(-0.375, -0.125);
+	ret |= test_arithmetic(0.1, 0.1);
+	ret |= test_parse("0", 0.0);
+	ret |= test_parse("-1.5", -1.5);
+	ret |= test_parse("0.1", 0.1);
+	ret |= test_parse("-.743643887037158704752191506114774", -0.743643887037158704752191506114774);
+	ret |= test_parse("3.000000000000000000000000000000000001", 3.0);
+	ret |= test_parse("1.5e-1", 0.15);
+	ret |= test_parse("-25E-2", -0.25);
+	ret |= test_parse("0.00125e3", 1.25);
+	ret |= test_parse("7e-400", 0.0);
+	ret |= test_tostr("-1.25", 0, "-1.25");
+	ret |= test_tostr("0.1", 8, "0.09999999");
+	ret |= test_tostr("3", 0, "3.0");
+	ret |= test_twos();
+
+	return ret;
+}
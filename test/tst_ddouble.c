@@ -0,0 +1,58 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include "ddouble.h"
+
+static int check(const char *what, struct ddouble d, double hi, double lo)
+{
+	if (d.hi != hi || d.lo != lo) {
+		printf("! %s: %a + %a != %a + %a\n", what, d.hi, d.lo, hi, lo);
+		return 1;
+	}
+
+	printf("%s: %a + %a\n", what, d.hi, d.lo);
+	return 0;
+}
+
+int main(void)
+{
+	struct ddouble a;
+	struct ddouble b;
+	double e;
+	double p;
+	int ret = 0;
+
+	/* (1 + 2^-30)^2 = 1 + 2^-29 + 2^-60 does not fit a double. */
+	p = dd_two_prod(1.0 + ldexp(1.0, -30), 1.0 + ldexp(1.0, -30), &e);
+	a.hi = p;
+	a.lo = e;
+	ret |= check("two_prod", a, 1.0 + ldexp(1.0, -29), ldexp(1.0, -60));
+
+	p = dd_two_sum(1.0, ldexp(1.0, -80), &e);
+	a.hi = p;
+	a.lo = e;
+	ret |= check("two_sum", a, 1.0, ldexp(1.0, -80));
+
+	b = dd_sub(a, dd_from_d(1.0));
+	ret |= check("sub", b, ldexp(1.0, -80), 0.0);
+
+	/* Squares of nearly equal numbers cancel down to the low part. */
+	a.hi = 1.0;
+	a.lo = ldexp(1.0, -60);
+	b = dd_sub(dd_sqr(a), dd_from_d(1.0));
+	ret |= check("sqr", b, ldexp(1.0, -59), 0.0);
+
+	b = dd_sub(dd_mul(a, a), dd_from_d(1.0));
+	ret |= check("mul", b, ldexp(1.0, -59), 0.0);
+
+	b = dd_mul_d(a, 3.0);
+	ret |= check("mul_d", b, 3.0, 3.0 * ldexp(1.0, -60));
+
+	b = dd_mul_pow2(a, 0.5);
+	ret |= check("mul_pow2", b, 0.5, ldexp(1.0, -61));
+
+	b = dd_add(a, a);
+	ret |= check("add", b, 2.0, ldexp(1.0, -59));
+
+	return ret;
+}
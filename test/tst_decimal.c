@@ -0,0 +1,175 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include "u32arr.h"
+#include "decimal.h"
+
+static uint32_t seed = 12345;
+
+static char * random_digits(size_t len)
+{
+	char *ret;
+	size_t i;
+
+	ret = malloc(len + 1);
+	for (i = 0; i < len; i++) {
+		seed = seed * 1103515245 + 12345;
+		ret[i] = (char)('0' + (seed >> 16) % 10);
+	}
+	if (ret[0] == '0')
+		ret[0] = '1';
+	ret[len] = '\0';
+
+	return ret;
+}
+
+/* One digit at a time. */
+static void naive_parse_int(uint32_t *dest, size_t u32s, const char *digits, size_t len)
+{
+	size_t i;
+
+	memset(dest, 0, u32s * sizeof(dest[0]));
+	for (i = 0; i < len; i++)
+		u32arr_mul_u32(dest, u32s, 10, (uint32_t)(digits[i] - '0'));
+}
+
+/* Adds digits from the last one and divides by ten, which rounds down the
+ * same way as dividing once. */
+static void naive_parse_frac(uint32_t *dest, size_t u32s, const char *digits, size_t len)
+{
+	uint32_t *tmp;
+	size_t i;
+
+	tmp = calloc(u32s + 1, sizeof(tmp[0]));
+	for (i = len; i-- > 0;) {
+		tmp[u32s] = (uint32_t)(digits[i] - '0');
+		u32arr_div_u32(tmp, u32s + 1, 10);
+	}
+	memcpy(dest, tmp, u32s * sizeof(dest[0]));
+	free(tmp);
+}
+
+static int test_int(size_t len)
+{
+	struct mb_array_u32 n;
+	uint32_t *expected;
+	size_t u32s;
+	char *digits;
+	char *str;
+	clock_t start;
+	double ms;
+	int ret = 0;
+
+	digits = random_digits(len);
+	u32s = dec_frac_u32s(len) + 1;
+	expected = calloc(u32s, sizeof(expected[0]));
+	naive_parse_int(expected, u32s, digits, len);
+
+	start = clock();
+	n = dec_parse_int(digits, len);
+	str = dec_format_int(n.buf, n.len);
+	ms = 1000.0 * (double)(clock() - start) / CLOCKS_PER_SEC;
+
+	if (u32arr_cmp(n.buf, n.len, expected, u32s)) {
+		printf("! Parsing %zu digit integer\n", len);
+		ret = 1;
+	}
+
+	if (strcmp(str, digits)) {
+		printf("! Formatting %zu digit integer\n", len);
+		ret = 1;
+	}
+
+	printf("%zu digit integer: %.2f ms\n", len, ms);
+
+	free(expected);
+	free(digits);
+	free(str);
+	free(n.buf);
+
+	return ret;
+}
+
+static int test_frac(size_t len, size_t u32s)
+{
+	uint32_t *expected;
+	uint32_t *frac;
+	uint32_t *tmp;
+	char *digits;
+	char *str;
+	size_t i;
+	int ret = 0;
+
+	digits = random_digits(len);
+	expected = calloc(u32s, sizeof(expected[0]));
+	frac = calloc(u32s, sizeof(frac[0]));
+	naive_parse_frac(expected, u32s, digits, len);
+	dec_parse_frac(frac, u32s, digits, len);
+
+	if (u32arr_cmp(frac, u32s, expected, u32s)) {
+		printf("! Parsing %zu digit fraction into %zu uint32_t's\n", len, u32s);
+		ret = 1;
+	}
+
+	/* Digits of a fraction come out of its integral part when it is
+	 * multiplied by ten. */
+	str = dec_format_frac(frac, u32s, len);
+	tmp = calloc(u32s + 1, sizeof(tmp[0]));
+	memcpy(tmp, frac, u32s * sizeof(tmp[0]));
+	for (i = 0; i < len; i++) {
+		tmp[u32s] = 0;
+		u32arr_mul_u32(tmp, u32s + 1, 10, 0);
+		if (str[i] != (char)('0' + tmp[u32s])) {
+			printf("! Formatting digit %zu of %zu digit fraction\n", i, len);
+			ret = 1;
+			break;
+		}
+	}
+
+	printf("%zu digit fraction into %zu uint32_t's\n", len, u32s);
+
+	free(tmp);
+	free(str);
+	free(frac);
+	free(expected);
+	free(digits);
+
+	return ret;
+}
+
+/* 0.5 is exact, so it must not come out as 0.4999... */
+static int test_exact_frac(void)
+{
+	uint32_t frac[3];
+	char *str;
+	int ret;
+
+	dec_parse_frac(frac, 3, "5", 1);
+	str = dec_format_frac(frac, 3, 4);
+	ret = frac[2] != 0x80000000 || frac[1] || frac[0] || strcmp(str, "5000");
+	if (ret)
+		printf("! 0.5 == %08X %08X %08X, %s\n", frac[2], frac[1], frac[0], str);
+	free(str);
+
+	return ret;
+}
+
+int main(void)
+{
+	int ret = 0;
+
+	ret |= test_int(1);
+	ret |= test_int(9);
+	ret |= test_int(80);
+	ret |= test_int(1000);
+	ret |= test_int(10000);
+	ret |= test_frac(30, 4);
+	ret |= test_frac(200, 3);
+	ret |= test_frac(3000, 300);
+	ret |= test_frac(10000, 1040);
+	ret |= test_exact_frac();
+
+	return ret;
+}
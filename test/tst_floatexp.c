@@ -0,0 +1,59 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include "floatexp.h"
+
+static int check(const char *what, struct floatexp f, double m, int64_t e)
+{
+	if (f.m != m || f.e != e) {
+		printf("! %s: %.17g * 2^%lld != %.17g * 2^%lld\n", what,
+				f.m, (long long)f.e, m, (long long)e);
+		return 1;
+	}
+
+	printf("%s: %.17g * 2^%lld\n", what, f.m, (long long)f.e);
+	return 0;
+}
+
+int main(void)
+{
+	struct floatexp a;
+	struct floatexp b;
+	struct cfloatexp c;
+	int ret = 0;
+
+	ret |= check("from_d", fe_from_d(-6.0), -1.5, 2);
+	ret |= check("zero", fe_from_d(0.0), 0.0, FE_ZERO_EXP);
+
+	/* 2^-1000 squared is far below what a double can hold. */
+	a = fe_from_d(ldexp(1.25, -1000));
+	b = fe_mul(a, a);
+	ret |= check("mul", b, 1.5625, -2000);
+	ret |= check("mul_d", fe_mul_d(b, 0.5), 1.5625, -2001);
+	ret |= check("mul_pow2", fe_mul_pow2(b, 3000), 1.5625, 1000);
+	ret |= check("mul zero", fe_mul(b, fe_from_d(0.0)), 0.0, FE_ZERO_EXP);
+
+	ret |= check("add", fe_add(b, b), 1.5625, -1999);
+	ret |= check("add small", fe_add(b, fe_from_d(1.0)), 1.0, 0);
+	ret |= check("sub", fe_sub(b, b), 0.0, FE_ZERO_EXP);
+	ret |= check("add zero", fe_add(fe_from_d(0.0), b), 1.5625, -2000);
+
+	if (fe_to_d(b) != 0.0 || fe_to_d(fe_mul_pow2(b, 2000)) != 1.5625) {
+		puts("! to_d");
+		ret = 1;
+	}
+
+	/* (1 + 2^-600 i)^2 = (1 - 2^-1200) + 2^-599 i */
+	c.real = fe_from_d(1.0);
+	c.img = fe_mul_pow2(fe_from_d(1.0), -600);
+	c = cfe_sqr(c);
+	ret |= check("sqr real", c.real, 1.0, 0);
+	ret |= check("sqr img", c.img, 1.0, -599);
+
+	c = cfe_mul(c, c);
+	ret |= check("cmul img", c.img, 1.0, -598);
+	c = cfe_add(c, c);
+	ret |= check("cadd real", c.real, 1.0, 1);
+
+	return ret;
+}
@@ -0,0 +1,170 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <complex.h>
+
+/* The compiler and the register machine are private to the plugin. */
+#include "../plugins/formula.c"
+
+typedef double complex (*reference_fn)(double complex z, double complex c);
+
+static double complex z_at(size_t l)
+{
+	return (0.3 + 0.1 * l) + (0.7 - 0.05 * l) * I;
+}
+
+static double complex c_at(size_t l)
+{
+	return (-0.4 + 0.02 * l) + (0.25 + 0.03 * l) * I;
+}
+
+/* Runs text on every lane and holds z against what ref makes of the same z
+ * and c in scalar complex arithmetic. */
+static int check(const char *text, reference_fn ref)
+{
+	static struct lanes_s r;
+	struct program_s prog;
+	const char *error;
+	double complex want;
+	double complex got;
+	int column;
+	size_t l;
+
+	if ((error = translate(&prog, text, &column))) {
+		printf("! %s: %s at column %d\n", text, error, column);
+		return 1;
+	}
+
+	for (l = 0; l < LANES; l++) {
+		r.re[REG_Z][l] = creal(z_at(l));
+		r.im[REG_Z][l] = cimag(z_at(l));
+		r.re[REG_C][l] = creal(c_at(l));
+		r.im[REG_C][l] = cimag(c_at(l));
+	}
+
+	load_consts(&prog, &r);
+	run(&prog, &r);
+
+	for (l = 0; l < LANES; l++) {
+		want = ref(z_at(l), c_at(l));
+		got = r.re[REG_Z][l] + r.im[REG_Z][l] * I;
+
+		if (!(cabs(got - want) <= 1e-12 * (1.0 + cabs(want)))) {
+			printf("! %s, lane %zu: %.17g%+.17gi, not %.17g%+.17gi\n", text, l,
+				creal(got), cimag(got), creal(want), cimag(want));
+			return 1;
+		}
+	}
+
+	printf("%s: %u instructions, %u constants\n", text, prog.length, prog.consts);
+	return 0;
+}
+
+/* Expects text not to compile, for error at column. */
+static int check_error(const char *text, const char *error, int column)
+{
+	struct program_s prog;
+	const char *got;
+	int got_column = -1;
+
+	got = translate(&prog, text, &got_column);
+	if (!got || strcmp(got, error) || got_column != column) {
+		printf("! %s: %s at column %d, not %s at column %d\n", text,
+			got ? got : "no error", got_column, error, column);
+		return 1;
+	}
+
+	printf("%s: %s at column %d\n", text, got, got_column);
+	return 0;
+}
+
+static double complex ref_precedence(double complex z, double complex c)
+{
+	return 2.0 + 3.0 * (z * z) * c - c / 2.0;
+}
+
+static double complex ref_minus_power(double complex z, double complex c)
+{
+	(void)c;
+	return -(z * z);
+}
+
+static double complex ref_minus_power_sum(double complex z, double complex c)
+{
+	return c - z * z;
+}
+
+static double complex ref_negative_power(double complex z, double complex c)
+{
+	return 1.0 / (z * z) + c;
+}
+
+static double complex ref_power_tower(double complex z, double complex c)
+{
+	(void)c;
+	return z * z * z * z * z * z * z * z;
+}
+
+static double complex ref_folded(double complex z, double complex c)
+{
+	return z * z + c + ((1.0 + 2.0 * I) * 3.0 - 0.5);
+}
+
+static double complex ref_functions(double complex z, double complex c)
+{
+	return cexp(z) * csin(c) + clog(z) / ccos(z);
+}
+
+static double complex ref_constant(double complex z, double complex c)
+{
+	(void)z;
+	(void)c;
+	return 2.0 + 1.0 * I;
+}
+
+int main(void)
+{
+	struct program_s prog;
+	char text[1024];
+	int column;
+	int ret = 0;
+	int k;
+
+	ret |= check("z = 2 + 3*z^2*c - c/2", ref_precedence);
+
+	/* ^ binds tighter than unary minus, which binds tighter than -. */
+	ret |= check("-z^2", ref_minus_power);
+	ret |= check("c - z^2", ref_minus_power_sum);
+	ret |= check("z^-2 + c", ref_negative_power);
+	ret |= check("z^2^3", ref_power_tower);
+	ret |= check("exp(z)*sin(c) + log(z)/cos(z)", ref_functions);
+
+	/* Constants fold into one, so only z^2 and two sums are left. Sums are
+	 * not reordered, so they have to be next to each other. */
+	ret |= check("z = z^2 + c + ((1 + 2i)*3 - 0.5)", ref_folded);
+	translate(&prog, "z^2 + c + ((1 + 2i)*3 - 0.5)", &column);
+	if (prog.length != 3 || prog.consts != 1) {
+		printf("! constants not folded: %u instructions, %u constants\n", prog.length,
+			prog.consts);
+		ret = 1;
+	}
+
+	ret |= check("(1 + i)^2 + 2 - i", ref_constant);
+
+	ret |= check_error("z^2 + ", "expected a value", 7);
+	ret |= check_error("z^2 + foo", "unknown name", 7);
+	ret |= check_error("z^2 + sin z", "expected '('", 11);
+	ret |= check_error("(z + c", "expected ')'", 7);
+	ret |= check_error("z = z c", "expected an operator", 7);
+
+	/* Every term takes two instructions, so the first that there is no room
+	 * for is number MAX_CODE / 2 + 1. The error is at the + after it. */
+	strcpy(text, "z");
+	for (k = 0; k < MAX_CODE; k++)
+		strcat(text, " + z^2");
+	ret |= check_error(text, "formula too long",
+		(int)(strlen("z") + (MAX_CODE / 2 + 1) * strlen(" + z^2")) + 2);
+
+	return ret;
+}
@@ -0,0 +1,56 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include "interval.h"
+
+static int check(const char *what, struct interval iv, double lo, double hi)
+{
+	if (!(iv.lo <= lo && iv.hi >= hi)) {
+		printf("! %s: [%a, %a] does not hold [%a, %a]\n", what, iv.lo, iv.hi, lo, hi);
+		return 1;
+	}
+
+	printf("%s: [%a, %a]\n", what, iv.lo, iv.hi);
+	return 0;
+}
+
+int main(void)
+{
+	struct interval a;
+	struct interval b;
+	struct interval r;
+	int ret = 0;
+
+	a = iv_make(-1.0, 3.0);
+	b = iv_make(2.0, 5.0);
+
+	ret |= check("add", iv_add(a, b), 1.0, 8.0);
+	ret |= check("sub", iv_sub(a, b), -6.0, 1.0);
+	ret |= check("mul", iv_mul(a, b), -5.0, 15.0);
+	ret |= check("mul_pow2", iv_mul_pow2(a, -2), -0.25, 0.75);
+
+	/* A square straddling zero starts at zero, unlike a * a. */
+	r = iv_sqr(a);
+	ret |= check("sqr", r, 0.0, 9.0);
+	if (r.lo != 0.0) {
+		printf("! sqr lower bound %a\n", r.lo);
+		ret = 1;
+	}
+
+	r = iv_sqr(iv_make(-3.0, -2.0));
+	ret |= check("sqr negative", r, 4.0, 9.0);
+	if (r.lo > 4.0 || r.hi < 9.0 || r.lo < 3.9) {
+		puts("! sqr negative is too wide");
+		ret = 1;
+	}
+
+	/* 0.1 + 0.2 rounds, so the exact sum must still be inside. */
+	r = iv_add(iv_make(0.1, 0.1), iv_make(0.2, 0.2));
+	ret |= check("add rounding", r, 0.1 + 0.2, 0.1 + 0.2);
+	if (!(r.lo < 0.1 + 0.2 && r.hi > 0.1 + 0.2)) {
+		puts("! add rounding not widened");
+		ret = 1;
+	}
+
+	return ret;
+}